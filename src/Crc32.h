@@ -0,0 +1,32 @@
+/*
+ * @file Crc32.h
+ *
+ * CRC-32 as used by zlib, so files checked on the panel can be
+ * made on a host with zlib.crc32.
+ */
+#pragma once
+
+#ifndef __CRC32_H
+#define __CRC32_H
+
+#include <Arduino.h>
+
+/*!
+ * @brief Calculate the CRC-32 of a block of RAM
+ * @param data   bytes to check
+ * @param length number of bytes
+ * @param crc    CRC-32 of the bytes before this block, 0 to start
+ */
+inline uint32_t checksumCrc32(const void *data, size_t length, uint32_t crc = 0) {
+  const uint8_t *bytes = (const uint8_t*) data;
+  crc = ~crc;
+  while (length--) {
+    crc ^= *bytes++;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * HeapStats
+ *
+ * Heap accounting for each subsystem of the button panel.
+ */
+
+#include <Arduino.h>
+#include "HeapStats.h"
+#include "RequestArena.h"
+
+static const char heapMenuDrawName[] PROGMEM = "Menu";
+static const char heapSignCommandName[] PROGMEM = "Sign";
+static const char heapHeadCommandName[] PROGMEM = "Head";
+static const char heapNtpName[] PROGMEM = "NTP";
+static const char heapMdnsName[] PROGMEM = "mDNS";
+
+static const char* const heapSubsystemNames[HEAP_SUBSYSTEM_COUNT] PROGMEM = {
+  heapMenuDrawName,
+  heapSignCommandName,
+  heapHeadCommandName,
+  heapNtpName,
+  heapMdnsName
+};
+
+static HeapUsage heapUsage[HEAP_SUBSYSTEM_COUNT];   // Measurements of each subsystem
+static uint32_t heapLowestFree = UINT32_MAX;        // Lowest free heap seen by any probe
+
+
+/*********************
+ * HeapProbe Class functions
+ *********************/
+
+/*
+ * Constructor
+ * Only the free heap is read here as it does not walk the heap.
+ *
+ * @param heapSubsystem Subsystem doing the work in this block
+ */
+HeapProbe::HeapProbe(HeapSubsystem heapSubsystem) {
+  subsystem = heapSubsystem;
+  startFreeHeap = ESP.getFreeHeap();
+}
+
+
+/*
+ * Destructor
+ * Record how the heap changed over the block.
+ */
+HeapProbe::~HeapProbe() {
+  HeapUsage &usage = heapUsage[subsystem];
+  uint32_t freeHeap = ESP.getFreeHeap();
+  int32_t delta = (int32_t) freeHeap - (int32_t) startFreeHeap;
+
+  usage.calls++;
+  usage.lastDelta = delta;
+  usage.totalDelta += delta;
+  usage.worstDelta = min(usage.worstDelta, delta);
+
+  // Finding the largest block walks the heap, so only do it
+  // the first time or when the heap has changed
+  if (delta != 0 || usage.calls == 1) {
+    uint32_t maxBlock;
+    uint8_t fragmentation;
+    heapStatsCurrent(&freeHeap, &maxBlock, &fragmentation);
+    usage.minMaxBlock = min(usage.minMaxBlock, maxBlock);
+    usage.maxFragmentation = max(usage.maxFragmentation, fragmentation);
+  }
+  usage.minFreeHeap = min(usage.minFreeHeap, freeHeap);
+  heapLowestFree = min(heapLowestFree, freeHeap);
+}
+
+
+/*********************
+ * Non Class Functions
+ *********************/
+
+//
+// Return the measurements of a subsystem
+//
+const HeapUsage& heapStatsUsage(HeapSubsystem subsystem) {
+  return heapUsage[subsystem];
+}
+
+
+//
+// Return the name of a subsystem
+//
+const __FlashStringHelper* heapStatsName(HeapSubsystem subsystem) {
+  return FPSTR(pgm_read_ptr(&heapSubsystemNames[subsystem]));
+}
+
+
+//
+// Read the free heap, largest free block and fragmentation percent together
+//
+void heapStatsCurrent(uint32_t *freeHeap, uint32_t *maxBlock, uint8_t *fragmentation) {
+  ESP.getHeapStats(freeHeap, maxBlock, fragmentation);
+}
+
+
+//
+// Lowest free heap seen at the end of any measured block
+//
+uint32_t heapStatsMinFreeHeap() {
+  return heapLowestFree;
+}
+
+
+//
+// Print the current heap and the measurements of each subsystem
+//
+void heapStatsPrint(Print &p) {
+  uint32_t freeHeap;
+  uint32_t maxBlock;
+  uint8_t fragmentation;
+  heapStatsCurrent(&freeHeap, &maxBlock, &fragmentation);
+
+  p.print(F("Heap free: "));
+  p.print(freeHeap);
+  p.print(F(" max block: "));
+  p.print(maxBlock);
+  p.print(F(" frag: "));
+  p.print(fragmentation);
+  p.print(F("% lowest free: "));
+  p.println(heapLowestFree);
+
+  p.print(F("Request arena high water: "));
+  p.print(requestArena.highWater());
+  p.print(F(" of "));
+  p.print(REQUEST_ARENA_SIZE);
+  p.print(F(" failures: "));
+  p.println(requestArena.failures());
+
+  p.println(F("Subsystem\tcalls\tlast\ttotal\tworst\tmin free\tmin block\tmax frag"));
+  for (uint8_t subsystem = 0; subsystem < HEAP_SUBSYSTEM_COUNT; subsystem++) {
+    const HeapUsage &usage = heapUsage[subsystem];
+    p.print(heapStatsName((HeapSubsystem) subsystem));
+    p.print('\t');
+    p.print(usage.calls);
+    if (usage.calls > 0) {
+      p.print('\t');
+      p.print(usage.lastDelta);
+      p.print('\t');
+      p.print(usage.totalDelta);
+      p.print('\t');
+      p.print(usage.worstDelta);
+      p.print('\t');
+      p.print(usage.minFreeHeap);
+      p.print('\t');
+      p.print(usage.minMaxBlock);
+      p.print('\t');
+      p.print(usage.maxFragmentation);
+      p.print('%');
+    }
+    p.println();
+  }
+}
+
+
+//
+// Print the heap statistics when asked to over Serial
+//
+// @param extraReport optional function printing more measurements, like the menu pages
+//
+void heapStatsHandleSerial(HeapStatsReport extraReport) {
+  while (Serial.available()) {
+    if (Serial.read() == HEAPSTATS_SERIAL_COMMAND) {
+      heapStatsPrint(Serial);
+      if (extraReport) {
+        extraReport(Serial);
+      }
+    }
+  }
+}
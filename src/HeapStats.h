@@ -0,0 +1,92 @@
+/*
+ * @file HeapStats.h
+ *
+ * Heap accounting for each subsystem of the button panel.
+ *
+ * A HeapProbe is placed at the top of a block of work, like sending a
+ * command to the sign.  It records the free heap when the block starts
+ * and, when it goes out of scope, how much heap the block kept, the
+ * smallest free block and the fragmentation.  Over a long uptime this
+ * shows which subsystem is fragmenting the heap.
+ *
+ * The totals can be printed to Serial and a summary is shown on the
+ * Status page.
+ */
+#pragma once
+
+#ifndef __HEAPSTATS_H
+#define __HEAPSTATS_H
+
+#include <Arduino.h>
+
+#define HEAPSTATS_SERIAL_COMMAND 'h'    // Character read from Serial to print the heap statistics
+
+
+//
+// Parts of the firmware that are measured
+//
+enum HeapSubsystem : uint8_t {
+  HEAP_MENU_DRAW = 0,     // Menu drawing and touch handling
+  HEAP_SIGN_COMMAND,      // REST call to the On Air sign
+  HEAP_HEAD_COMMAND,      // REST call to the Robot Head
+  HEAP_NTP,               // NTP time update
+  HEAP_MDNS,              // mDNS queries and updates
+  HEAP_SUBSYSTEM_COUNT
+};
+
+
+//
+// Heap measurements for one subsystem
+//
+struct HeapUsage {
+  uint32_t calls = 0;             // Number of blocks measured
+  int32_t lastDelta = 0;          // Change in free heap over the last block, negative is heap kept
+  int32_t totalDelta = 0;         // Change in free heap over all blocks
+  int32_t worstDelta = 0;         // Most heap kept by a single block
+  uint32_t minFreeHeap = UINT32_MAX;    // Lowest free heap seen at the end of a block
+  uint32_t minMaxBlock = UINT32_MAX;    // Smallest largest free block seen at the end of a block
+  uint8_t maxFragmentation = 0;   // Highest fragmentation percent seen at the end of a block
+};
+
+
+/*********************
+ * HeapProbe Class
+ *********************/
+
+//
+// Measures the heap from construction to the end of its scope.
+// Declare it first in the block so it is destroyed after everything the block allocated.
+//
+class HeapProbe {
+  public:
+    HeapProbe(HeapSubsystem heapSubsystem);
+    ~HeapProbe();
+
+    HeapProbe(const HeapProbe&) = delete;
+    HeapProbe& operator=(const HeapProbe&) = delete;
+
+  private:
+    HeapSubsystem subsystem;  // Subsystem being measured
+    uint32_t startFreeHeap;   // Free heap when the block started
+};
+
+
+/*********************
+ * Non Class Functions
+ *********************/
+
+/*!
+ * @brief Function printing more measurements after the heap statistics
+ * 
+ * @param Print& where to print the measurements
+ */
+typedef void (*HeapStatsReport)(Print&);
+
+const HeapUsage& heapStatsUsage(HeapSubsystem subsystem);
+const __FlashStringHelper* heapStatsName(HeapSubsystem subsystem);
+void heapStatsCurrent(uint32_t *freeHeap, uint32_t *maxBlock, uint8_t *fragmentation);
+uint32_t heapStatsMinFreeHeap();
+void heapStatsPrint(Print &p);
+void heapStatsHandleSerial(HeapStatsReport extraReport = nullptr);
+
+#endif
@@ -15,8 +15,7 @@
 #include <Adafruit_GFX.h>
 #include <Adafruit_ILI9341.h>
 #include <XPT2046_Touchscreen.h>
-#include <vector>
-#include <tuple>
+#include <algorithm>
 
 using namespace std;
 
@@ -32,34 +31,39 @@ using namespace std;
 // Uncomment the following define to debug the screen Event Handling
 #define MENU_HANDLE_DEBUG
 
+// Uncomment the following define to print the CPU cycles used by each draw and touch lookup
+//#define MENU_BENCHMARK
+
 
 /*********************
  * Menu Class
  *********************/
 
-Menu::Menu(Adafruit_GFX *tft) {
-  init(tft, nullptr, DEFAULT_BACKGROUND_COLOR);
-}
-
-Menu::Menu(Adafruit_GFX *tft, vector<MenuPage*> *tMenus) {
-  init(tft, tMenus, DEFAULT_BACKGROUND_COLOR);
-}
-
-Menu::Menu(Adafruit_GFX *tft, vector<MenuPage*> *tMenus, uint16_t bgColor) {
-  init(tft, tMenus, bgColor);
-}
-
-//
-// Initialize the Menu variables
-//
-void Menu::init(Adafruit_GFX *tft, vector<MenuPage*> *tMenus, uint16_t bgColor) {
+/*
+ * Constructor
+ * Use MenuTree to size the offset storage to the pages.
+ *
+ * @param tft           Screen to draw the menu on
+ * @param tMenus        PROGMEM list of the pages shown across the top
+ * @param tMenuCount    Number of pages in tMenus
+ * @param tMenuCapacity Most pages the menu can show
+ * @param offsetStorage Room for tMenuCapacity + 1 top button offsets
+ * @param bgColor       Theme background color
+ */
+Menu::Menu(Adafruit_GFX *tft, MenuPage* const *tMenus, uint8_t tMenuCount, uint8_t tMenuCapacity, int16_t *offsetStorage, ThemeRole bgColor) {
   _tft = tft;
   backgroundColor = bgColor;
   topMenus = tMenus;
-  startPage = 0;
+  topMenuCount = min(tMenuCount, tMenuCapacity);
+  topMenuCapacity = tMenuCapacity;
+  topOffsets = offsetStorage;
+  topScroll = 0;
+  activePage = -1;
 
-  setTopButtons(DEFAULT_PAGETOP_BUTTONS);
-  setTopHeight(DEFAULT_PAGETOP_HEIGHT);
+  // Layout is calculated by setup() once the screen is started.
+  // The pages may not be constructed yet when a global Menu is initialized.
+  topButtons = DEFAULT_PAGETOP_BUTTONS;
+  topHeight = DEFAULT_PAGETOP_HEIGHT;
 
 }
 
@@ -69,7 +73,7 @@ void Menu::init(Adafruit_GFX *tft, vector<MenuPage*> *tMenus, uint16_t bgColor)
 //
 void Menu::setTopButtons(int16_t buttons) {
   topButtons = buttons;
-  calculateTopButtonDimensions();
+  calculateLayout();
 }
 
 
@@ -78,21 +82,56 @@ void Menu::setTopButtons(int16_t buttons) {
 //
 void Menu::setTopHeight(int16_t height) {
   topHeight = height;
-  calculateTopButtonDimensions();
+  calculateLayout();
 }
 
 
 //
-// Calculate the sizes for the Top Menu Buttons
-// Also calculate the size of the bottom panel
+// Switch to a new color theme and repaint the whole screen
 //
-void Menu::calculateTopButtonDimensions() {
+void Menu::setTheme(const MenuTheme *theme) {
+  menuTheme = theme;
+  clearScreenBeforeDraw = true;
+  draw();
+}
+
+
+//
+// Calculate the width of each Top Menu Button from its label
+// and the size of the bottom panel, then lay out each page's buttons.
+// The top buttons are stored as a running sum of widths so any
+// position in the strip can be found with a binary search.
+// Only needs to run when the geometry or page labels change.
+// Call again after changing the screen rotation.
+//
+void Menu::calculateLayout() {
+  screenHeight = _tft->height();
+  screenWidth  = _tft->width();
+
   topButtonHeight = topHeight;
-  topButtonWidth = (screenWidth - (2* DEFAULT_PAGETOP_NEXT_BUTTON_SIZE)) / topButtons;
+  topStripWidth = screenWidth - (2* DEFAULT_PAGETOP_NEXT_BUTTON_SIZE);
+  topButtonWidth = topStripWidth / topButtons;
   panelX = 0;
   panelY = topHeight + 1;
   panelWidth = screenWidth;
   panelHeight = screenHeight - panelY;
+
+  topOffsets[0] = 0;
+  for (uint8_t pageIndex = 0; pageIndex < topMenuCount; pageIndex++) {
+    MenuPage *topMenu = getTopMenu(pageIndex);
+    topMenu->setMenuIndex(pageIndex);
+
+    // Size top button to its label, never smaller than an even share of the strip
+    int16_t labelWidth = getTextWidth(_tft, topMenu->getName(), topMenu->getTextSize()) + (2 * DEFAULT_PAGETOP_PADDING);
+    int16_t buttonWidth = constrain(labelWidth, topButtonWidth, topStripWidth);
+    topOffsets[pageIndex + 1] = topOffsets[pageIndex] + buttonWidth;
+
+    // Buttons on each page
+    topMenu->layout(panelX, panelY, panelWidth, panelHeight);
+  }
+
+  topScroll = min(topScroll, maxTopScroll());
+  clearTopBeforeDraw = true;
 }
 
 
@@ -101,8 +140,7 @@ void Menu::calculateTopButtonDimensions() {
 // The TFT must be started before this is called
 //
 bool Menu::setup() {
-  screenHeight = _tft->height();
-  screenWidth  = _tft->width();
+  calculateLayout();
 
   // Check that the screen has a size
   if (screenHeight == 0 || screenWidth == 0) {
@@ -110,8 +148,6 @@ bool Menu::setup() {
     return false;
   }
 
-  calculateTopButtonDimensions();
-
   return true;
 }
 
@@ -120,11 +156,14 @@ bool Menu::setup() {
 // Draw the top menu and the corresponding button panel
 //
 void Menu::draw() {
+  #ifdef MENU_BENCHMARK
+  uint32_t benchmarkStart = ESP.getCycleCount();
+  #endif
   if (clearScreenBeforeDraw) {
     #ifdef MENU_DRAW_DEBUG
     Serial.println("Clear Screen");
     #endif
-    _tft->fillScreen(DEFAULT_BACKGROUND_COLOR);
+    _tft->fillScreen(getThemeColor(backgroundColor).base);
     clearScreenBeforeDraw = false;
   }
   #ifdef MENU_DRAW_DEBUG
@@ -133,74 +172,80 @@ void Menu::draw() {
   Serial.print("Width:");
   Serial.println(screenWidth);
   #endif
-  uint16_t barColor = DEFAULT_PAGETOP_COLOR;
-  if (topMenus) {
+  uint16_t barColor = getThemeColor(DEFAULT_PAGETOP_COLOR).base;
+  if (topMenuCount) {
     #ifdef MENU_DRAW_DEBUG
     Serial.println("Drawing Top Buttons");
     #endif
-    int16_t pos = 0;
-    int16_t buttonTopLeftX = DEFAULT_PAGETOP_NEXT_BUTTON_SIZE;
-    int16_t buttonTopLeftY = 0;
-    bool moreButtonsRightShown = false;
-
-    if (startPage == 0) {
-        #ifdef MENU_DRAW_DEBUG
-        Serial.println("  No more Buttons on Left Indicator");
-        #endif
-        // Hide/Remove more buttons left indicator
-        _tft->fillRect(0, DEFAULT_BUTTON_CORNER, DEFAULT_PAGETOP_NEXT_BUTTON_SIZE - 1, topButtonHeight - (2 * DEFAULT_BUTTON_CORNER), DEFAULT_BACKGROUND_COLOR);
+    uint16_t background = getThemeColor(backgroundColor).base;
+    int16_t indicatorY = DEFAULT_BUTTON_CORNER;
+    int16_t indicatorWidth = DEFAULT_PAGETOP_NEXT_BUTTON_SIZE - 1;
+    int16_t indicatorHeight = topButtonHeight - (2 * DEFAULT_BUTTON_CORNER);
+    int16_t topButtonCount = topMenuCount;
+
+    if (clearTopBeforeDraw) {
+      // Top buttons moved so remove the old ones
+      _tft->fillRect(DEFAULT_PAGETOP_NEXT_BUTTON_SIZE, 0, topStripWidth, topButtonHeight - DEFAULT_BAR_HEIGHT, background);
+      clearTopBeforeDraw = false;
     }
 
-    auto topMenu = topMenus->begin();
-    for (; topMenu != topMenus->end(); topMenu++) {
-
-      if (pos == (startPage - 1)) {
-        #ifdef MENU_DRAW_DEBUG
-        Serial.println("  Show more Buttons on Left Indicator");
-        #endif
-        // Show there is more buttons to left
-        _tft->fillRect(0, DEFAULT_BUTTON_CORNER, DEFAULT_PAGETOP_NEXT_BUTTON_SIZE - 1, topButtonHeight - (2 * DEFAULT_BUTTON_CORNER), (*topMenu)->getColor());
-      }
-
-      if (startPage <= pos && pos < (startPage + DEFAULT_PAGETOP_BUTTONS)) {
-        // Button in visible range
-        #ifdef MENU_DRAW_DEBUG
-        Serial.print("  buttonTopLeftX:");
-        Serial.println(buttonTopLeftX);
-        Serial.print("  buttonTopLeftY:");
-        Serial.println(buttonTopLeftY);
-        #endif
-        (*topMenu)->draw(_tft, buttonTopLeftX, buttonTopLeftY, topButtonWidth, topButtonHeight);
-        buttonTopLeftX += topButtonWidth;
-      }
+    // First top button at the scroll position
+    int16_t topButton = max(findTopButtonAt(0), (int16_t) 0);
 
-      if (pos == (startPage + DEFAULT_PAGETOP_BUTTONS)) {
-        #ifdef MENU_DRAW_DEBUG
-        Serial.println("  Show more Buttons on Right Indicator");
-        #endif
-        // Show there is more buttons to right
-        _tft->fillRect(screenWidth - (DEFAULT_PAGETOP_NEXT_BUTTON_SIZE - 1), DEFAULT_BUTTON_CORNER, DEFAULT_PAGETOP_NEXT_BUTTON_SIZE - 1, topButtonHeight - (2 * DEFAULT_BUTTON_CORNER), (*topMenu)->getColor());
-        moreButtonsRightShown = true;
-      }
+    if (topButton > 0) {
+      #ifdef MENU_DRAW_DEBUG
+      Serial.println("  Show more Buttons on Left Indicator");
+      #endif
+      // Show there is more buttons to left
+      _tft->fillRect(0, indicatorY, indicatorWidth, indicatorHeight, getTopMenu(topButton - 1)->getColor());
+    }
+    else {
+      #ifdef MENU_DRAW_DEBUG
+      Serial.println("  No more Buttons on Left Indicator");
+      #endif
+      // Hide/Remove more buttons left indicator
+      _tft->fillRect(0, indicatorY, indicatorWidth, indicatorHeight, background);
+    }
 
-      if ((*topMenu)->isActive()) {
-        #ifdef MENU_DRAW_DEBUG
-        Serial.print("  Active Page ");
-        Serial.println((*topMenu)->getName());
-        #endif
-        barColor = (*topMenu)->getColor();
-        (*topMenu)->drawPanelButtons(_tft, panelX, panelY, panelWidth, panelHeight);
+    // Draw the buttons that fit completely in the strip
+    for (; topButton < topButtonCount; topButton++) {
+      int16_t buttonLeft = topOffsets[topButton] - topScroll;
+      int16_t buttonRight = topOffsets[topButton + 1] - topScroll;
+      if (buttonRight > topStripWidth) {
+        break;
       }
-
-      pos++;
+      int16_t buttonTopLeftX = DEFAULT_PAGETOP_NEXT_BUTTON_SIZE + buttonLeft;
+      #ifdef MENU_DRAW_DEBUG
+      Serial.print("  buttonTopLeftX:");
+      Serial.println(buttonTopLeftX);
+      #endif
+      getTopMenu(topButton)->draw(_tft, buttonTopLeftX, 0, buttonRight - buttonLeft, topButtonHeight);
     }
 
-    if (!moreButtonsRightShown) {
-        #ifdef MENU_DRAW_DEBUG
-        Serial.println("  No more Buttons on Right Indicator");
-        #endif
+    if (topButton < topButtonCount) {
+      #ifdef MENU_DRAW_DEBUG
+      Serial.println("  Show more Buttons on Right Indicator");
+      #endif
+      // Show there is more buttons to right
+      _tft->fillRect(screenWidth - indicatorWidth, indicatorY, indicatorWidth, indicatorHeight, getTopMenu(topButton)->getColor());
+    }
+    else {
+      #ifdef MENU_DRAW_DEBUG
+      Serial.println("  No more Buttons on Right Indicator");
+      #endif
       // Hide/Remove more buttons right indicator
-      _tft->fillRect(screenWidth - (DEFAULT_PAGETOP_NEXT_BUTTON_SIZE - 1), DEFAULT_BUTTON_CORNER, DEFAULT_PAGETOP_NEXT_BUTTON_SIZE - 1, topButtonHeight - (2 * DEFAULT_BUTTON_CORNER), DEFAULT_BACKGROUND_COLOR);
+      _tft->fillRect(screenWidth - indicatorWidth, indicatorY, indicatorWidth, indicatorHeight, background);
+    }
+
+    // Draw the panel of the active page
+    MenuPage *activeMenu = getActiveTopMenu();
+    if (activeMenu) {
+      #ifdef MENU_DRAW_DEBUG
+      Serial.print("  Active Page ");
+      Serial.println(activeMenu->getName());
+      #endif
+      barColor = activeMenu->getColor();
+      activeMenu->drawPanelButtons(_tft);
     }
 
   }
@@ -211,81 +256,165 @@ void Menu::draw() {
   int16_t barX = 0;
   int16_t barY = topButtonHeight - barHeight;
   _tft->fillRect(barX, barY, barWidth, barHeight, barColor);
+
+  #ifdef MENU_BENCHMARK
+  Serial.print("Draw cycles: ");
+  Serial.println(ESP.getCycleCount() - benchmarkStart);
+  #endif
 }
 
 
 
+//
+// Redraw only the buttons on the active page that changed state
+//
+void Menu::drawChangedButtons() {
+  MenuPage *activeMenu = getActiveTopMenu();
+  if (activeMenu) {
+    activeMenu->drawChangedButtons(_tft);
+  }
+}
+
+
+//
+// Run the short or long press callback of a button.
+// The button is drawn in its pressed shade while the callback runs,
+// as callbacks may wait on the network.
+//
+// @return true if the callback changed more than the button
+//
+bool Menu::callbackButton(MenuButton *button, bool longPress) {
+  if (!(longPress ? button->hasLongPressCallback() : button->hasShortPressCallback())) {
+    return false;
+  }
+  button->setPressed(true);
+  drawChangedButtons();
+  bool callbackRedraw = longPress ? button->callbackLongPress() : button->callbackShortPress();
+  button->setPressed(false);
+  return callbackRedraw;
+}
+
+
 bool Menu::setActiveButton(MenuButton *activeButton) {
   bool newButtonActive = false;
   #ifdef MENU_ACTIVEBUTTON_DEBUG
   Serial.println("Set Active Button for Active Page");
   #endif
 
-  auto topMenu = topMenus->begin();
-  for (; topMenu != topMenus->end(); topMenu++) {
-    if ((*topMenu)->isActive()) {
-      #ifdef MENU_ACTIVEBUTTON_DEBUG
-      Serial.print("Set Active Button for ");
-      Serial.println((*topMenu)->getName());
-      #endif
-      newButtonActive = (*topMenu)->setActiveMenuButton(activeButton);
-    }
+  MenuPage *activeMenu = getActiveTopMenu();
+  if (activeMenu) {
+    #ifdef MENU_ACTIVEBUTTON_DEBUG
+    Serial.print("Set Active Button for ");
+    Serial.println(activeMenu->getName());
+    #endif
+    newButtonActive = activeMenu->setActiveMenuButton(activeButton);
   }
 
   return newButtonActive;
 }
 
 
+//
+// Set the Top Menu button to be active
+// Set the previously active top menu button as inactive
+//
 bool Menu::setActiveTopMenu(MenuPage *activeMenu) {
   #ifdef MENU_ACTIVEBUTTON_DEBUG
   Serial.print("Set Active Page for ");
   Serial.println(activeMenu->getName());
   #endif
 
-  bool newMenuFound = setActiveTopMenu(topMenus, activeMenu);
-  if (newMenuFound) {
-    #ifdef MENU_ACTIVEBUTTON_DEBUG
-    Serial.println("New Menu Active - Clear Screen");
-    #endif
-    clearScreenBeforeDraw = true;
+  if (!activeMenu) {
+    return false;
   }
-  return newMenuFound;
-}
 
+  int16_t pageIndex = activeMenu->getMenuIndex();
+  if (pageIndex < 0 || pageIndex >= topMenuCount || getTopMenu(pageIndex) != activeMenu) {
+    // Layout has not numbered the pages yet
+    for (pageIndex = 0; pageIndex < topMenuCount && getTopMenu(pageIndex) != activeMenu; pageIndex++);
+    if (pageIndex >= topMenuCount) {
+      return false;
+    }
+  }
 
-//
-// Find and set the Top Menu button to be active
-// Set all other top menu buttons as inactive
-//
-bool Menu::setActiveTopMenu(vector<MenuPage*> *tMenus, MenuPage *activeMenu) {
-  bool newMenuFound = false;
+  if (pageIndex == activePage) {
+    return false;
+  }
+
+  // The old page gives back its resources before the new page loads its own
+  if (activePage >= 0) {
+    MenuPage *oldMenu = getTopMenu(activePage);
+    oldMenu->setInactive();
+    oldMenu->leave();
+  }
+  activeMenu->setActive();
+  activePage = pageIndex;
+  activeMenu->enter();
 
   #ifdef MENU_ACTIVEBUTTON_DEBUG
-  Serial.println("Set Active Page");
+  Serial.println("New Menu Active - Clear Screen");
   #endif
+  clearScreenBeforeDraw = true;
+  return true;
+}
 
-  auto topMenu = tMenus->begin();
-  for (; topMenu != tMenus->end(); topMenu++) {
-    // Set as active
-    if ((*topMenu) == activeMenu) {
-      #ifdef MENU_ACTIVEBUTTON_DEBUG
-      Serial.print("Set Active Page ");
-      Serial.println((*topMenu)->getName());
-      #endif
-      if (!(*topMenu)->isActive()) {
-        (*topMenu)->setActive();
-        newMenuFound = true;
-      }
+//
+// Have the page shown load its state again and redraw it all on the next draw
+//
+void Menu::refreshActiveTopMenu() {
+  MenuPage *activeMenu = getActiveTopMenu();
+  if (activeMenu) {
+    activeMenu->refresh();
+    clearScreenBeforeDraw = true;
+  }
+}
+
+//
+// Replace the pages shown across the top, for example with pages loaded at runtime.
+// The page shown stays active if it is in the new list, otherwise the first page is shown.
+// Pages already laid out in the same panel keep their layout.
+//
+// @return false if there are more pages than the menu has room for
+//
+bool Menu::setTopMenus(MenuPage* const *tMenus, uint8_t tMenuCount) {
+  if (tMenuCount > topMenuCapacity) {
+    Serial.print("Menu has room for ");
+    Serial.print(topMenuCapacity);
+    Serial.print(" pages, not ");
+    Serial.println(tMenuCount);
+    return false;
+  }
+
+  MenuPage *shownMenu = getActiveTopMenu();
+  pressedPage = nullptr;
+  pressedButton = nullptr;
+  topMenus = tMenus;
+  topMenuCount = tMenuCount;
+  topScroll = 0;
+  activePage = -1;
+  calculateLayout();
+
+  // Keep the shown page if it is still in the menu
+  for (uint8_t pageIndex = 0; pageIndex < topMenuCount; pageIndex++) {
+    if (getTopMenu(pageIndex) == shownMenu) {
+      activePage = pageIndex;
     }
-    else {
-      // Set all others as inactive
-      (*topMenu)->setInactive();
+  }
+  if (activePage < 0) {
+    if (shownMenu) {
+      shownMenu->setInactive();
+      shownMenu->leave();
+    }
+    if (topMenuCount > 0) {
+      setActiveTopMenu(getTopMenu(0));
     }
   }
 
-  return newMenuFound;
+  clearScreenBeforeDraw = true;
+  return true;
 }
 
+
 //
 // Handle a Touch Event by checking if any of the buttons were touched.
 // If a MenuTop was pressed, then change the screen accordingly
@@ -295,21 +424,15 @@ MenuButton* Menu::findTouchedButton(int16_t pressX, int16_t pressY) {
 
   MenuButton *buttonPressed = nullptr;
 
-  if (pressY > topButtonHeight) {
+  MenuPage *activeMenu = getActiveTopMenu();
+  if (pressY > topButtonHeight && activeMenu) {
     // Panel button press
     #ifdef MENU_FINDBUTTON_DEBUG
     Serial.println("Panel");
+    Serial.print("Top Menu Button ");
+    Serial.println(activeMenu->getName());
     #endif
-    auto topMenu = topMenus->begin();
-    for (; topMenu != topMenus->end(); topMenu++) {
-      if ((*topMenu)->isActive()) {
-        #ifdef MENU_FINDBUTTON_DEBUG
-        Serial.print("Top Menu Button ");
-        Serial.println((*topMenu)->getName());
-        #endif
-        buttonPressed = (*topMenu)->findTouchedButton(pressX, pressY, panelX, panelY, panelWidth, panelHeight);
-      }
-    }
+    buttonPressed = activeMenu->findTouchedButton(pressX, pressY);
   }
   return buttonPressed;
 }
@@ -328,30 +451,20 @@ MenuPage* Menu::findTouchedTopButton(int16_t pressX, int16_t pressY) {
     #ifdef MENU_FINDBUTTON_DEBUG
     Serial.println("Top Menu");
     #endif
-    if (topMenus) {
+    if (topMenuCount) {
       #ifdef MENU_FINDBUTTON_DEBUG
       Serial.println("Looking for Top Menu Button");
       #endif
-      int16_t pos = 0;
-      int16_t visiblePos = 0;
-      auto topMenu = topMenus->begin();
-      for (; topMenu != topMenus->end(); topMenu++) {
-
-        if (startPage <= pos && pos < (startPage + DEFAULT_PAGETOP_BUTTONS)) {
-          // Button in visible range
-
-          int16_t buttonTopLeftX = visiblePos * topButtonWidth;
-          int16_t buttonTopRightX = buttonTopLeftX + topButtonWidth;
-          if (buttonTopLeftX < pressX && pressX < buttonTopRightX) {
-            buttonPressed = (*topMenu);
-            #ifdef MENU_FINDBUTTON_DEBUG
-            Serial.print("Top Menu Button ");
-            Serial.println(buttonPressed->getName());
-            #endif
-          }
-          visiblePos++;
-        }
-        pos++;
+      int16_t stripX = pressX - DEFAULT_PAGETOP_NEXT_BUTTON_SIZE;
+      int16_t topButton = findTopButtonAt(stripX);
+
+      // Only buttons drawn completely in the strip can be touched
+      if (topButton >= 0 && (topOffsets[topButton + 1] - topScroll) <= topStripWidth) {
+        buttonPressed = getTopMenu(topButton);
+        #ifdef MENU_FINDBUTTON_DEBUG
+        Serial.print("Top Menu Button ");
+        Serial.println(buttonPressed->getName());
+        #endif
       }
     }
   }
@@ -359,14 +472,92 @@ MenuPage* Menu::findTouchedTopButton(int16_t pressX, int16_t pressY) {
 }
 
 
+//
+// Binary search for the top button at a pixel position in the visible strip
+//
+// @return index of the top button or -1 if there is none
+//
+int16_t Menu::findTopButtonAt(int16_t stripX) {
+  if (stripX < 0 || stripX >= topStripWidth || topMenuCount == 0) {
+    return -1;
+  }
+
+  int16_t offset = stripX + topScroll;
+  if (offset >= topOffsets[topMenuCount]) {
+    return -1;
+  }
+
+  return (upper_bound(topOffsets, topOffsets + topMenuCount + 1, offset) - topOffsets) - 1;
+}
+
+
+//
+// Largest scroll position that starts on a top button and still shows the last top button
+//
+int16_t Menu::maxTopScroll() {
+  if (topMenuCount == 0) {
+    return 0;
+  }
+
+  // First button that all the remaining buttons fit after
+  return *lower_bound(topOffsets, topOffsets + topMenuCount, topOffsets[topMenuCount] - topStripWidth);
+}
+
+
+//
+// Move the top buttons to the left so the first partly hidden button on the right
+// becomes the first button shown.
+//
+// @return true if the top buttons moved
+//
+bool Menu::scrollTopLeft() {
+  int16_t maxScroll = maxTopScroll();
+  if (topScroll >= maxScroll) {
+    return false;
+  }
+
+  int16_t hiddenButton = (upper_bound(topOffsets, topOffsets + topMenuCount + 1, topScroll + topStripWidth) - topOffsets) - 1;
+  int16_t newScroll = min(topOffsets[hiddenButton], maxScroll);
+  if (newScroll <= topScroll) {
+    // Always move at least one button
+    newScroll = *upper_bound(topOffsets, topOffsets + topMenuCount + 1, topScroll);
+  }
+  topScroll = min(newScroll, maxScroll);
+  clearTopBeforeDraw = true;
+  return true;
+}
+
+
+//
+// Move the top buttons to the right so the first button shown
+// becomes the last button shown.
+//
+// @return true if the top buttons moved
+//
+bool Menu::scrollTopRight() {
+  if (topScroll <= 0) {
+    return false;
+  }
+
+  topScroll = *lower_bound(topOffsets, topOffsets + topMenuCount + 1, topScroll - topStripWidth);
+  clearTopBeforeDraw = true;
+  return true;
+}
+
+
 /*
  * Handle any touch screen actions
  */
 void Menu::eventHandler(Event *event) {
   bool redraw = false;
+  bool redrawChanged = false;
 
   pressedButton = nullptr;  // New press, don't know button yet
   pressedPage = nullptr;  // New press, don't know button yet
+  uint32_t eventStart = millis();
+  #ifdef MENU_BENCHMARK
+  uint32_t benchmarkStart = ESP.getCycleCount();
+  #endif
   // Figure out which button was pressed
   if (event->pressY < topButtonHeight) {
     #ifdef MENU_HANDLE_DEBUG
@@ -379,7 +570,16 @@ void Menu::eventHandler(Event *event) {
     Serial.println("Button Panel Area");
     #endif
     pressedButton = findTouchedButton(event->pressX, event->pressY);
+    if (pressedButton && pressedButton->isDisabled()) {
+      // Disabled buttons ignore touches
+      pressedButton = nullptr;
+    }
   }
+  #ifdef MENU_BENCHMARK
+  uint32_t benchmarkCycles = ESP.getCycleCount() - benchmarkStart;
+  Serial.print("Touch lookup cycles: ");
+  Serial.println(benchmarkCycles);
+  #endif
 
   #ifdef MENU_HANDLE_DEBUG
   Serial.println("Do Event: ");
@@ -391,11 +591,10 @@ void Menu::eventHandler(Event *event) {
         #ifdef MENU_HANDLE_DEBUG
         Serial.println("Do Swipe Left Event");
         #endif
-        if (startPage < (int) (topMenus->size() - DEFAULT_PAGETOP_BUTTONS)) {
+        if (topMenuCount) {
           // Finger moving to Left
-          // Move Top Buttons to Right
-          startPage++;
-          redraw = true;
+          // Move Top Buttons to Left to show more on the Right
+          redraw = scrollTopLeft();
         }
         break;
 
@@ -403,11 +602,25 @@ void Menu::eventHandler(Event *event) {
         #ifdef MENU_HANDLE_DEBUG
         Serial.println("Do Swipe Right Event");
         #endif
-        if (startPage > 0 ) {
+        if (topMenuCount) {
           // Finger moving to Right
-          // Move Top Buttons to Left
-          startPage--;
-          redraw = true;
+          // Move Top Buttons to Right to show more on the Left
+          redraw = scrollTopRight();
+        }
+        break;
+
+    case EVENT_FLING_LEFT:
+    case EVENT_FLING_RIGHT:
+        #ifdef MENU_HANDLE_DEBUG
+        Serial.print("Do Fling Event ");
+        Serial.println(event->velocityX);
+        #endif
+        // Scroll a strip of top buttons and another for each MENU_FLING_STRIP_VELOCITY
+        if (topMenuCount) {
+          int16_t strips = 1 + abs(event->velocityX) / MENU_FLING_STRIP_VELOCITY;
+          while (strips-- > 0 && ((event->event == EVENT_FLING_LEFT) ? scrollTopLeft() : scrollTopRight())) {
+            redraw = true;
+          }
         }
         break;
 
@@ -431,12 +644,16 @@ void Menu::eventHandler(Event *event) {
           Serial.print("Do Button Long Event: ");
           Serial.println(pressedButton->getName());
           #endif
-          bool set_redraw = setActiveButton(pressedButton);
-          bool callback_redraw = pressedButton->callbackLongPress();
-          redraw = set_redraw || callback_redraw;
+          setActiveButton(pressedButton);
+          bool callback_redraw = callbackButton(pressedButton, true);
+          // Only the buttons that changed state need drawing unless the callback changed more
+          redraw = callback_redraw;
+          redrawChanged = true;
         }
         break;
 
+    case EVENT_DOUBLE:
+        // The second tap of a double tap presses the button again
     case EVENT_SHORT:
         // Handle any Short Press callback actions
         // Long press is fired as soon as it occurs
@@ -448,8 +665,10 @@ void Menu::eventHandler(Event *event) {
           Serial.print("Do Page Short Event: ");
           Serial.println(pressedPage->getName());
           #endif
+          // A page that was just entered has loaded its state in its enter hook,
+          // the short press callback is for pressing the page already shown
           bool set_redraw = setActiveTopMenu(pressedPage);
-          bool callback_redraw = pressedPage->callbackShortPress();
+          bool callback_redraw = set_redraw ? false : pressedPage->callbackShortPress();
           redraw = set_redraw || callback_redraw;
         }
         else if (pressedButton) {
@@ -457,9 +676,11 @@ void Menu::eventHandler(Event *event) {
           Serial.print("Do Button Short Event: ");
           Serial.println(pressedButton->getName());
           #endif
-          bool set_redraw = setActiveButton(pressedButton);
-          bool callback_redraw = pressedButton->callbackShortPress();
-          redraw = set_redraw || callback_redraw;
+          setActiveButton(pressedButton);
+          bool callback_redraw = callbackButton(pressedButton, false);
+          // Only the buttons that changed state need drawing unless the callback changed more
+          redraw = callback_redraw;
+          redrawChanged = true;
         }
         break;
 
@@ -477,6 +698,32 @@ void Menu::eventHandler(Event *event) {
     #endif
     draw();
   }
+  else if (redrawChanged) {
+    drawChangedButtons();
+  }
+
+  // Record what was pressed, the recorder only copies it so the touch is not slowed down
+  if (eventRecorder && event->event != EVENT_NONE && event->event != EVENT_DRAG && event->event != EVENT_DRAG_END) {
+    int16_t pageIndex = activePage;
+    int16_t buttonIndex = -1;
+    if (pressedPage) {
+      pageIndex = pressedPage->getMenuIndex();
+    }
+    else if (pressedButton) {
+      buttonIndex = pressedButton->getPageIndex();
+    }
+    eventRecorder(event->event, pageIndex, buttonIndex, millis() - eventStart);
+  }
 
 }
 
+
+//
+// Print the heap held by each page
+//
+void Menu::printPageMemory(Print &p) {
+  p.println(F("Page\tstate\tenters\tin use\tpeak\tbudget\tkept\tover"));
+  for (uint8_t pageIndex = 0; pageIndex < topMenuCount; pageIndex++) {
+    getTopMenu(pageIndex)->printMemory(p);
+  }
+}
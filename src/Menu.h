@@ -18,16 +18,27 @@
 #include <Adafruit_GFX.h>
 #include <Adafruit_ILI9341.h>
 #include <XPT2046_Touchscreen.h>
-#include <vector>
-#include <tuple>
+#include <algorithm>
 #include "MenuPage.h"
 #include "TouchHandler.h"
 
 using namespace std;
 
 // Menu Defaults
-#define DEFAULT_BACKGROUND_COLOR ILI9341_BLACK    // Default background
+#define DEFAULT_BACKGROUND_COLOR THEME_BACKGROUND // Default theme background
 #define DEFAULT_BAR_HEIGHT DEFAULT_BUTTON_CORNER  // Default height of menu page separator bar
+#define MENU_FLING_STRIP_VELOCITY 800   // Fling pixels per second for each extra strip of top buttons scrolled
+
+
+/*!
+ * @brief Function recording each touch event the Menu handled
+ *
+ * @param TouchEvent event that was handled
+ * @param int16_t index of the page pressed or shown, -1 if none
+ * @param int16_t index of the button pressed in its page, -1 if a page or nothing was pressed
+ * @param uint32_t milliseconds taken to handle the event, including the callbacks and drawing
+ */
+typedef void (*MenuEventRecorder)(TouchEvent, int16_t, int16_t, uint32_t);
 
 
 /*********************
@@ -39,54 +50,112 @@ using namespace std;
 //
 class Menu {
   public:
-    Menu(Adafruit_GFX *tft);
-    Menu(Adafruit_GFX *tft, vector<MenuPage*> *tMenus = nullptr);
-    Menu(Adafruit_GFX *tft, vector<MenuPage*> *tMenus, uint16_t bgColor);
-    
+    Menu(Adafruit_GFX *tft, MenuPage* const *tMenus, uint8_t tMenuCount, uint8_t tMenuCapacity, int16_t *offsetStorage, ThemeRole bgColor = DEFAULT_BACKGROUND_COLOR);
+
 
     void setTopButtons(int16_t buttons);
     void setTopHeight(int16_t height);
+    void setTheme(const MenuTheme *theme);
 
     bool setup();
+    void calculateLayout();
     void draw();
+    void drawChangedButtons();
 
     void eventHandler(Event *event);
+    /*!
+     * @brief Set the function recording each touch event handled, nullptr for none
+     */
+    void setEventRecorder(MenuEventRecorder recorder) {eventRecorder = recorder;};
 
     bool setActiveButton(MenuButton *activeButton);
     bool setActiveTopMenu(MenuPage *activeMenu);
-    static bool setActiveTopMenu(vector<MenuPage*> *tMenus, MenuPage *activeMenu);
+    bool setTopMenus(MenuPage* const *tMenus, uint8_t tMenuCount);
+    void refreshActiveTopMenu();
+
+    /*!
+     * @brief return the active page or nullptr if no page is active
+     */
+    MenuPage* getActiveTopMenu() {return (activePage >= 0) ? getTopMenu(activePage) : nullptr;};
+
+    /*!
+     * @brief return the number of pages in the top menu
+     */
+    uint8_t getTopMenuCount() {return topMenuCount;};
+
+    /*!
+     * @brief return the page at a position in the top menu
+     */
+    MenuPage* getTopMenu(uint8_t pageIndex) {return (MenuPage*) pgm_read_ptr(&topMenus[pageIndex]);};
+
+    void printPageMemory(Print &p);
 
   private:
     MenuPage* findTouchedTopButton(int16_t pressX, int16_t pressY);
+    int16_t findTopButtonAt(int16_t stripX);
+    int16_t maxTopScroll();
+    bool scrollTopLeft();
+    bool scrollTopRight();
     MenuButton* findTouchedButton(int16_t pressX, int16_t pressY);
-
-    void init(Adafruit_GFX *tft, vector<MenuPage*> *tMenus = nullptr, uint16_t bgColor = DEFAULT_BACKGROUND_COLOR);
-    void calculateTopButtonDimensions();
+    bool callbackButton(MenuButton *button, bool longPress);
 
     Adafruit_GFX *_tft;
 
-    uint16_t backgroundColor;
-    int16_t screenWidth;
-    int16_t screenHeight;
+    ThemeRole backgroundColor;
+    int16_t screenWidth = 0;
+    int16_t screenHeight = 0;
     int16_t topButtons = DEFAULT_PAGETOP_BUTTONS;
     int16_t topHeight = DEFAULT_PAGETOP_HEIGHT;
-    int16_t topButtonWidth = 0;
+    int16_t topButtonWidth = 0;   // Minimum width of a top button
+    int16_t topStripWidth = 0;    // Width of the area between the next button indicators
     int16_t topButtonHeight = 0;
     int16_t panelX = 0;
     int16_t panelY = 0;
     int16_t panelWidth = 0;
     int16_t panelHeight = 0;
-    int startPage = 0;
+    int16_t *topOffsets;          // Pixel offset of each top button from the start of the strip, plus the total width
+    int16_t topScroll = 0;        // Pixel offset of the strip shown at the left edge
+    int16_t activePage = -1;      // Index of the active page in topMenus or -1 if none
     bool clearScreenBeforeDraw = true;
+    bool clearTopBeforeDraw = false;
 
-    vector<MenuPage*> *topMenus = nullptr;
+    MenuPage* const *topMenus;    // PROGMEM or RAM list of the pages
+    uint8_t topMenuCount;         // Number of pages in topMenus
+    uint8_t topMenuCapacity;      // Most pages topOffsets has room for
 
     MenuPage *pressedPage = nullptr;
     MenuButton *pressedButton = nullptr;
+    MenuEventRecorder eventRecorder = nullptr;  // Function recording each touch event handled
 
 };
 
 
+/*********************
+ * MenuTree template
+ *********************/
+
+//
+// A Menu with the top button offsets sized at compile time.
+// Pages is the most pages the menu can show, including any page list set later with setTopMenus.
+//
+template <uint8_t Pages>
+class MenuTree: public Menu {
+  public:
+    /*!
+     * @brief Constructor. The pages must fit in Pages, checked at compile time.
+     * @param tft     Screen to draw the menu on
+     * @param tMenus  PROGMEM list of the pages shown across the top
+     * @param bgColor Theme background color
+     */
+    template <size_t Count>
+    MenuTree(Adafruit_GFX *tft, MenuPage* const (&tMenus)[Count], ThemeRole bgColor = DEFAULT_BACKGROUND_COLOR)
+        : Menu(tft, tMenus, Count, Pages, offsets, bgColor) {
+      static_assert(Count <= Pages, "More pages than the menu capacity");
+    };
+
+  private:
+    int16_t offsets[Pages + 1];
+};
 
 
 #endif
\ No newline at end of file
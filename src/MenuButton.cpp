@@ -12,6 +12,7 @@
 
 #include <Arduino.h>
 #include "MenuButton.h"
+#include "MenuPage.h"
 #include <Adafruit_GFX.h>
 #include <Adafruit_ILI9341.h>
 #include <XPT2046_Touchscreen.h>
@@ -27,21 +28,9 @@ using namespace std;
 /*
  * Constructor
  *
- * @param label       Label or name display on button
- * @param x,y         X and Y button position (not pixel position)
- * @param buttonColor Optional button color. Default is DEFAULT_BUTTON_COLOR
- * @param onShortPress Optional callback function when a short press is performed
- * @param onLongPress Optional callback function when a long press is performed
+ * @param buttonDef   PROGMEM label, theme color, callbacks and grid position of the button
  */ 
-MenuButton::MenuButton(const char* label, int16_t x, int16_t y, uint16_t buttonColor, ButtonPressCallback onShortPress, ButtonPressCallback onLongPress) {
-  name = String(label);
-  positionX = x;
-  positionY = y;
-  color = buttonColor;
-  textSize = DEFAULT_BUTTON_TEXT_SIZE;
-  textColor = DEFAULT_BUTTON_COLOR;
-  shortPressCallback = onShortPress;
-  longPressCallback = onLongPress;
+MenuButton::MenuButton(const MenuButtonDef *buttonDef) : MenuItem(buttonDef, DEFAULT_BUTTON_TEXT_SIZE) {
 }
 
 
@@ -58,16 +47,81 @@ void MenuButton::draw(Adafruit_GFX *tft, int16_t topButtonX, int16_t topButtonY,
   Serial.println(topButtonY);
   #endif
 
-  drawButtonOutline(tft, topButtonX, topButtonY, topButtonWidth, topButtonHeight, color, active);
+  drawButtonOutline(tft, topButtonX, topButtonY, topButtonWidth, topButtonHeight, getDrawColor(), isFilled());
 
   int16_t centerX = topButtonX + (topButtonWidth/2);
   int16_t centerY = topButtonY + (topButtonHeight/2);
 
-  centerText(tft, name, centerX, centerY, textSize, textColor);
+  centerText(tft, name, centerX, centerY, textSize, getTextColor());
 
 }
 
 
+//
+// Set the button active and let its page know the state changed
+//
+void MenuButton::setActive() {
+  if (!active) {
+    active = true;
+    if (page) {
+      page->buttonStateChanged(pageIndex, true);
+    }
+  }
+}
+
+
+//
+// Set the button inactive and let its page know the state changed
+//
+void MenuButton::setInactive() {
+  if (active) {
+    active = false;
+    if (page) {
+      page->buttonStateChanged(pageIndex, false);
+    }
+  }
+}
+
+
+//
+// Set the button stale or confirmed and let its page know the state changed
+//
+void MenuButton::setStale(bool s) {
+  if (stale != s) {
+    stale = s;
+    if (page) {
+      page->buttonStateChanged(pageIndex, active);
+    }
+  }
+}
+
+
+//
+// Set the button pressed or released and let its page know the state changed
+//
+void MenuButton::setPressed(bool p) {
+  if (pressed != p) {
+    pressed = p;
+    if (page) {
+      page->buttonStateChanged(pageIndex, active);
+    }
+  }
+}
+
+
+//
+// Set the button disabled or enabled and let its page know the state changed
+//
+void MenuButton::setDisabled(bool d) {
+  if (disabled != d) {
+    disabled = d;
+    if (page) {
+      page->buttonStateChanged(pageIndex, active);
+    }
+  }
+}
+
+
 //
 // Check to see if the button was touched.
 //
@@ -92,7 +146,7 @@ bool MenuButton::handleTouch() {
 // If the button is inactive only the outline is drawn
 // If the button is active a solid button is drawn
 //
-void drawButtonOutline(Adafruit_GFX *tft, int16_t buttonX, int16_t buttonY, int16_t buttonWidth, int16_t buttonHeight, uint16_t buttonColor, bool buttonActive) {
+void drawButtonOutline(Adafruit_GFX *tft, int16_t buttonX, int16_t buttonY, int16_t buttonWidth, int16_t buttonHeight, const ThemeColor &buttonColor, bool buttonActive) {
 /*
   if ((buttonX < 0) || (buttonX >= BUTTONS_X )) {
     // X is out of Range
@@ -108,11 +162,11 @@ void drawButtonOutline(Adafruit_GFX *tft, int16_t buttonX, int16_t buttonY, int1
   int16_t topLeftY = buttonY + DEFAULT_PADDING_Y;
   int16_t width = buttonWidth - (2*DEFAULT_PADDING_X);
   int16_t height = buttonHeight - (2*DEFAULT_PADDING_Y);
-  tft->fillRect(topLeftX, topLeftY, width, height, DEFAULT_BUTTON_BACKGROUND_COLOR);
+  tft->fillRect(topLeftX, topLeftY, width, height, getThemeColor(DEFAULT_BUTTON_BACKGROUND_COLOR).base);
   if (buttonActive) {
-    tft->fillRoundRect(topLeftX, topLeftY, width, height, DEFAULT_BUTTON_CORNER, buttonColor);
+    tft->fillRoundRect(topLeftX, topLeftY, width, height, DEFAULT_BUTTON_CORNER, buttonColor.base);
   }
   else {
-    tft->drawRoundRect(topLeftX, topLeftY, width, height, DEFAULT_BUTTON_CORNER, buttonColor);
+    tft->drawRoundRect(topLeftX, topLeftY, width, height, DEFAULT_BUTTON_CORNER, buttonColor.base);
   }
 }
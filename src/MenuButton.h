@@ -24,16 +24,31 @@
 
 using namespace std;
 
+class MenuPage;
+
 // MenuButton Defaults
 #define DEFAULT_PADDING_X 2                       // Default horizontal padding in pixels
 #define DEFAULT_PADDING_Y 2                       // Default vertical padding in pixels
 #define DEFAULT_BUTTON_CORNER 8                   // Default roundness of corners in pixels
-#define DEFAULT_BUTTON_COLOR ILI9341_CYAN         // Default color of the button background
-#define DEFAULT_BUTTON_TEXT_COLOR ILI9341_WHITE   // Default color of the button text
+#define DEFAULT_BUTTON_COLOR THEME_BUTTON          // Default theme color of the button
 #define DEFAULT_BUTTON_TEXT_SIZE 2                // Default size of the button text
+#define DEFAULT_BUTTON_BACKGROUND_COLOR THEME_BACKGROUND  // Default theme background
 
-// @FIXME move to variable
-#define DEFAULT_BUTTON_BACKGROUND_COLOR ILI9341_BLACK    // Default background
+
+/*********************
+ * MenuButton definition
+ *********************/
+
+//
+// Settings of a MenuButton that never change, kept in PROGMEM.
+// Position and span are in grid cells, not pixels.
+//
+struct MenuButtonDef: MenuItemDef {
+  int16_t x;          // Button Number Position X
+  int16_t y;          // Button Number Position Y
+  int16_t spanX = 1;  // Number of grid cells covered across
+  int16_t spanY = 1;  // Number of grid cells covered down
+};
 
 
 /*********************
@@ -45,28 +60,58 @@ using namespace std;
 //
 class MenuButton: public MenuItem {
   public:
-    MenuButton(const char* label, int16_t x, int16_t y, uint16_t buttonColor = DEFAULT_BUTTON_COLOR, ButtonPressCallback onShortPress = nullptr, ButtonPressCallback onLongPress = nullptr);  // Constructor
+    MenuButton(const MenuButtonDef *buttonDef);  // Constructor
     void draw(Adafruit_GFX *tft, int16_t buttonX, int16_t buttonY, int16_t buttonWidth, int16_t buttonHeight);
     bool handleTouch();
 
+    void setActive();
+    void setInactive();
+    void setStale(bool s);
+    void setPressed(bool p);
+    void setDisabled(bool d);
+
+    /*!
+     * @brief Record the page this button is laid out on and its index in that page
+     */
+    void setPage(MenuPage *p, uint8_t index) {page = p; pageIndex = index;};
+    /*!
+     * @brief return the page this button is laid out on or nullptr
+     */
+    MenuPage* getPage() {return page;};
+    /*!
+     * @brief return the index of this button in its page
+     */
+    uint8_t getPageIndex() {return pageIndex;};
+
     /*!
      * @brief return the button number position X
      */
-    int16_t getPositionX() {return positionX;};
+    int16_t getPositionX() {return pgm_read_word(&buttonDef()->x);};
     /*!
      * @brief return the button number position Y
      */
-    int16_t getPositionY() {return positionY;};
+    int16_t getPositionY() {return pgm_read_word(&buttonDef()->y);};
     /*!
      * @brief return the button number position
      * @param int16_t* pointer to return the X button position number
      * @param int16_t* pointer to return the Y button position number
      */
-    void getPosition(int16_t *posX, int16_t *posY) {*posX = positionX; *posY = positionY;};
+    void getPosition(int16_t *posX, int16_t *posY) {*posX = getPositionX(); *posY = getPositionY();};
+
+    /*!
+     * @brief return the number of grid cells the button covers across
+     */
+    int16_t getSpanX() {return pgm_read_word(&buttonDef()->spanX);};
+    /*!
+     * @brief return the number of grid cells the button covers down
+     */
+    int16_t getSpanY() {return pgm_read_word(&buttonDef()->spanY);};
 
   private:
-    int16_t positionX;  // Button Number Position X - not pixels
-    int16_t positionY;  // Button Number Position Y - not pixels
+    const MenuButtonDef* buttonDef() {return static_cast<const MenuButtonDef*>(def);};
+
+    MenuPage *page = nullptr; // Page tracking the active state of this button
+    uint8_t pageIndex = 0;    // Index of this button in the page
 
 
   private:
@@ -77,6 +122,6 @@ class MenuButton: public MenuItem {
  * Non Class Functions
  *********************/
 
-void drawButtonOutline(Adafruit_GFX *tft, int16_t buttonX, int16_t buttonY, int16_t buttonWidth, int16_t buttonHeight, uint16_t buttonColor, bool buttonActive);
+void drawButtonOutline(Adafruit_GFX *tft, int16_t buttonX, int16_t buttonY, int16_t buttonWidth, int16_t buttonHeight, const ThemeColor &buttonColor, bool buttonActive);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,149 @@
+/*
+ * @file MenuGrid.h
+ *
+ * A MenuGrid is a button panel layout fixed at compile time.
+ * The button panel is always the same size on the ILI9341 in landscape
+ * so the pixel rectangle of every grid cell can be calculated by the
+ * compiler and kept in flash.
+ *
+ * Converting a touch into a grid cell uses a multiply and shift by a
+ * reciprocal of the cell size.  The compiler checks the reciprocal
+ * gives the same answer as a division for every pixel in the panel.
+ *
+ * A MenuTreePage uses the table of its MenuGrid instead of calculating
+ * the layout at runtime, as long as the panel matches the grid's panel.
+ */
+#pragma once
+
+#ifndef __MENUGRID_H
+#define __MENUGRID_H
+
+#include <Arduino.h>
+#include <Adafruit_ILI9341.h>
+#include <array>
+#include "MenuUtils.h"
+
+// Fixed panel geometry for the ILI9341 in landscape (rotation 1)
+// Must match the Menu defaults for the grid to be used.
+#define MENUGRID_SCREEN_WIDTH ILI9341_TFTHEIGHT
+#define MENUGRID_SCREEN_HEIGHT ILI9341_TFTWIDTH
+#define MENUGRID_PANEL_X 0
+#define MENUGRID_PANEL_Y (DEFAULT_PAGETOP_HEIGHT + 1)
+#define MENUGRID_PANEL_WIDTH MENUGRID_SCREEN_WIDTH
+#define MENUGRID_PANEL_HEIGHT (MENUGRID_SCREEN_HEIGHT - MENUGRID_PANEL_Y)
+
+#define MENUGRID_RECIPROCAL_SHIFT 16   // Fixed point position of the cell size reciprocals
+
+
+/*********************
+ * MenuGridTable
+ *********************/
+
+//
+// Layout of a fixed grid as read by MenuPage.
+// cells points to flash and must be read with memcpy_P.
+//
+struct MenuGridTable {
+  MenuRect panel;           // Pixel area of the button panel
+  int16_t across;           // Number of cells across
+  int16_t down;             // Number of cells down
+  int16_t cellWidth;        // Pixel width of one cell
+  int16_t cellHeight;       // Pixel height of one cell
+  uint32_t reciprocalX;     // 2^16 / cellWidth rounded up
+  uint32_t reciprocalY;     // 2^16 / cellHeight rounded up
+  const MenuRect *cells;    // Pixel rectangle of each cell, row by row, in PROGMEM
+
+  /*!
+   * @brief Convert a pixel offset from the left of the panel to a cell column
+   */
+  int16_t columnAt(int16_t offsetX) const { return (offsetX * reciprocalX) >> MENUGRID_RECIPROCAL_SHIFT; };
+
+  /*!
+   * @brief Convert a pixel offset from the top of the panel to a cell row
+   */
+  int16_t rowAt(int16_t offsetY) const { return (offsetY * reciprocalY) >> MENUGRID_RECIPROCAL_SHIFT; };
+
+  /*!
+   * @brief Copy a cell rectangle out of flash
+   */
+  MenuRect cell(int16_t column, int16_t row) const {
+    MenuRect rect;
+    memcpy_P(&rect, &cells[row * across + column], sizeof(MenuRect));
+    return rect;
+  };
+};
+
+
+/*********************
+ * MenuGrid template
+ *********************/
+
+//
+// Compile time layout of a Across x Down grid in a fixed panel
+//
+template <int16_t PanelX, int16_t PanelY, int16_t PanelWidth, int16_t PanelHeight, int16_t Across, int16_t Down>
+class MenuGrid {
+  public:
+    static_assert(Across > 0 && Down > 0, "Grid needs at least one cell");
+    static_assert(Across * Down <= 0xFF, "Grid cells are indexed with a uint8_t");
+
+    static constexpr int16_t across = Across;
+    static constexpr int16_t down = Down;
+    static constexpr int16_t cellWidth = PanelWidth / Across;
+    static constexpr int16_t cellHeight = PanelHeight / Down;
+    static constexpr uint32_t reciprocalX = ((1UL << MENUGRID_RECIPROCAL_SHIFT) + cellWidth - 1) / cellWidth;
+    static constexpr uint32_t reciprocalY = ((1UL << MENUGRID_RECIPROCAL_SHIFT) + cellHeight - 1) / cellHeight;
+
+    static_assert(cellWidth > 0 && cellHeight > 0, "Grid cells must be at least one pixel");
+
+    //
+    // Check multiplying by the reciprocal matches dividing for every pixel in the panel
+    //
+    static constexpr bool reciprocalExact(int16_t size, int16_t cellSize, uint32_t reciprocal) {
+      for (int32_t offset = 0; offset < size; offset++) {
+        if (((offset * reciprocal) >> MENUGRID_RECIPROCAL_SHIFT) != (uint32_t)(offset / cellSize)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    static_assert(reciprocalExact(PanelWidth, cellWidth, reciprocalX), "Column reciprocal is not exact for this panel");
+    static_assert(reciprocalExact(PanelHeight, cellHeight, reciprocalY), "Row reciprocal is not exact for this panel");
+
+    //
+    // Pixel rectangle of every cell, row by row
+    //
+    static constexpr std::array<MenuRect, Across * Down> makeCells() {
+      std::array<MenuRect, Across * Down> rects = {};
+      for (int16_t row = 0; row < Down; row++) {
+        for (int16_t column = 0; column < Across; column++) {
+          rects[row * Across + column] = { (int16_t)(PanelX + column * cellWidth), (int16_t)(PanelY + row * cellHeight), cellWidth, cellHeight };
+        }
+      }
+      return rects;
+    }
+
+    static const std::array<MenuRect, Across * Down> cells;
+    static const MenuGridTable table;
+};
+
+template <int16_t PanelX, int16_t PanelY, int16_t PanelWidth, int16_t PanelHeight, int16_t Across, int16_t Down>
+const std::array<MenuRect, Across * Down> MenuGrid<PanelX, PanelY, PanelWidth, PanelHeight, Across, Down>::cells PROGMEM = makeCells();
+
+template <int16_t PanelX, int16_t PanelY, int16_t PanelWidth, int16_t PanelHeight, int16_t Across, int16_t Down>
+const MenuGridTable MenuGrid<PanelX, PanelY, PanelWidth, PanelHeight, Across, Down>::table = {
+  {PanelX, PanelY, PanelWidth, PanelHeight},
+  Across, Down,
+  cellWidth, cellHeight,
+  reciprocalX, reciprocalY,
+  cells.data()
+};
+
+//
+// Grid in the standard button panel
+//
+template <int16_t Across, int16_t Down>
+using PanelGrid = MenuGrid<MENUGRID_PANEL_X, MENUGRID_PANEL_Y, MENUGRID_PANEL_WIDTH, MENUGRID_PANEL_HEIGHT, Across, Down>;
+
+#endif
@@ -0,0 +1,494 @@
+/*
+ * MenuImage
+ *
+ * Menu tree loaded from a compiled binary image on LittleFS.
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "MenuImage.h"
+#include "RequestArena.h"
+#include "Crc32.h"
+
+// Uncomment the following define to debug loading the menu image
+//#define MENUIMAGE_DEBUG
+
+
+//
+// A page written in C++ that an image can place in the menu
+//
+struct RegisteredPage {
+  const char *name;     // PROGMEM name used by the image
+  MenuPage *page;       // Page to show
+};
+
+//
+// A callback that image buttons can use
+//
+struct RegisteredAction {
+  const char *name;               // PROGMEM name used by the image
+  ButtonPressCallback callback;   // Callback, bound callbacks get the number from the image
+};
+
+static StaticVector<RegisteredPage, MENUIMAGE_MAX_REGISTERED> registeredPages;
+static StaticVector<RegisteredAction, MENUIMAGE_MAX_REGISTERED> registeredActions;
+
+// Every grid an image page can use, by [down - 1][across - 1]
+static_assert(MENUIMAGE_MAX_ACROSS == 4 && MENUIMAGE_MAX_DOWN == 3, "imageGridTables must list every grid size");
+static const MenuGridTable* const imageGridTables[MENUIMAGE_MAX_DOWN][MENUIMAGE_MAX_ACROSS] PROGMEM = {
+  {&PanelGrid<1, 1>::table, &PanelGrid<2, 1>::table, &PanelGrid<3, 1>::table, &PanelGrid<4, 1>::table},
+  {&PanelGrid<1, 2>::table, &PanelGrid<2, 2>::table, &PanelGrid<3, 2>::table, &PanelGrid<4, 2>::table},
+  {&PanelGrid<1, 3>::table, &PanelGrid<2, 3>::table, &PanelGrid<3, 3>::table, &PanelGrid<4, 3>::table}
+};
+
+// Definitions the pools start with until an image is loaded
+static constexpr MenuPageDef emptyPageDef PROGMEM = {{nullptr, DEFAULT_PAGETOP_COLOR, nullptr, nullptr}};
+static constexpr MenuButtonDef emptyButtonDef PROGMEM = {{nullptr, DEFAULT_BUTTON_COLOR, nullptr, nullptr}, 0, 0};
+
+//
+// Pool button, points at its definition once an image is loaded
+//
+class MenuImageButton: public MenuButton {
+  public:
+    MenuImageButton() : MenuButton(&emptyButtonDef) {};
+};
+
+alignas(4) static uint8_t imageBuffer[MENUIMAGE_MAX_SIZE];   // Image in use, strings are used where they lie
+static bool imageValid = false;                             // Indicates imageBuffer holds the menu shown
+static MenuPageDef imagePageDefs[MENUIMAGE_MAX_PAGES];       // Definitions of the image pages, in RAM
+static MenuButtonDef imageButtonDefs[MENUIMAGE_MAX_BUTTONS]; // Definitions of the image buttons, in RAM
+static MenuImagePage imagePages[MENUIMAGE_MAX_PAGES];        // Pool of image pages
+static MenuImageButton imageButtons[MENUIMAGE_MAX_BUTTONS];  // Pool of image buttons
+static MenuPage *imageTopMenus[MENUIMAGE_MAX_TOP_PAGES];     // Pages across the top from the image
+
+static Menu *imageMenu = nullptr;                   // Menu the image is shown in
+static MenuPage* const *defaultTopMenus = nullptr;  // Built in pages used without an image
+static uint8_t defaultTopMenuCount = 0;             // Number of built in pages
+
+
+/*********************
+ * MenuImagePage Class functions
+ *********************/
+
+/*
+ * Constructor
+ * The page is empty until it is built from an image.
+ */
+MenuImagePage::MenuImagePage()
+    : MenuPage(&emptyPageDef, &PanelGrid<1, 1>::table, static_cast<ButtonList&>(*this), cells) {
+}
+
+
+//
+// Set the page up from the image.
+// The buttons keep their layout if the grid and button positions did not change.
+//
+// @param pageDef          Label and color of the page, in RAM
+// @param gridTable        Compile time layout of the page grid
+// @param pageButtons      Buttons on the page, their definitions already set
+// @param pageButtonCount  Number of buttons in pageButtons
+// @param pageLayoutHash   Hash of the grid and button positions from the image
+//
+void MenuImagePage::build(const MenuPageDef *pageDef, const MenuGridTable *gridTable, MenuButton* const *pageButtons, uint8_t pageButtonCount, uint32_t pageLayoutHash) {
+  setDef(pageDef);
+
+  MenuButton *first = pageButtonCount ? pageButtons[0] : nullptr;
+  if (gridTable == builtGrid && pageLayoutHash == layoutHash && first == firstButton && pageButtonCount == getButtonCount()) {
+    #ifdef MENUIMAGE_DEBUG
+    Serial.print("Menu image kept layout of page ");
+    Serial.println(getName());
+    #endif
+    return;
+  }
+
+  #ifdef MENUIMAGE_DEBUG
+  Serial.print("Menu image laying out page ");
+  Serial.println(getName());
+  #endif
+  clearButtons();
+  setGrid(gridTable);
+  for (uint8_t buttonIndex = 0; buttonIndex < pageButtonCount; buttonIndex++) {
+    addButton(pageButtons[buttonIndex]);
+  }
+  builtGrid = gridTable;
+  layoutHash = pageLayoutHash;
+  firstButton = first;
+}
+
+
+/*********************
+ * Image helper functions
+ *********************/
+
+//
+// Report why an image was rejected
+//
+// @return false so it can be returned by the check
+//
+static bool imageError(const char *reason, int32_t value = -1) {
+  Serial.print("Menu image invalid: ");
+  Serial.print(reason);
+  if (value >= 0) {
+    Serial.print(" ");
+    Serial.print(value);
+  }
+  Serial.println();
+  return false;
+}
+
+
+//
+// Indicate if a string offset is in the image, or is MENUIMAGE_NO_STRING when that is allowed
+//
+static bool imageStringValid(const MenuImageHeader *header, uint16_t offset, bool optional) {
+  if (offset == MENUIMAGE_NO_STRING) {
+    return optional;
+  }
+  return (uint32_t) header->stringsOffset + offset < header->size;
+}
+
+
+//
+// Return a string in a checked image or nullptr for MENUIMAGE_NO_STRING
+//
+static const char* imageString(const uint8_t *image, uint16_t offset) {
+  if (offset == MENUIMAGE_NO_STRING) {
+    return nullptr;
+  }
+  return (const char*) image + ((const MenuImageHeader*) image)->stringsOffset + offset;
+}
+
+
+//
+// Return the callback registered for an action name, bound to the number from the image
+//
+static ButtonPressCallback imageAction(const uint8_t *image, uint16_t offset, int32_t arg) {
+  const char *actionName = imageString(image, offset);
+  if (!actionName) {
+    return nullptr;
+  }
+
+  ButtonPressCallback callback = menuImageFindAction(actionName, arg);
+  if (!callback) {
+    Serial.print("Menu image action is not registered: ");
+    Serial.println(actionName);
+  }
+  return callback;
+}
+
+
+//
+// Show the pages of the image in the buffer, which has been checked
+//
+static bool applyImage() {
+  const MenuImageHeader *header = (const MenuImageHeader*) imageBuffer;
+  const MenuImagePageRecord *pageRecords = (const MenuImagePageRecord*) (imageBuffer + header->pagesOffset);
+  const MenuImageButtonRecord *buttonRecords = (const MenuImageButtonRecord*) (imageBuffer + header->buttonsOffset);
+  uint8_t topMenuCount = 0;
+  uint8_t imagePageCount = 0;
+
+  for (uint8_t pageIndex = 0; pageIndex < header->pageCount; pageIndex++) {
+    const MenuImagePageRecord &pageRecord = pageRecords[pageIndex];
+
+    // Page written in C++
+    if (pageRecord.builtin != MENUIMAGE_NO_STRING) {
+      const char *pageName = imageString(imageBuffer, pageRecord.builtin);
+      MenuPage *page = menuImageFindPage(pageName);
+      if (page) {
+        imageTopMenus[topMenuCount++] = page;
+      }
+      else {
+        Serial.print("Menu image page is not registered: ");
+        Serial.println(pageName);
+      }
+      continue;
+    }
+
+    // Page and buttons from the image
+    MenuButton *pageButtons[MENUIMAGE_MAX_ACROSS * MENUIMAGE_MAX_DOWN];
+    for (uint8_t buttonIndex = 0; buttonIndex < pageRecord.buttonCount; buttonIndex++) {
+      uint8_t poolIndex = pageRecord.firstButton + buttonIndex;
+      const MenuImageButtonRecord &buttonRecord = buttonRecords[poolIndex];
+      imageButtonDefs[poolIndex] = {{imageString(imageBuffer, buttonRecord.label), (ThemeRole) buttonRecord.color,
+                                     imageAction(imageBuffer, buttonRecord.shortAction, buttonRecord.shortArg),
+                                     imageAction(imageBuffer, buttonRecord.longAction, buttonRecord.longArg)},
+                                    buttonRecord.x, buttonRecord.y, buttonRecord.spanX, buttonRecord.spanY};
+      imageButtons[poolIndex].setDef(&imageButtonDefs[poolIndex]);
+      pageButtons[buttonIndex] = &imageButtons[poolIndex];
+    }
+
+    imagePageDefs[imagePageCount] = {{imageString(imageBuffer, pageRecord.label), (ThemeRole) pageRecord.color, nullptr, nullptr}};
+    const MenuGridTable *gridTable = (const MenuGridTable*) pgm_read_ptr(&imageGridTables[pageRecord.down - 1][pageRecord.across - 1]);
+    imagePages[imagePageCount].build(&imagePageDefs[imagePageCount], gridTable, pageButtons, pageRecord.buttonCount, pageRecord.layoutHash);
+    imageTopMenus[topMenuCount++] = &imagePages[imagePageCount];
+    imagePageCount++;
+  }
+
+  if (topMenuCount == 0) {
+    return imageError("no pages to show");
+  }
+  return imageMenu->setTopMenus(imageTopMenus, topMenuCount);
+}
+
+
+//
+// Go back to the pages built into the firmware
+//
+static void useDefaultMenus() {
+  imageValid = false;
+  if (imageMenu) {
+    imageMenu->setTopMenus(defaultTopMenus, defaultTopMenuCount);
+  }
+}
+
+
+/*********************
+ * Non Class Functions
+ *********************/
+
+//
+// Let images place a page written in C++ in the menu
+//
+// @param name PROGMEM name the image uses for the page
+// @param page Page to show
+// @return false if there is no room to register more pages
+//
+bool menuImageRegisterPage(const char *name, MenuPage *page) {
+  if (!registeredPages.push_back({name, page})) {
+    Serial.print("No room to register menu image page ");
+    Serial.println(FPSTR(name));
+    return false;
+  }
+  return true;
+}
+
+
+//
+// Let image buttons use a callback.
+// A bound callback gets the number the image gives the button.
+//
+// @param name     PROGMEM name the image uses for the action
+// @param callback Callback to call when the button is pressed
+// @return false if there is no room to register more actions
+//
+bool menuImageRegisterAction(const char *name, ButtonPressCallback callback) {
+  if (!registeredActions.push_back({name, callback})) {
+    Serial.print("No room to register menu image action ");
+    Serial.println(FPSTR(name));
+    return false;
+  }
+  return true;
+}
+
+
+//
+// Return the callback registered for an action name
+//
+// @param name Action name in RAM
+// @param arg  Number bound to a bound callback
+// @return the callback or nullptr if no action has the name
+//
+ButtonPressCallback menuImageFindAction(const char *name, int32_t arg) {
+  for (const RegisteredAction &action : registeredActions) {
+    if (strcmp_P(name, action.name) == 0) {
+      return action.callback.withIndex(arg);
+    }
+  }
+  return nullptr;
+}
+
+
+//
+// Return the page registered for a name
+//
+// @param name Page name in RAM
+// @return the page or nullptr if no page has the name
+//
+MenuPage* menuImageFindPage(const char *name) {
+  for (const RegisteredPage &registered : registeredPages) {
+    if (strcmp_P(name, registered.name) == 0) {
+      return registered.page;
+    }
+  }
+  return nullptr;
+}
+
+
+//
+// Load the menu image if there is one.
+// Call after the pages and actions are registered and LittleFS is started.
+//
+// @param menu             Menu to show the image in
+// @param defaultMenus     Pages to show when there is no image or it is not valid
+// @param defaultMenuCount Number of pages in defaultMenus
+//
+void menuImageSetup(Menu *menu, MenuPage* const *defaultMenus, uint8_t defaultMenuCount) {
+  imageMenu = menu;
+  defaultTopMenus = defaultMenus;
+  defaultTopMenuCount = defaultMenuCount;
+
+  if (LittleFS.exists(MENUIMAGE_PATH)) {
+    menuImageLoad(MENUIMAGE_PATH);
+  }
+  else {
+    Serial.println("No menu image, using the built in menu");
+  }
+}
+
+
+//
+// Replace the menu with the image in a file.
+// The file is checked before the image in use is overwritten, so a bad file leaves the menu unchanged.
+//
+// @return false if the file could not be used
+//
+bool menuImageLoad(const char *path) {
+  if (!menuImageCheckFile(path)) {
+    return false;
+  }
+
+  File file = LittleFS.open(path, "r");
+  size_t size = file ? file.size() : 0;
+  size_t bytesRead = file ? file.read(imageBuffer, size) : 0;
+  file.close();
+
+  // The buffer has been overwritten, so anything wrong now falls back to the built in menu
+  if (bytesRead != size || !menuImageValidate(imageBuffer, size)) {
+    imageError("unable to read", bytesRead);
+    useDefaultMenus();
+    return false;
+  }
+
+  imageValid = applyImage();
+  if (!imageValid) {
+    useDefaultMenus();
+    return false;
+  }
+
+  Serial.print("Menu image loaded from ");
+  Serial.println(path);
+  return true;
+}
+
+
+//
+// Check an image file without touching the image in use.
+// The file is read into the request arena for the check.
+//
+// @return true if the file holds a valid image
+//
+bool menuImageCheckFile(const char *path) {
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    return imageError("unable to open file");
+  }
+
+  size_t size = file.size();
+  if (size > MENUIMAGE_MAX_SIZE) {
+    file.close();
+    return imageError("too large", size);
+  }
+
+  RequestArenaScope arenaScope;
+  uint8_t *image = (uint8_t*) requestArena.allocate(size);
+  size_t bytesRead = image ? file.read(image, size) : 0;
+  file.close();
+  if (!image || bytesRead != size) {
+    return imageError("unable to read", bytesRead);
+  }
+  return menuImageValidate(image, size);
+}
+
+
+//
+// Check every offset and value in an image so it can be used without further checks
+//
+// @return true if the image is valid
+//
+bool menuImageValidate(const uint8_t *image, size_t size) {
+  const MenuImageHeader *header = (const MenuImageHeader*) image;
+  if (size < sizeof(MenuImageHeader) || size > MENUIMAGE_MAX_SIZE) {
+    return imageError("bad size", size);
+  }
+  if (header->magic != MENUIMAGE_MAGIC) {
+    return imageError("not a menu image");
+  }
+  if (header->version != MENUIMAGE_VERSION) {
+    return imageError("unsupported version", header->version);
+  }
+  if (header->size != size) {
+    return imageError("size does not match file", header->size);
+  }
+  if (header->crc != checksumCrc32(image + sizeof(MenuImageHeader), size - sizeof(MenuImageHeader))) {
+    return imageError("crc mismatch");
+  }
+
+  // Tables are aligned and inside the image, strings end inside the image
+  if ((header->pagesOffset % 4) || (uint32_t) header->pagesOffset + header->pageCount * sizeof(MenuImagePageRecord) > size) {
+    return imageError("bad page table");
+  }
+  if ((header->buttonsOffset % 4) || (uint32_t) header->buttonsOffset + header->buttonCount * sizeof(MenuImageButtonRecord) > size) {
+    return imageError("bad button table");
+  }
+  if (header->stringsOffset >= size || image[size - 1] != '\0') {
+    return imageError("bad string table");
+  }
+  if (header->pageCount > MENUIMAGE_MAX_TOP_PAGES) {
+    return imageError("too many pages", header->pageCount);
+  }
+  if (header->buttonCount > MENUIMAGE_MAX_BUTTONS) {
+    return imageError("too many buttons", header->buttonCount);
+  }
+
+  const MenuImagePageRecord *pageRecords = (const MenuImagePageRecord*) (image + header->pagesOffset);
+  const MenuImageButtonRecord *buttonRecords = (const MenuImageButtonRecord*) (image + header->buttonsOffset);
+  uint8_t imagePageCount = 0;
+  uint8_t nextButton = 0;
+  for (uint8_t pageIndex = 0; pageIndex < header->pageCount; pageIndex++) {
+    const MenuImagePageRecord &pageRecord = pageRecords[pageIndex];
+    if (pageRecord.builtin != MENUIMAGE_NO_STRING) {
+      if (!imageStringValid(header, pageRecord.builtin, false)) {
+        return imageError("bad builtin name on page", pageIndex);
+      }
+      continue;
+    }
+
+    if (++imagePageCount > MENUIMAGE_MAX_PAGES) {
+      return imageError("too many image pages", imagePageCount);
+    }
+    if (!imageStringValid(header, pageRecord.label, false) || pageRecord.color >= THEME_ROLE_COUNT) {
+      return imageError("bad label or color on page", pageIndex);
+    }
+    if (pageRecord.across < 1 || pageRecord.across > MENUIMAGE_MAX_ACROSS || pageRecord.down < 1 || pageRecord.down > MENUIMAGE_MAX_DOWN) {
+      return imageError("bad grid on page", pageIndex);
+    }
+    // Each page has its own run of buttons so no button is on two pages
+    if (pageRecord.firstButton != nextButton || pageRecord.buttonCount > pageRecord.across * pageRecord.down ||
+        nextButton + pageRecord.buttonCount > header->buttonCount) {
+      return imageError("bad buttons on page", pageIndex);
+    }
+    nextButton += pageRecord.buttonCount;
+
+    for (uint8_t buttonIndex = pageRecord.firstButton; buttonIndex < nextButton; buttonIndex++) {
+      const MenuImageButtonRecord &buttonRecord = buttonRecords[buttonIndex];
+      if (!imageStringValid(header, buttonRecord.label, false) || buttonRecord.color >= THEME_ROLE_COUNT ||
+          !imageStringValid(header, buttonRecord.shortAction, true) || !imageStringValid(header, buttonRecord.longAction, true)) {
+        return imageError("bad strings or color on button", buttonIndex);
+      }
+      if (buttonRecord.spanX < 1 || buttonRecord.spanY < 1 ||
+          buttonRecord.x + buttonRecord.spanX > pageRecord.across || buttonRecord.y + buttonRecord.spanY > pageRecord.down) {
+        return imageError("button outside its grid", buttonIndex);
+      }
+    }
+  }
+
+  return true;
+}
+
+
+//
+// Indicate if the menu shown comes from an image
+//
+bool menuImageLoaded() {
+  return imageValid;
+}
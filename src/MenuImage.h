@@ -0,0 +1,138 @@
+/*
+ * @file MenuImage.h
+ *
+ * A MenuImage is the menu tree compiled into a flat binary file on LittleFS.
+ * tools/menuimage.py compiles a JSON description of the pages, grids,
+ * buttons, colors and actions into the image.
+ *
+ * The image is read into one fixed buffer and used where it lies.
+ * Records refer to each other and to their strings by offset, so there is
+ * nothing to parse and nothing is allocated on the heap.  Pages and buttons
+ * come from fixed pools, and their definitions point at the strings in the buffer.
+ *
+ * Pages written in C++, like the On Air page, are registered by name and
+ * placed in the menu by the image.  Button actions are registered by name
+ * with a ButtonPressCallback, and the image can bind a number to each one.
+ *
+ * All values are little endian, the same as the ESP8266.
+ */
+#pragma once
+
+#ifndef __MENUIMAGE_H
+#define __MENUIMAGE_H
+
+#include <Arduino.h>
+#include "Menu.h"
+
+#define MENUIMAGE_PATH "/menu.bin"          // Image loaded at boot
+#define MENUIMAGE_MAGIC 0x494D5042          // "BPMI" read as a little endian uint32_t
+#define MENUIMAGE_VERSION 1                 // Format version, changes when a record changes
+#define MENUIMAGE_MAX_SIZE 1536             // Bytes in the image buffer
+#define MENUIMAGE_MAX_TOP_PAGES 8           // Most pages across the top, registered and image pages together
+#define MENUIMAGE_MAX_PAGES 4               // Pages the image can define with its own buttons
+#define MENUIMAGE_MAX_BUTTONS 16            // Buttons the image can define across all its pages
+#define MENUIMAGE_MAX_ACROSS 4              // Widest grid an image page can use
+#define MENUIMAGE_MAX_DOWN 3                // Tallest grid an image page can use
+#define MENUIMAGE_MAX_REGISTERED 12         // Registered pages and actions, each
+#define MENUIMAGE_NO_STRING 0xFFFF          // String offset for a missing string
+
+
+/*********************
+ * MenuImage file format
+ *********************/
+
+//
+// Start of the image.
+// The crc covers every byte after the header.
+//
+struct MenuImageHeader {
+  uint32_t magic;           // MENUIMAGE_MAGIC
+  uint16_t version;         // MENUIMAGE_VERSION
+  uint16_t size;            // Bytes in the image including the header
+  uint32_t crc;             // CRC-32 of the bytes after the header
+  uint8_t pageCount;        // Number of MenuImagePageRecords
+  uint8_t buttonCount;      // Number of MenuImageButtonRecords
+  uint16_t pagesOffset;     // Offset of the first MenuImagePageRecord
+  uint16_t buttonsOffset;   // Offset of the first MenuImageButtonRecord
+  uint16_t stringsOffset;   // Offset of the nul terminated strings
+};
+
+//
+// A page across the top.
+// A page with a builtin name uses the registered page, the rest of the record is ignored.
+//
+struct MenuImagePageRecord {
+  uint32_t layoutHash;      // CRC-32 of the grid and button positions, an unchanged layout is kept on reload
+  uint16_t label;           // String offset of the page label
+  uint16_t builtin;         // String offset of a registered page name or MENUIMAGE_NO_STRING
+  uint8_t color;            // ThemeRole of the page
+  uint8_t across;           // Grid cells across
+  uint8_t down;             // Grid cells down
+  uint8_t firstButton;      // Index of the first MenuImageButtonRecord on the page
+  uint8_t buttonCount;      // Number of buttons on the page
+  uint8_t reserved[3];
+};
+
+//
+// A button in a page panel
+//
+struct MenuImageButtonRecord {
+  uint16_t label;           // String offset of the button label
+  uint8_t color;            // ThemeRole of the button
+  uint8_t x;                // Grid column
+  uint8_t y;                // Grid row
+  uint8_t spanX;            // Grid cells covered across
+  uint8_t spanY;            // Grid cells covered down
+  uint8_t reserved;
+  uint16_t shortAction;     // String offset of the short press action name or MENUIMAGE_NO_STRING
+  uint16_t longAction;      // String offset of the long press action name or MENUIMAGE_NO_STRING
+  int32_t shortArg;         // Number bound to the short press action
+  int32_t longArg;          // Number bound to the long press action
+};
+
+static_assert(sizeof(MenuImageHeader) == 20, "MenuImageHeader must match tools/menuimage.py");
+static_assert(sizeof(MenuImagePageRecord) == 16, "MenuImagePageRecord must match tools/menuimage.py");
+static_assert(sizeof(MenuImageButtonRecord) == 20, "MenuImageButtonRecord must match tools/menuimage.py");
+
+
+/*********************
+ * MenuImagePage Class
+ *********************/
+
+//
+// A page whose grid and buttons come from the image.
+// Sized for the largest grid so any image page fits.
+// The button list is a base class so it is constructed before MenuPage keeps a reference to it.
+//
+class MenuImagePage: private StaticVector<PanelButton, MENUIMAGE_MAX_ACROSS * MENUIMAGE_MAX_DOWN>, public MenuPage {
+    typedef StaticVector<PanelButton, MENUIMAGE_MAX_ACROSS * MENUIMAGE_MAX_DOWN> ButtonList;
+
+  public:
+    MenuImagePage();
+
+    void build(const MenuPageDef *pageDef, const MenuGridTable *gridTable, MenuButton* const *pageButtons, uint8_t pageButtonCount, uint32_t pageLayoutHash);
+
+  private:
+    uint8_t cells[MENUIMAGE_MAX_ACROSS * MENUIMAGE_MAX_DOWN];
+    const MenuGridTable *builtGrid = nullptr;   // Grid the buttons are placed in, nullptr until built
+    uint32_t layoutHash = 0;                    // Layout hash from the image the buttons are placed for
+    MenuButton *firstButton = nullptr;          // First pool button on this page
+};
+
+
+/*********************
+ * Non Class Functions
+ *********************/
+
+bool menuImageRegisterPage(const char *name, MenuPage *page);
+bool menuImageRegisterAction(const char *name, ButtonPressCallback callback);
+ButtonPressCallback menuImageFindAction(const char *name, int32_t arg = 0);
+MenuPage* menuImageFindPage(const char *name);
+
+void menuImageSetup(Menu *menu, MenuPage* const *defaultMenus, uint8_t defaultMenuCount);
+bool menuImageLoad(const char *path);
+bool menuImageCheckFile(const char *path);
+bool menuImageValidate(const uint8_t *image, size_t size);
+bool menuImageLoaded();
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * MenuLabel
+ *
+ * Text for menu items kept out of the heap.
+ * Dynamic text is interned in a fixed pool with a reference count per slot.
+ */
+
+#include <Arduino.h>
+#include "MenuLabel.h"
+
+
+/*********************
+ * Label pool
+ *********************/
+
+static char poolText[MENULABEL_POOL_SLOTS][MENULABEL_POOL_LENGTH];  // Text of each slot
+static uint8_t poolRefs[MENULABEL_POOL_SLOTS];                      // Number of labels using each slot; 0 = free
+
+
+//
+// Find a slot holding the text or copy it into a free slot
+//
+// @return slot number or -1 if the pool is full
+//
+static int16_t poolIntern(const char *dynamicText) {
+  int16_t freeSlot = -1;
+  for (int16_t slot = 0; slot < MENULABEL_POOL_SLOTS; slot++) {
+    if (poolRefs[slot] == 0) {
+      if (freeSlot < 0) {
+        freeSlot = slot;
+      }
+    }
+    else if (strncmp(poolText[slot], dynamicText, MENULABEL_POOL_LENGTH - 1) == 0) {
+      poolRefs[slot]++;
+      return slot;
+    }
+  }
+
+  if (freeSlot >= 0) {
+    strncpy(poolText[freeSlot], dynamicText, MENULABEL_POOL_LENGTH - 1);
+    poolText[freeSlot][MENULABEL_POOL_LENGTH - 1] = '\0';
+    poolRefs[freeSlot] = 1;
+  }
+  return freeSlot;
+}
+
+
+/*********************
+ * MenuLabel Class functions
+ *********************/
+
+/*
+ * Constructor
+ *
+ * @param staticText  String that exists for the life of the label. Not copied.
+ */
+MenuLabel::MenuLabel(const char *staticText) {
+  text = staticText ? staticText : "";
+  source = LABEL_STATIC;
+}
+
+/*
+ * Constructor
+ *
+ * @param flashText  PROGMEM string. Not copied.
+ */
+MenuLabel::MenuLabel(const __FlashStringHelper *flashText) {
+  set(flashText);
+}
+
+MenuLabel::MenuLabel(const MenuLabel &other) {
+  *this = other;
+}
+
+MenuLabel& MenuLabel::operator=(const MenuLabel &other) {
+  if (this != &other) {
+    if (other.source == LABEL_POOL) {
+      poolRefs[other.poolSlot]++;
+    }
+    release();
+    text = other.text;
+    source = other.source;
+    poolSlot = other.poolSlot;
+  }
+  return *this;
+}
+
+MenuLabel::~MenuLabel() {
+  release();
+}
+
+
+//
+// Set text that may change or go away after this call.
+// The text is interned in the label pool.
+// The previous text is kept if the pool is full.
+//
+void MenuLabel::set(const char *dynamicText) {
+  int16_t slot = poolIntern(dynamicText ? dynamicText : "");
+  if (slot < 0) {
+    Serial.print("Label pool full, unable to set ");
+    Serial.println(dynamicText);
+    return;
+  }
+
+  // Intern before releasing so setting the same text keeps the same slot
+  release();
+  text = poolText[slot];
+  source = LABEL_POOL;
+  poolSlot = slot;
+}
+
+
+//
+// Set text stored in flash
+//
+void MenuLabel::set(const __FlashStringHelper *flashText) {
+  release();
+  text = reinterpret_cast<const char*>(flashText);
+  source = LABEL_FLASH;
+}
+
+
+//
+// Give back the pool slot if this label has one
+//
+void MenuLabel::release() {
+  if (source == LABEL_POOL && poolRefs[poolSlot] > 0) {
+    poolRefs[poolSlot]--;
+  }
+  text = "";
+  source = LABEL_STATIC;
+}
+
+
+//
+// Print the label from wherever it is stored
+//
+size_t MenuLabel::printTo(Print &p) const {
+  if (inFlash()) {
+    return p.print(f_str());
+  }
+  return p.print(text);
+}
+
+
+//
+// Number of pool slots in use
+//
+uint8_t MenuLabel::poolSlotsUsed() {
+  uint8_t used = 0;
+  for (int16_t slot = 0; slot < MENULABEL_POOL_SLOTS; slot++) {
+    if (poolRefs[slot] > 0) {
+      used++;
+    }
+  }
+  return used;
+}
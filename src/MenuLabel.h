@@ -0,0 +1,74 @@
+/*
+ * @file MenuLabel.h
+ *
+ * A MenuLabel is the text shown on a MenuItem without using the heap.
+ *
+ * Static labels point at a string literal in RAM or at a PROGMEM string.
+ * Labels that change at runtime, like the Robot Head face names,
+ * are copied into a small fixed size pool.  Identical text shares one
+ * pool slot so setting the same name again does not use another slot.
+ */
+#pragma once
+
+#ifndef __MENULABEL_H
+#define __MENULABEL_H
+
+#include <Arduino.h>
+
+#define MENULABEL_POOL_SLOTS 16     // Number of dynamic labels that can exist at once
+#define MENULABEL_POOL_LENGTH 24    // Longest dynamic label including the terminator, longer text is cut
+
+
+/*********************
+ * MenuLabel Class
+ *********************/
+
+//
+// Text for a MenuItem stored in RAM, flash or the label pool
+//
+class MenuLabel: public Printable {
+  public:
+    MenuLabel() {};
+    MenuLabel(const char *staticText);
+    MenuLabel(const __FlashStringHelper *flashText);
+    MenuLabel(const MenuLabel &other);
+    MenuLabel& operator=(const MenuLabel &other);
+    ~MenuLabel();
+
+    void set(const char *dynamicText);
+    void set(const __FlashStringHelper *flashText);
+
+    /*!
+     * @brief Indicate if the text is in flash and must be read with the _P functions
+     */
+    bool inFlash() const { return source == LABEL_FLASH; };
+
+    /*!
+     * @brief Return the text. Use inFlash() to know how to read it.
+     */
+    const char* c_str() const { return text; };
+
+    /*!
+     * @brief Return the text as a flash string for print and getTextBounds
+     */
+    const __FlashStringHelper* f_str() const { return reinterpret_cast<const __FlashStringHelper*>(text); };
+
+    size_t printTo(Print &p) const override;
+
+    static uint8_t poolSlotsUsed();
+
+  private:
+    enum LabelSource : uint8_t {
+      LABEL_STATIC = 0,   // String literal in RAM that lives forever
+      LABEL_FLASH,        // PROGMEM string
+      LABEL_POOL          // Copy in the label pool
+    };
+
+    void release();
+
+    const char *text = "";
+    LabelSource source = LABEL_STATIC;
+    uint8_t poolSlot = 0;
+};
+
+#endif
@@ -15,8 +15,7 @@
 #include <Adafruit_GFX.h>
 #include <Adafruit_ILI9341.h>
 #include <XPT2046_Touchscreen.h>
-#include <vector>
-#include <tuple>
+#include <algorithm>
 
 using namespace std;
 
@@ -26,45 +25,19 @@ using namespace std;
 
 /*
  * Constructor
+ * Used by MenuTreePage which owns the storage.
  *
- * @param label         Label or name display on top button
- * @param buttonsAcross Number of buttons to display across panel
- * @param buttonsDown   Number of buttons to display down panel
- * @param menuColor     Optional MenuTop color. Default DEFAULT_TOP_COLOR
+ * @param pageDef           PROGMEM label, theme color, callbacks and panel function of the page
+ * @param gridTable         Compile time layout of the button panel
+ * @param buttonStorage     List to hold the buttons and their pixel rectangles
+ * @param cellStorage       Button index for each cell in the grid
  */ 
-MenuPage::MenuPage(const char* label, int16_t buttonsAcross, int16_t buttonsDown, uint16_t menuColor, ButtonPressCallback onShortPress, ButtonPressCallback onLongPress) {
-  init(label, buttonsAcross, buttonsDown, nullptr, menuColor, onShortPress, onLongPress);
-}
-
-/*
- * Constructor
- *
- * @param label         Label or name display on top button
- * @param buttonsAcross Number of buttons to display across panel
- * @param buttonsDown   Number of buttons to display down panel
- * @param menuButtons   Vector containing the list of buttons to display in the panel
- * @param menuColor     Optional MenuTop color. Default DEFAULT_TOP_COLOR
- */ 
-MenuPage::MenuPage(const char* label, int16_t buttonsAcross, int16_t buttonsDown, vector<MenuButton*> *menuButtons, uint16_t menuColor, ButtonPressCallback onShortPress, ButtonPressCallback onLongPress) {
-  init(label, buttonsAcross, buttonsDown, menuButtons, menuColor, onShortPress, onLongPress);
-}
-
-
-//
-// Initialize the Menu Top variables.
-//
-void MenuPage::init(const char* label, int16_t buttonsAcross, int16_t buttonsDown, vector<MenuButton*> *menuButtons, uint16_t menuColor, ButtonPressCallback onShortPress, ButtonPressCallback onLongPress) {
-  name = String(label);
-  buttonsX = buttonsAcross;
-  buttonsY = buttonsDown;
-  color = menuColor;
-  active = false;
-  buttons = menuButtons;
-  textSize = DEFAULT_PAGETOP_TEXT_SIZE;
-  textColor = DEFAULT_PAGETOP_COLOR;
-  shortPressCallback = onShortPress;
-  longPressCallback = onLongPress;
-
+MenuPage::MenuPage(const MenuPageDef *pageDef, const MenuGridTable *gridTable, StaticVectorBase<PanelButton> &buttonStorage, uint8_t *cellStorage)
+    : MenuItem(pageDef, DEFAULT_PAGETOP_TEXT_SIZE), buttons(buttonStorage) {
+  fixedGrid = gridTable;
+  buttonsX = gridTable->across;
+  buttonsY = gridTable->down;
+  cellButtons = cellStorage;
 }
 
 
@@ -81,157 +54,566 @@ void MenuPage::draw(Adafruit_GFX *tft, int16_t topButtonX, int16_t topButtonY, i
   Serial.println(topButtonY);
   #endif
 
-  drawButtonOutline(tft, topButtonX, topButtonY, topButtonWidth, topButtonHeight, color, active);
+  drawButtonOutline(tft, topButtonX, topButtonY, topButtonWidth, topButtonHeight, getDrawColor(), active);
 
   int16_t centerX = topButtonX + (topButtonWidth/2);
   int16_t centerY = topButtonY + (topButtonHeight/2);
 
-  centerText(tft, name, centerX, centerY, textSize, textColor);
+  centerText(tft, name, centerX, centerY, textSize, getTextColor());
+
+}
+
+
+//
+// Set the pixel area of the button panel and lay out the buttons in it
+//
+void MenuPage::layout(int16_t panelX, int16_t panelY, int16_t panelWidth, int16_t panelHeight) {
+  // Nothing to do if the buttons are already laid out in this panel
+  if (layoutValid && panel.x == panelX && panel.y == panelY && panel.w == panelWidth && panel.h == panelHeight) {
+    return;
+  }
+  panel = {panelX, panelY, panelWidth, panelHeight};
+  layoutButtons();
+}
+
+
+//
+// Change the grid the buttons are placed in.
+// The cell storage must hold every cell of the new grid.
+//
+void MenuPage::setGrid(const MenuGridTable *gridTable) {
+  fixedGrid = gridTable;
+  buttonsX = gridTable->across;
+  buttonsY = gridTable->down;
+  layoutValid = false;
+}
+
+
+//
+// Add a button to the panel.
+// The layout is updated for just the new button.
+//
+// @return false if the list is full or the button overlaps a button already on the page
+//
+bool MenuPage::addButton(MenuButton *button) {
+  if (!buttons.push_back({button, {0, 0, 0, 0}})) {
+    Serial.print("No room for button ");
+    Serial.print(button->getName());
+    Serial.print(" on page ");
+    Serial.println(name);
+    return false;
+  }
+
+  if (layoutValid) {
+    uint8_t buttonIndex = buttons.size() - 1;
+    MenuPage *oldPage = button->getPage();
+    uint8_t oldPageIndex = button->getPageIndex();
+    if (!placeButton(buttonIndex)) {
+      // Undo what placeButton recorded, the overlapping cells were not claimed
+      uint32_t buttonBit = (1UL << buttonIndex);
+      activeButtons &= ~buttonBit;
+      changedButtons &= ~buttonBit;
+      button->setPage(oldPage, oldPageIndex);
+      buttons.pop_back();
+      return false;
+    }
+  }
+  return true;
+}
+
+
+//
+// Remove a button from the panel.
+// The grid cells of the buttons after it are renumbered.
+//
+// @return false if the button is not on this page
+//
+bool MenuPage::removeButton(MenuButton *button) {
+  PanelButton *found = find_if(buttons.begin(), buttons.end(), [button](const PanelButton &panelButton) { return panelButton.button == button; });
+  if (found == buttons.end()) {
+    return false;
+  }
+
+  uint8_t removed = found - buttons.begin();
+  buttons.erase(found);
+  button->setPage(nullptr, 0);
+  if (layoutValid) {
+    // Renumber the buttons after the removed one
+    for (uint8_t buttonIndex = removed; buttonIndex < buttons.size(); buttonIndex++) {
+      buttons[buttonIndex].button->setPage(this, buttonIndex);
+    }
+    uint32_t keepMask = (1UL << removed) - 1;
+    activeButtons = (activeButtons & keepMask) | ((activeButtons >> 1) & ~keepMask);
+    changedButtons = (changedButtons & keepMask) | ((changedButtons >> 1) & ~keepMask);
+
+    for (uint8_t *cell = cellButtons; cell != cellButtons + (buttonsX * buttonsY); cell++) {
+      if (*cell == removed) {
+        *cell = MENUPAGE_NO_BUTTON;
+      }
+      else if (*cell != MENUPAGE_NO_BUTTON && *cell > removed) {
+        (*cell)--;
+      }
+    }
+  }
+  return true;
+}
+
+
+//
+// Remove every button from the panel
+//
+void MenuPage::clearButtons() {
+  for (PanelButton &panelButton : buttons) {
+    panelButton.button->setPage(nullptr, 0);
+  }
+  buttons.clear();
+  activeButtons = 0;
+  changedButtons = 0;
+  layoutValid = false;
+}
+
+
+//
+// Convert every button position into a pixel rectangle
+// and fill in the grid cell to button lookup table.
+// Only done when the panel or the buttons change so drawing
+// and touch handling do not need to repeat the math.
+//
+// @return false if any buttons overlap
+//
+bool MenuPage::layoutButtons() {
+  bool noOverlap = true;
+
+  grid = nullptr;
+  if (fixedGrid) {
+    const MenuRect &gridPanel = fixedGrid->panel;
+    if (gridPanel.x == panel.x && gridPanel.y == panel.y && gridPanel.w == panel.w && gridPanel.h == panel.h &&
+        fixedGrid->across == buttonsX && fixedGrid->down == buttonsY) {
+      grid = fixedGrid;
+    }
+    else {
+      Serial.print("Grid does not match panel for page ");
+      Serial.println(name);
+    }
+  }
+
+  // Calculate the size of the buttons
+  if (grid) {
+    cellWidth = grid->cellWidth;
+    cellHeight = grid->cellHeight;
+  }
+  else {
+    cellWidth = panel.w / buttonsX;
+    cellHeight = panel.h / buttonsY;
+  }
+
+  fill(cellButtons, cellButtons + (buttonsX * buttonsY), MENUPAGE_NO_BUTTON);
+  activeButtons = 0;
+
+  for (uint8_t buttonIndex = 0; buttonIndex < buttons.size(); buttonIndex++) {
+    noOverlap = placeButton(buttonIndex) && noOverlap;
+  }
 
+  layoutValid = true;
+  return noOverlap;
+}
+
+
+//
+// Calculate the pixel rectangle for a single button
+// and record it in every grid cell it covers.
+//
+// @return false if the button overlaps a button already placed.
+//         The button is drawn but the overlapping cells keep the first button.
+//
+bool MenuPage::placeButton(uint8_t buttonIndex) {
+  PanelButton &panelButton = buttons[buttonIndex];
+  MenuButton *button = panelButton.button;
+  button->setPage(this, buttonIndex);
+  if (button->isActive()) {
+    activeButtons |= (1UL << buttonIndex);
+  }
+  int16_t positionX = button->getPositionX();
+  int16_t positionY = button->getPositionY();
+  int16_t spanX = button->getSpanX();
+  int16_t spanY = button->getSpanY();
+
+  // Convert button position to pixel position
+  int16_t buttonTopLeftX;
+  int16_t buttonTopLeftY;
+  if (grid && 0 <= positionX && positionX < buttonsX && 0 <= positionY && positionY < buttonsY) {
+    MenuRect gridCell = grid->cell(positionX, positionY);
+    buttonTopLeftX = gridCell.x;
+    buttonTopLeftY = gridCell.y;
+  }
+  else {
+    buttonTopLeftX = positionX * cellWidth + panel.x;
+    buttonTopLeftY = positionY * cellHeight + panel.y;
+  }
+  panelButton.rect = {buttonTopLeftX, buttonTopLeftY, (int16_t)(spanX * cellWidth), (int16_t)(spanY * cellHeight)};
+
+  // Check the covered cells are free before claiming them
+  // Cells outside of the grid are drawn but can not be touched
+  int16_t minX = max(positionX, (int16_t) 0);
+  int16_t maxX = min((int16_t)(positionX + spanX), buttonsX);
+  int16_t minY = max(positionY, (int16_t) 0);
+  int16_t maxY = min((int16_t)(positionY + spanY), buttonsY);
+  for (int16_t cellY = minY; cellY < maxY; cellY++) {
+    for (int16_t cellX = minX; cellX < maxX; cellX++) {
+      uint8_t cellButton = cellButtons[cellY * buttonsX + cellX];
+      if (cellButton != MENUPAGE_NO_BUTTON && cellButton != buttonIndex) {
+        Serial.print("Button ");
+        Serial.print(button->getName());
+        Serial.print(" overlaps ");
+        Serial.print(buttons[cellButton].button->getName());
+        Serial.print(" on page ");
+        Serial.println(name);
+        return false;
+      }
+    }
+  }
+
+  for (int16_t cellY = minY; cellY < maxY; cellY++) {
+    for (int16_t cellX = minX; cellX < maxX; cellX++) {
+      cellButtons[cellY * buttonsX + cellX] = buttonIndex;
+    }
+  }
+  return true;
 }
 
 
 //
 // Draw a button panel if they exist
 //
-void MenuPage::drawPanelButtons(Adafruit_GFX *tft, int16_t panelX, int16_t panelY, int16_t panelWidth, int16_t panelHeight) {
+void MenuPage::drawPanelButtons(Adafruit_GFX *tft) {
+  DrawPanelFunction drawPanel = getDrawPanel();
   if (drawPanel) {
-    drawPanel(tft, panelX, panelY, panelWidth, panelHeight);
+    drawPanel(tft, panel.x, panel.y, panel.w, panel.h);
   }
 
-  if (buttons) {
+  if (!buttons.empty()) {
     #ifdef MENU_DRAW_DEBUG
     Serial.println("    Show Panel Buttons");
     #endif
 
-    // Calculate the size of the buttons
-    int16_t buttonWidth = panelWidth / buttonsX;
-    int16_t buttonHeight = panelHeight / buttonsY;
+    if (!layoutValid) {
+      layoutButtons();
+    }
+    changedButtons = 0;
 
     // Go through each button
-    auto button = buttons->begin();
-    for (; button != buttons->end(); button++) {
-      // Get the button's button position
-      int16_t positionX = (*button)->getPositionX();
-      int16_t positionY = (*button)->getPositionY();
+    for (const PanelButton &panelButton : buttons) {
+      const MenuRect &rect = panelButton.rect;
       #ifdef MENU_DRAW_DEBUG
       Serial.print("     button->name:");
-      Serial.println((*button)->getName());
+      Serial.println(panelButton.button->getName());
       Serial.print("     button->x");
-      Serial.println(positionX);
+      Serial.println(rect.x);
       Serial.print("     button->y");
-      Serial.println(positionY);
+      Serial.println(rect.y);
       #endif
-      // Convert button position to pixel position
-      int16_t buttonTopLeftX = positionX * buttonWidth + panelX;
-      int16_t buttonTopLeftY = positionY * buttonHeight + panelY;
 
       // Draw the button at the pixel position
-      (*button)->draw(tft, buttonTopLeftX, buttonTopLeftY, buttonWidth, buttonHeight);
+      panelButton.button->draw(tft, rect.x, rect.y, rect.w, rect.h);
+    }
+
+  }
+}
+
+
+//
+// Redraw only the buttons that cover part of a pixel region.
+// Uses the grid cell table so each button is drawn once,
+// from the first of its cells inside the region.
+//
+void MenuPage::drawPanelRegion(Adafruit_GFX *tft, const MenuRect &region) {
+  if (buttons.empty()) {
+    return;
+  }
+
+  if (!layoutValid) {
+    layoutButtons();
+  }
+  if (cellWidth <= 0 || cellHeight <= 0) {
+    return;
+  }
+
+  // Range of cells the region covers
+  int16_t minX = max((int16_t)(region.x - panel.x), (int16_t) 0);
+  int16_t maxX = region.x + region.w - 1 - panel.x;
+  int16_t minY = max((int16_t)(region.y - panel.y), (int16_t) 0);
+  int16_t maxY = region.y + region.h - 1 - panel.y;
+  if (maxX < 0 || maxY < 0) {
+    return;
+  }
+  minX = columnAt(minX);
+  maxX = min(columnAt(min(maxX, (int16_t)(panel.w - 1))), (int16_t)(buttonsX - 1));
+  minY = rowAt(minY);
+  maxY = min(rowAt(min(maxY, (int16_t)(panel.h - 1))), (int16_t)(buttonsY - 1));
+
+  for (int16_t cellY = minY; cellY <= maxY; cellY++) {
+    for (int16_t cellX = minX; cellX <= maxX; cellX++) {
+      uint8_t buttonIndex = cellButtons[cellY * buttonsX + cellX];
+      if (buttonIndex == MENUPAGE_NO_BUTTON) {
+        continue;
+      }
+      MenuButton *button = buttons[buttonIndex].button;
+      int16_t firstX = max(button->getPositionX(), minX);
+      int16_t firstY = max(button->getPositionY(), minY);
+      if (cellX == firstX && cellY == firstY) {
+        const MenuRect &rect = buttons[buttonIndex].rect;
+        button->draw(tft, rect.x, rect.y, rect.w, rect.h);
+      }
     }
+  }
+}
 
+
+//
+// Find the index of a button on this page
+// The button remembers its index so there is no search.
+//
+// @return index of the button or -1 if the button is not on this page
+//
+int16_t MenuPage::indexOf(MenuButton *button) {
+  if (!layoutValid) {
+    layoutButtons();
+  }
+  if (button && button->getPage() == this) {
+    return button->getPageIndex();
+  }
+  return -1;
+}
+
+
+//
+// Keep the active and changed button sets up to date.
+// Called by a button on this page when it becomes active or inactive.
+//
+void MenuPage::buttonStateChanged(uint8_t buttonIndex, bool buttonActive) {
+  uint32_t buttonBit = (1UL << buttonIndex);
+  if (buttonActive) {
+    activeButtons |= buttonBit;
   }
+  else {
+    activeButtons &= ~buttonBit;
+  }
+  changedButtons |= buttonBit;
 }
 
 
+//
+// Set the button to be active
+// Set all other active buttons as inactive
+//
 bool MenuPage::setActiveMenuButton(MenuButton *activeButton) {
   #ifdef MENU_ACTIVEBUTTON_DEBUG
   Serial.print("Set Active Button for ");
   Serial.println(name);
   #endif
 
-  return setActiveMenuButton(buttons, activeButton);
-}
+  int16_t buttonIndex = indexOf(activeButton);
+  if (buttonIndex < 0) {
+    return false;
+  }
 
-//
-// Find and set the button to be active
-// Set all other buttons as inactive
-//
-bool MenuPage::setActiveMenuButton(vector<MenuButton*> *mButtons, MenuButton *activeButton) {
-  bool buttonFound = false;
+  // Only visit the buttons that are currently active
+  uint32_t otherButtons = activeButtons & ~(1UL << buttonIndex);
+  while (otherButtons) {
+    uint8_t otherIndex = __builtin_ctz(otherButtons);
+    otherButtons &= otherButtons - 1;
+    buttons[otherIndex].button->setInactive();
+  }
 
   #ifdef MENU_ACTIVEBUTTON_DEBUG
-  Serial.println("Set Active Button");
+  Serial.print("Found Button ");
+  Serial.println(activeButton->getName());
   #endif
-  auto button = mButtons->begin();
-  for (; button != mButtons->end(); button++) {
-    if ((*button) == activeButton) {
-      #ifdef MENU_ACTIVEBUTTON_DEBUG
-      Serial.print("Found Button ");
-      Serial.println((*button)->getName());
-      #endif
-      // This is the button to make active
-      if (!(*button)->hasShortPressCallback()) {
-        // Only set to active if there is no callback function
-        // otherwise expect the callback to handle setting button active state
-        (*button)->setActive();
-        #ifdef MENU_ACTIVEBUTTON_DEBUG
-        Serial.println("  Setting as Active");
-        #endif
-      }
-      buttonFound = true;
-    }
-    else {
-      // All other buttons are set to inactive
-      (*button)->setInactive();
-    }
+  // This is the button to make active
+  if (!activeButton->hasShortPressCallback()) {
+    // Only set to active if there is no callback function
+    // otherwise expect the callback to handle setting button active state
+    activeButton->setActive();
+    #ifdef MENU_ACTIVEBUTTON_DEBUG
+    Serial.println("  Setting as Active");
+    #endif
   }
 
-  return buttonFound;
+  return true;
+}
+
+
+//
+// Redraw only the buttons that changed state since the last draw
+//
+void MenuPage::drawChangedButtons(Adafruit_GFX *tft) {
+  if (!layoutValid) {
+    // Button indexes may have moved so draw them all
+    drawPanelButtons(tft);
+    return;
+  }
+
+  while (changedButtons) {
+    uint8_t buttonIndex = __builtin_ctz(changedButtons);
+    changedButtons &= changedButtons - 1;
+    const MenuRect &rect = buttons[buttonIndex].rect;
+    buttons[buttonIndex].button->draw(tft, rect.x, rect.y, rect.w, rect.h);
+  }
 }
 
 
 //
 // Handle a touch event
-// First checks to see if a button was touched
-// Then sets the touched button as active.
+// Converts the touch into a grid cell and looks up the button in that cell.
 //
-MenuButton* MenuPage::findTouchedButton(int16_t pressX, int16_t pressY, int16_t panelX, int16_t panelY, int16_t panelWidth, int16_t panelHeight) {
+MenuButton* MenuPage::findTouchedButton(int16_t pressX, int16_t pressY) {
 
   MenuButton *buttonPressed = nullptr;
 
-  if (buttons) {
+  if (!buttons.empty()) {
     #ifdef MENU_FINDBUTTON_DEBUG
     Serial.println("Checking Button Panel");
     #endif
-    // Calculate the size of the button
-    int16_t buttonWidth = panelWidth / buttonsX;
-    int16_t buttonHeight = panelHeight / buttonsY;
-
-    // Go through each button to check if it was touched
-    auto button = buttons->begin();
-    for (; button != buttons->end(); button++) {
-      // Get the position of the button
-      int16_t positionX = (*button)->getPositionX();
-      int16_t positionY = (*button)->getPositionY();
-
-      // Convert the button position to pixel positions
-      int16_t buttonMinX = positionX * buttonWidth + panelX;
-      int16_t buttonMaxX = buttonMinX + buttonWidth;
-      int16_t buttonMinY = positionY * buttonHeight + panelY;
-      int16_t buttonMaxY = buttonMinY + buttonHeight;
-
-      // Compare button pixel positions to where the touch occurred
-      if ((buttonMinX < pressX && pressX < buttonMaxX) &&
-          (buttonMinY < pressY && pressY < buttonMaxY)) {
-        // This button was touched
-/*
-        if (!(*button)->isActive()) {
-          // Button was not active before, new press
-          newButtonPress = true;
-        }
-*/
-//        setActiveMenuButton(buttons, (*button));
-        #ifdef MENU_FINDBUTTON_DEBUG
-        Serial.print("Button Pressed: ");
-        Serial.println((*button)->getName());
-        #endif
-        // Remember which button
-        buttonPressed = (*button);
-      }
+
+    if (!layoutValid) {
+      layoutButtons();
+    }
+
+    // Find the grid cell that was touched
+    int16_t offsetX = pressX - panel.x;
+    int16_t offsetY = pressY - panel.y;
+    if (offsetX < 0 || offsetY < 0 || cellWidth <= 0 || cellHeight <= 0) {
+      return nullptr;
+    }
+    int16_t cellX = columnAt(offsetX);
+    int16_t cellY = rowAt(offsetY);
+    if (cellX >= buttonsX || cellY >= buttonsY) {
+      return nullptr;
+    }
+
+    // Look up the button in the touched cell
+    uint8_t buttonIndex = cellButtons[cellY * buttonsX + cellX];
+    if (buttonIndex != MENUPAGE_NO_BUTTON) {
+      buttonPressed = buttons[buttonIndex].button;
+      #ifdef MENU_FINDBUTTON_DEBUG
+      Serial.print("Button Pressed: ");
+      Serial.println(buttonPressed->getName());
+      #endif
     }
 
   }
 
   return buttonPressed;
 }
+
+
+//
+// Show the page.
+// Calls the enter hook so the page can load its resources and measures the heap they hold.
+//
+void MenuPage::enter() {
+  if (entered) {
+    return;
+  }
+
+  enterFreeHeap = ESP.getFreeHeap();
+  memory.enters++;
+  memory.inUse = 0;
+  entered = true;
+
+  MenuPageHook onEnter = getEnterHook();
+  if (onEnter) {
+    onEnter(this);
+  }
+  measureHeap();
+}
+
+
+//
+// Load the resources of a shown page again, for example once the network is up.
+// Calls the enter hook without counting another visit.
+//
+void MenuPage::refresh() {
+  if (!entered) {
+    return;
+  }
+
+  MenuPageHook onEnter = getEnterHook();
+  if (onEnter) {
+    onEnter(this);
+  }
+  measureHeap();
+}
+
+
+//
+// Hide the page.
+// Calls the leave hook so the page can release its resources and records any heap it kept.
+//
+void MenuPage::leave() {
+  if (!entered) {
+    return;
+  }
+
+  // Anything the page picked up while shown is counted before it is released
+  measureHeap();
+
+  MenuPageHook onLeave = getLeaveHook();
+  if (onLeave) {
+    onLeave(this);
+  }
+  entered = false;
+  memory.kept = (int32_t) enterFreeHeap - (int32_t) ESP.getFreeHeap();
+  memory.inUse = 0;
+
+  if (memory.kept > 0) {
+    Serial.print("Menu page ");
+    Serial.print(getName());
+    Serial.print(" kept ");
+    Serial.print(memory.kept);
+    Serial.println(" bytes of heap after leaving");
+  }
+}
+
+
+//
+// Record the heap the page holds now and check it against the page budget
+//
+void MenuPage::measureHeap() {
+  int32_t previousInUse = memory.inUse;
+  memory.inUse = (int32_t) enterFreeHeap - (int32_t) ESP.getFreeHeap();
+  memory.peak = max(memory.peak, memory.inUse);
+
+  uint16_t budget = getHeapBudget();
+  if (budget > 0 && memory.inUse > budget && previousInUse <= budget) {
+    memory.overBudget++;
+    Serial.print("Menu page ");
+    Serial.print(getName());
+    Serial.print(" holds ");
+    Serial.print(memory.inUse);
+    Serial.print(" bytes of heap, budget is ");
+    Serial.println(budget);
+  }
+}
+
+
+//
+// Print the heap measurements of the page on one tab separated line
+//
+void MenuPage::printMemory(Print &p) {
+  p.print(getName());
+  p.print('\t');
+  p.print(entered ? F("shown") : F("hidden"));
+  p.print('\t');
+  p.print(memory.enters);
+  p.print('\t');
+  p.print(memory.inUse);
+  p.print('\t');
+  p.print(memory.peak);
+  p.print('\t');
+  p.print(getHeapBudget());
+  p.print('\t');
+  p.print(memory.kept);
+  p.print('\t');
+  p.println(memory.overBudget);
+}
@@ -18,18 +18,23 @@
 #include <Adafruit_GFX.h>
 #include <Adafruit_ILI9341.h>
 #include <XPT2046_Touchscreen.h>
-#include <vector>
-#include <tuple>
+#include <algorithm>
 #include "MenuButton.h"
+#include "StaticVector.h"
 
 
 // MenuPage Defaults
-#define DEFAULT_PAGETOP_BUTTONS 3                 // Number of buttons to show across top
+#define DEFAULT_PAGETOP_BUTTONS 3                 // Number of buttons to fit across top, sets the minimum button width
 #define DEFAULT_PAGETOP_HEIGHT 80                 // Height of button section on top in pixels
-#define DEFAULT_PAGETOP_COLOR ILI9341_CYAN        // Default Color of menu page
-#define DEFAULT_PAGETOP_TEXT_COLOR ILI9341_WHITE  // Default Text color for menu page button
+#define DEFAULT_PAGETOP_COLOR THEME_PAGETOP       // Default theme color of menu page
 #define DEFAULT_PAGETOP_TEXT_SIZE 2               // Default Text Size of menu page button
 #define DEFAULT_PAGETOP_NEXT_BUTTON_SIZE 3        // Default width of next button indicator in pixels
+#define DEFAULT_PAGETOP_PADDING 8                 // Default space on each side of the menu page label in pixels
+
+#define MENUPAGE_NO_BUTTON 0xFF                   // Grid cell without a button
+#define MENUPAGE_MAX_BUTTONS 32                   // Most buttons on a page, one bit each in the active set
+
+#include "MenuGrid.h"
 
 
 /*********************
@@ -56,37 +61,205 @@ typedef void (*DrawPanelFunction)(Adafruit_GFX*, int16_t, int16_t, int16_t, int1
 typedef void (*MenuPageSetup)(Adafruit_GFX*);
 
 
+class MenuPage;
+
+/*!
+ * @brief Function called when a menu page is shown or hidden.
+ *        Used to load the page's device state and release it again.
+ * 
+ * @param MenuPage* page being shown or hidden
+ */
+typedef void (*MenuPageHook)(MenuPage*);
+
+
+/*********************
+ * MenuPage definition
+ *********************/
+
+//
+// Settings of a MenuPage that never change, kept in PROGMEM.
+//
+struct MenuPageDef: MenuItemDef {
+  DrawPanelFunction drawPanel = nullptr;  // Function to draw unique items on menu page panel
+  MenuPageHook onEnter = nullptr;         // Function to load the page resources when it is shown
+  MenuPageHook onLeave = nullptr;         // Function to release the page resources when it is hidden
+  uint16_t heapBudget = 0;                // Bytes of heap the page may hold while shown, 0 for no budget
+};
+
+
+//
+// Heap held by a MenuPage while it is shown
+//
+struct MenuPageMemory {
+  uint32_t enters = 0;      // Number of times the page was shown
+  int32_t inUse = 0;        // Heap held since the page was last shown
+  int32_t peak = 0;         // Most heap held while shown
+  int32_t kept = 0;         // Heap not given back when the page was last hidden
+  uint16_t overBudget = 0;  // Number of times the page held more than its budget
+};
+
+
 
 /*********************
  * MenuPage Class
  *********************/
 
+//
+// A button on a page and where it is drawn.
+// Kept together so drawing walks one list in order.
+//
+struct PanelButton {
+  MenuButton *button;   // Button shown in the panel
+  MenuRect rect;        // Pixel area of the button, set by the layout
+};
+
 //
 // Class for the Buttons across the top
 // This changes the buttons displayed in the panel below
 //
 class MenuPage: public MenuItem {
   public:
-    MenuPage(const char* label, int16_t buttonsAcross, int16_t buttonsDown, uint16_t menuColor = DEFAULT_PAGETOP_COLOR, ButtonPressCallback onShortPress = nullptr, ButtonPressCallback onLongPress = nullptr);
-    MenuPage(const char* label, int16_t buttonsAcross, int16_t buttonsDown, vector<MenuButton*> *menuButtons, uint16_t menuColor = DEFAULT_PAGETOP_COLOR, ButtonPressCallback onShortPress = nullptr, ButtonPressCallback onLongPress = nullptr);
-
     void draw(Adafruit_GFX *tft, int16_t buttonX, int16_t buttonY, int16_t buttonWidth, int16_t buttonHeight);
-    void drawPanelButtons(Adafruit_GFX *tft, int16_t panelX, int16_t panelY, int16_t panelWidth, int16_t panelHeight);
-    void setDrawPanel(DrawPanelFunction drawPanelFunc) {drawPanel = drawPanelFunc;};
+    void drawPanelButtons(Adafruit_GFX *tft);
+    void drawPanelRegion(Adafruit_GFX *tft, const MenuRect &region);
+
+    void layout(int16_t panelX, int16_t panelY, int16_t panelWidth, int16_t panelHeight);
+    bool addButton(MenuButton *button);
+    bool removeButton(MenuButton *button);
+    void clearButtons();
+
+    /*!
+     * @brief return the number of buttons on this page
+     */
+    uint8_t getButtonCount() {return buttons.size();};
+    /*!
+     * @brief return the button at an index on this page
+     */
+    MenuButton* getButton(uint8_t buttonIndex) {return (buttonIndex < buttons.size()) ? buttons[buttonIndex].button : nullptr;};
+
+    /*!
+     * @brief Recalculate the button rectangles before the next draw or touch.
+     *        Call after changing the contents of the button list.
+     */
+    void invalidateLayout() { layoutValid = false; };
 
     bool setActiveMenuButton(MenuButton *activeButton);
-    static bool setActiveMenuButton(vector<MenuButton*> *mButtons, MenuButton *activeButton);
+    int16_t indexOf(MenuButton *button);
+    void buttonStateChanged(uint8_t buttonIndex, bool buttonActive);
+    void drawChangedButtons(Adafruit_GFX *tft);
+
+    /*!
+     * @brief return the set of active buttons, one bit per button index
+     */
+    uint32_t getActiveButtons() {return activeButtons;};
+    /*!
+     * @brief return the set of buttons changed since the last draw, one bit per button index
+     */
+    uint32_t getChangedButtons() {return changedButtons;};
 
-    MenuButton* findTouchedButton(int16_t pressX, int16_t pressY, int16_t panelX, int16_t panelY, int16_t panelWidth, int16_t panelHeight);
+    /*!
+     * @brief Record the position of this page in the Menu
+     */
+    void setMenuIndex(int16_t index) {menuIndex = index;};
+    /*!
+     * @brief return the position of this page in the Menu or -1 if not known yet
+     */
+    int16_t getMenuIndex() {return menuIndex;};
 
+    MenuButton* findTouchedButton(int16_t pressX, int16_t pressY);
+
+    void enter();
+    void leave();
+    void refresh();
+    /*!
+     * @brief Indicate if the page is shown and holds its resources
+     */
+    bool isEntered() {return entered;};
+    /*!
+     * @brief return the heap budget of this page in bytes, 0 if it has none
+     */
+    uint16_t getHeapBudget() { return pgm_read_word(&static_cast<const MenuPageDef*>(def)->heapBudget); };
+    /*!
+     * @brief return the heap measurements of this page
+     */
+    const MenuPageMemory& getMemory() {return memory;};
+    void printMemory(Print &p);
+
+
+  protected:
+    MenuPage(const MenuPageDef *pageDef, const MenuGridTable *gridTable, StaticVectorBase<PanelButton> &buttonStorage, uint8_t *cellStorage);
+    void setGrid(const MenuGridTable *gridTable);
 
   private:
-    void init(const char* label, int16_t buttonsAcross, int16_t buttonsDown, vector<MenuButton*> *menuButtons, uint16_t menuColor, ButtonPressCallback onShortPress, ButtonPressCallback onLongPress);
+    bool layoutButtons();
+    bool placeButton(uint8_t buttonIndex);
+    int16_t columnAt(int16_t offsetX) { return grid ? grid->columnAt(offsetX) : offsetX / cellWidth; };
+    int16_t rowAt(int16_t offsetY) { return grid ? grid->rowAt(offsetY) : offsetY / cellHeight; };
+    DrawPanelFunction getDrawPanel() { return (DrawPanelFunction) pgm_read_ptr(&static_cast<const MenuPageDef*>(def)->drawPanel); };
+    MenuPageHook getEnterHook() { return (MenuPageHook) pgm_read_ptr(&static_cast<const MenuPageDef*>(def)->onEnter); };
+    MenuPageHook getLeaveHook() { return (MenuPageHook) pgm_read_ptr(&static_cast<const MenuPageDef*>(def)->onLeave); };
+    void measureHeap();
 
     int16_t buttonsX;         // Number of buttons across
     int16_t buttonsY;         // Number of buttons down
-    vector<MenuButton*> *buttons = nullptr;   // List of all the button on this page
-    DrawPanelFunction drawPanel = nullptr;    // function to draw unique items on menu page panel
+    StaticVectorBase<PanelButton> &buttons;   // List of all the button on this page and their pixel areas
+
+    MenuRect panel = {0, 0, 0, 0};  // Pixel area of the button panel
+    const MenuGridTable *fixedGrid; // Compile time layout for this page
+    const MenuGridTable *grid = nullptr;       // Compile time layout in use, only when it matches the panel
+    int16_t cellWidth = 0;          // Pixel width of one grid cell
+    int16_t cellHeight = 0;         // Pixel height of one grid cell
+    uint8_t *cellButtons;           // Index into buttons for every grid cell a button covers or MENUPAGE_NO_BUTTON
+    bool layoutValid = false;       // Indicates the button rectangles and cellButtons match panel and buttons
+    uint32_t activeButtons = 0;     // Bit set of the active buttons
+    uint32_t changedButtons = 0;    // Bit set of the buttons that changed state since the last draw
+    int16_t menuIndex = -1;         // Position of this page in the Menu
+    bool entered = false;           // Indicates the page is shown and holds its resources
+    uint32_t enterFreeHeap = 0;     // Free heap before the page was last shown
+    MenuPageMemory memory;          // Heap held by the page while shown
+};
+
+
+/*********************
+ * MenuTreePage template
+ *********************/
+
+//
+// A MenuPage with its button list and layout tables sized at compile time.
+// Grid is a MenuGrid giving the cells of the page.
+// Capacity is the most buttons the page can hold including any added later.
+// The button list is a base class so it is constructed before MenuPage keeps a reference to it.
+//
+template <class Grid, uint8_t Capacity>
+class MenuTreePage: private StaticVector<PanelButton, Capacity>, public MenuPage {
+    typedef StaticVector<PanelButton, Capacity> ButtonList;
+
+  public:
+    static_assert(Capacity <= MENUPAGE_MAX_BUTTONS, "Too many buttons for the active button set");
+
+    /*!
+     * @brief Constructor for a page without buttons
+     * @param pageDef     PROGMEM label, theme color, callbacks and panel function of the page
+     */
+    MenuTreePage(const MenuPageDef *pageDef)
+        : MenuPage(pageDef, &Grid::table, static_cast<ButtonList&>(*this), cells) {};
+
+    /*!
+     * @brief Constructor. The buttons must fit in Capacity, checked at compile time.
+     * @param pageDef     PROGMEM label, theme color, callbacks and panel function of the page
+     * @param pageButtons Buttons to show in the panel
+     */
+    template <size_t Count>
+    MenuTreePage(const MenuPageDef *pageDef, MenuButton* const (&pageButtons)[Count])
+        : MenuPage(pageDef, &Grid::table, static_cast<ButtonList&>(*this), cells) {
+      static_assert(Count <= Capacity, "More buttons than the page capacity");
+      for (MenuButton *button : pageButtons) {
+        addButton(button);
+      }
+    };
+
+  private:
+    uint8_t cells[Grid::across * Grid::down];
 };
 
 #endif
\ No newline at end of file
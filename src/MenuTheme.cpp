@@ -0,0 +1,82 @@
+/*
+ * MenuTheme
+ *
+ * Color palettes for the Menu.
+ * The shades in each palette are generated by the compiler so
+ * nothing is calculated when the Menu is drawn.
+ */
+
+#include <Arduino.h>
+#include <Adafruit_ILI9341.h>
+#include "MenuTheme.h"
+
+
+/*********************
+ * Themes
+ *********************/
+
+//
+// Original colors of the Button Panel
+//
+constexpr MenuTheme themeClassic = {
+  "Classic",
+  {
+    themeColor(ILI9341_BLACK),      // THEME_BACKGROUND
+    themeColor(ILI9341_CYAN),       // THEME_PAGETOP
+    themeColor(ILI9341_CYAN),       // THEME_BUTTON
+    themeColor(ILI9341_GREEN),      // THEME_SELECTED
+    themeColor(ILI9341_RED),        // THEME_ALERT
+    themeColor(ILI9341_LIGHTGREY),  // THEME_NEUTRAL
+    themeColor(ILI9341_RED),        // THEME_ONAIR
+    themeColor(ILI9341_GREEN),      // THEME_HEADCONTROL
+    themeColor(ILI9341_YELLOW)      // THEME_STATUS
+  }
+};
+
+//
+// Low brightness warm colors for a dark office
+//
+constexpr MenuTheme themeNight = {
+  "Night",
+  {
+    themeColor(ILI9341_BLACK),                    // THEME_BACKGROUND
+    themeColor(colorRGB24toRGB565(0x803000)),     // THEME_PAGETOP
+    themeColor(colorRGB24toRGB565(0x803000)),     // THEME_BUTTON
+    themeColor(colorRGB24toRGB565(0xA06000)),     // THEME_SELECTED
+    themeColor(colorRGB24toRGB565(0x900000)),     // THEME_ALERT
+    themeColor(colorRGB24toRGB565(0x505050)),     // THEME_NEUTRAL
+    themeColor(colorRGB24toRGB565(0x900000)),     // THEME_ONAIR
+    themeColor(colorRGB24toRGB565(0x806000)),     // THEME_HEADCONTROL
+    themeColor(colorRGB24toRGB565(0x807000))      // THEME_STATUS
+  }
+};
+
+//
+// Black on white for bright rooms
+//
+constexpr MenuTheme themeHighContrast = {
+  "High Contrast",
+  {
+    themeColor(ILI9341_WHITE),      // THEME_BACKGROUND
+    themeColor(ILI9341_NAVY),       // THEME_PAGETOP
+    themeColor(ILI9341_NAVY),       // THEME_BUTTON
+    themeColor(ILI9341_DARKGREEN),  // THEME_SELECTED
+    themeColor(ILI9341_MAROON),     // THEME_ALERT
+    themeColor(ILI9341_DARKGREY),   // THEME_NEUTRAL
+    themeColor(ILI9341_MAROON),     // THEME_ONAIR
+    themeColor(ILI9341_DARKGREEN),  // THEME_HEADCONTROL
+    themeColor(ILI9341_PURPLE)      // THEME_STATUS
+  }
+};
+
+// Sanity check the generated shades
+static_assert(themeClassic.colors[THEME_BUTTON].text == ILI9341_BLACK, "Cyan buttons need black text");
+static_assert(themeClassic.colors[THEME_ONAIR].text == ILI9341_WHITE, "Red buttons need white text");
+static_assert(themeClassic.colors[THEME_ONAIR].pressed == colorRGBtoRGB565(0xBF, 0, 0), "Pressed shade is 75% of base");
+
+
+// Themes that can be chosen on the panel, in the order they are stepped through
+const MenuTheme* const menuThemes[MENU_THEME_COUNT] = {&themeClassic, &themeNight, &themeHighContrast};
+
+// Theme used to draw the Menu
+const MenuTheme *menuTheme = &themeClassic;
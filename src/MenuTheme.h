@@ -0,0 +1,161 @@
+/*
+ * @file MenuTheme.h
+ *
+ * A MenuTheme is a table of colors used to draw the Menu.
+ * Each entry holds a base RGB565 color along with the pressed,
+ * dimmed and disabled shades and a text color that contrasts
+ * with the base.  All shades are generated at compile time.
+ *
+ * MenuItems refer to a ThemeRole instead of a raw color so the
+ * whole Menu can change themes by swapping the active theme pointer.
+ */
+#pragma once
+
+#ifndef __MENUTHEME_H
+#define __MENUTHEME_H
+
+#include <Arduino.h>
+#include <Adafruit_ILI9341.h>
+
+// Shade scaling factors out of 256
+#define THEME_PRESSED_SCALE 192     // Pressed shade is 75% of the base color
+#define THEME_DIMMED_SCALE 96       // Dimmed shade is 37.5% of the base color
+#define THEME_DISABLED_SCALE 128    // Disabled shade is a grey at 50% of the base brightness
+#define THEME_CONTRAST_LUMA 140     // Base colors brighter than this get black text
+
+
+/*********************
+ * RGB565 color utilities
+ *********************/
+
+//
+// Convert an 8-bit individual R G B color to an equivalent 16-bit RGB565 value
+//
+constexpr uint16_t colorRGBtoRGB565(uint8_t r, uint8_t g, uint8_t b) {
+  return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+//
+// Convert a 24-bit RGB color to an equivalent 16-bit RGB565 value
+//
+constexpr uint16_t colorRGB24toRGB565(uint32_t rgb) {
+  return colorRGBtoRGB565((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF);
+}
+
+//
+// Convert a 16-bit RGB565 color to a standard 24-bit RGB Color
+//
+constexpr uint32_t colorRGB565toRGB24(uint16_t color) {
+  return ((uint32_t)(color & 0xF800) << 8) | ((uint32_t)(color & 0x07E0) << 5) | ((uint32_t)(color & 0x001F) << 3);
+}
+
+//
+// Extract the 8-bit channels of an RGB565 color
+//
+constexpr uint8_t colorRed8(uint16_t color)   { return ((color >> 11) & 0x1F) << 3; }
+constexpr uint8_t colorGreen8(uint16_t color) { return ((color >> 5) & 0x3F) << 2; }
+constexpr uint8_t colorBlue8(uint16_t color)  { return (color & 0x1F) << 3; }
+
+//
+// Scale the brightness of an RGB565 color by scale/256
+//
+constexpr uint16_t colorScale565(uint16_t color, uint16_t scale) {
+  return colorRGBtoRGB565((colorRed8(color) * scale) >> 8, (colorGreen8(color) * scale) >> 8, (colorBlue8(color) * scale) >> 8);
+}
+
+//
+// Perceived brightness (0-255) of an RGB565 color
+//
+constexpr uint8_t colorLuma565(uint16_t color) {
+  return (colorRed8(color) * 77 + colorGreen8(color) * 150 + colorBlue8(color) * 29) >> 8;
+}
+
+//
+// Grey RGB565 color at the brightness of the given color scaled by scale/256
+//
+constexpr uint16_t colorGrey565(uint16_t color, uint16_t scale) {
+  return colorRGBtoRGB565((colorLuma565(color) * scale) >> 8, (colorLuma565(color) * scale) >> 8, (colorLuma565(color) * scale) >> 8);
+}
+
+//
+// Black or white, whichever is more readable on top of the color
+//
+constexpr uint16_t colorContrast565(uint16_t color) {
+  return (colorLuma565(color) > THEME_CONTRAST_LUMA) ? ILI9341_BLACK : ILI9341_WHITE;
+}
+
+
+/*********************
+ * Theme definitions
+ *********************/
+
+//
+// A base color and the shades derived from it
+//
+struct ThemeColor {
+  uint16_t base;      // Color of the item
+  uint16_t pressed;   // Color while the item is being pressed
+  uint16_t dimmed;    // Color when the item is shown but not current
+  uint16_t disabled;  // Color when the item can not be used
+  uint16_t text;      // Text color readable on top of base
+};
+
+//
+// Generate all the shades for a base color
+//
+constexpr ThemeColor themeColor(uint16_t base) {
+  return { base,
+           colorScale565(base, THEME_PRESSED_SCALE),
+           colorScale565(base, THEME_DIMMED_SCALE),
+           colorGrey565(base, THEME_DISABLED_SCALE),
+           colorContrast565(base) };
+}
+
+//
+// The roles a color plays in the Menu.
+// MenuItems are assigned a role and the active theme supplies the color.
+//
+enum ThemeRole : uint8_t {
+  THEME_BACKGROUND = 0,   // Screen background
+  THEME_PAGETOP,          // Default Menu Page button
+  THEME_BUTTON,           // Default Menu Button
+  THEME_SELECTED,         // Button that is currently selected
+  THEME_ALERT,            // Button that performs a disruptive action
+  THEME_NEUTRAL,          // Page or Button without a specific purpose
+  THEME_ONAIR,            // On Air sign page and buttons
+  THEME_HEADCONTROL,      // Robot Head page and buttons
+  THEME_STATUS,           // Status page and buttons
+  THEME_ROLE_COUNT,       // Number of roles in a theme
+  THEME_CUSTOM = 0xFF     // Item uses its own color instead of the theme
+};
+
+//
+// A complete set of colors for the Menu
+//
+struct MenuTheme {
+  const char *name;
+  ThemeColor colors[THEME_ROLE_COUNT];
+};
+
+
+/*********************
+ * Themes
+ *********************/
+
+extern const MenuTheme themeClassic;
+extern const MenuTheme themeNight;
+extern const MenuTheme themeHighContrast;
+
+// Themes that can be chosen on the panel
+#define MENU_THEME_COUNT 3
+extern const MenuTheme* const menuThemes[MENU_THEME_COUNT];
+
+// Theme used to draw the Menu
+extern const MenuTheme *menuTheme;
+
+/*!
+ * @brief Return the active theme's colors for a role
+ */
+inline const ThemeColor& getThemeColor(ThemeRole role) { return menuTheme->colors[role]; }
+
+#endif
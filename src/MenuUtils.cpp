@@ -22,9 +22,44 @@ using namespace std;
 
 
 /*********************
- * MenuButton Class functions
+ * MenuItem Class functions
  *********************/
 
+/*
+ * Constructor
+ *
+ * @param itemDef       PROGMEM settings of the item. Must exist for the life of the item.
+ * @param itemTextSize  Size of the label text
+ */
+MenuItem::MenuItem(const MenuItemDef *itemDef, int16_t itemTextSize) {
+  setDef(itemDef);
+  textSize = itemTextSize;
+}
+
+/*
+ * Point this item at a different definition and take its label and color.
+ * Used by menus loaded at runtime, the definition may be in RAM.
+ */
+void MenuItem::setDef(const MenuItemDef *itemDef) {
+  def = itemDef;
+  const char *label = (const char*) pgm_read_ptr(&itemDef->label);
+  if (label) {
+    setName(FPSTR(label));
+  }
+  colorRole = (ThemeRole) pgm_read_byte(&itemDef->color);
+}
+
+/*
+ * Set the name back to the PROGMEM label of the definition.
+ * Any text held in the label pool is released.
+ */
+void MenuItem::resetName() {
+  const char *label = (const char*) pgm_read_ptr(&def->label);
+  if (label) {
+    setName(FPSTR(label));
+  }
+}
+
 /*
  * Call the Short Press Callback function if defined.
  * return boolean indicating something changed.
@@ -32,6 +67,7 @@ using namespace std;
 bool MenuItem::callbackShortPress() {
   bool changeMade = false;
   Serial.println("Button Short Press Callback");
+  ButtonPressCallback shortPressCallback = getShortPressCallback();
   if (shortPressCallback) {
     changeMade = shortPressCallback();
   }
@@ -45,6 +81,7 @@ bool MenuItem::callbackShortPress() {
 bool MenuItem::callbackLongPress() {
   bool changeMade = false;
   Serial.println("Button Long Press Callback");
+  ButtonPressCallback longPressCallback = getLongPressCallback();
   if (longPressCallback) {
     changeMade = longPressCallback();
   }
@@ -62,14 +99,13 @@ bool MenuItem::callbackLongPress() {
 //
 // Function to print text centered vertically and horizontally to a single pixel
 //
-void centerText (Adafruit_GFX *tft, String text, int16_t centerX, int16_t centerY, int16_t textSize, uint16_t textColor) {
+void centerText (Adafruit_GFX *tft, const MenuLabel &text, int16_t centerX, int16_t centerY, int16_t textSize, uint16_t textColor) {
 
   tft->setTextSize(textSize);
   tft->setTextColor(textColor);
 
-  int16_t stringX, stringY;
   uint16_t stringW, stringH;
-  tft->getTextBounds(text, 0, 0, &stringX, &stringY, &stringW, &stringH);
+  getTextBounds(tft, text, &stringW, &stringH);
   int16_t adjX = stringW/2;
   int16_t adjY = stringH/2;
   int16_t textX = centerX - adjX;
@@ -84,11 +120,25 @@ void centerText (Adafruit_GFX *tft, String text, int16_t centerX, int16_t center
 //
 // Function to return the width of a string
 //
-uint16_t getTextWidth (Adafruit_GFX *tft, String text, int16_t textSize) {
+uint16_t getTextWidth (Adafruit_GFX *tft, const MenuLabel &text, int16_t textSize) {
   tft->setTextSize(textSize);
-  int16_t stringX, stringY;
   uint16_t stringW, stringH;
-  tft->getTextBounds(text, 0, 0, &stringX, &stringY, &stringW, &stringH);
+  getTextBounds(tft, text, &stringW, &stringH);
 
   return stringW;
+}
+
+
+//
+// Function to return the size of a label at the current text size
+// Reads the label from flash or RAM without copying it
+//
+void getTextBounds (Adafruit_GFX *tft, const MenuLabel &text, uint16_t *textWidth, uint16_t *textHeight) {
+  int16_t stringX, stringY;
+  if (text.inFlash()) {
+    tft->getTextBounds(text.f_str(), 0, 0, &stringX, &stringY, textWidth, textHeight);
+  }
+  else {
+    tft->getTextBounds(text.c_str(), 0, 0, &stringX, &stringY, textWidth, textHeight);
+  }
 }
\ No newline at end of file
@@ -20,6 +20,9 @@
 #include <XPT2046_Touchscreen.h>
 #include <vector>
 #include <tuple>
+#include <type_traits>
+#include "MenuTheme.h"
+#include "MenuLabel.h"
 
 using namespace std;
 
@@ -27,12 +30,112 @@ using namespace std;
  * Generic definitions for passing functions as arguments
  *********************/
 
-/*!
- * @brief Callback function for a Short or Long button press
- * 
- * @return bool to indicate the screen should be re-drawn
- */
-typedef bool (*ButtonPressCallback)();
+//
+// Callback for a Short or Long button press.
+// Holds a plain function or a function with a bound context pointer and index,
+// for example the device a button controls and which of its settings.
+// Never allocates and is trivially copyable so it can be part of a
+// PROGMEM definition and read back with memcpy_P.
+// Every callback is called through one BoundFunction, a plain function is
+// kept in place of the context and called by the callPlain thunk, so calling
+// it is one indirect call with no check of which kind it holds.
+//
+class ButtonPressCallback {
+  public:
+    /*!
+     * @brief Plain callback function
+     * @return bool to indicate the screen should be re-drawn
+     */
+    typedef bool (*Function)();
+
+    /*!
+     * @brief Callback function with bound state
+     * @param void* context pointer given when the callback was made
+     * @param int32_t index given when the callback was made
+     * @return bool to indicate the screen should be re-drawn
+     */
+    typedef bool (*BoundFunction)(void*, int32_t);
+
+    constexpr ButtonPressCallback() : function(nullptr), context(nullptr) {};
+    constexpr ButtonPressCallback(std::nullptr_t) : function(nullptr), context(nullptr) {};
+    constexpr ButtonPressCallback(Function f) : function(&callPlain), plain(f) {};
+    constexpr ButtonPressCallback(BoundFunction f, void *c, int32_t i = 0) : function(f), context(c), index(i) {};
+
+    /*!
+     * @brief Call the function with any bound state
+     */
+    bool operator()() const { return function(context, index); };
+
+    /*!
+     * @brief Indicate if there is a function to call
+     */
+    explicit operator bool() const { return (function == &callPlain) ? (plain != nullptr) : (function != nullptr); };
+
+    /*!
+     * @brief Return a copy bound to a different index.
+     *        A plain function ignores the index.
+     */
+    ButtonPressCallback withIndex(int32_t i) const {
+      ButtonPressCallback callback = *this;
+      callback.index = i;
+      return callback;
+    };
+
+  private:
+    /*!
+     * @brief Thunk calling a plain function kept in place of the context
+     */
+    static bool callPlain(void *plainFunction, int32_t) { return reinterpret_cast<Function>(plainFunction)(); };
+
+    BoundFunction function;   // Function called, callPlain for a plain function
+    union {
+      void *context;          // Bound context pointer
+      Function plain;         // Plain function called by callPlain
+    };
+    int32_t index = 0;        // Bound index
+};
+
+static_assert(sizeof(ButtonPressCallback::Function) == sizeof(void*), "A plain function is kept in place of the context pointer");
+static_assert(std::is_trivially_copyable<ButtonPressCallback>::value, "ButtonPressCallback is copied out of PROGMEM");
+
+
+/*********************
+ * Pixel rectangle
+ *********************/
+
+//
+// Pixel position and size of an item on the screen.
+// Calculated by the layout pass and read by drawing and hit testing.
+//
+struct MenuRect {
+  int16_t x;
+  int16_t y;
+  int16_t w;
+  int16_t h;
+
+  /*!
+   * @brief Indicate if a pixel is inside the rectangle, excluding the edges
+   */
+  bool contains(int16_t pX, int16_t pY) const { return (x < pX && pX < x + w) && (y < pY && pY < y + h); };
+};
+
+
+/*********************
+ * Menu item definition
+ *********************/
+
+//
+// Settings of a MenuItem that never change.
+// Declared constexpr and PROGMEM so only the item state uses RAM.
+// Read with the pgm_read functions, which also work for a definition
+// in RAM made for a button created at runtime.
+//
+struct MenuItemDef {
+  const char *label;                  // PROGMEM text shown on the item
+  ThemeRole color;                    // Theme color of the item
+  ButtonPressCallback onShortPress;   // Function to call on a short press or nullptr
+  ButtonPressCallback onLongPress;    // Function to call on a long press or nullptr
+};
 
 
 /*********************
@@ -63,70 +166,166 @@ class MenuItem {
     bool isActive() { return active; };
 
     /*!
-     * @brief Set the color of this item
+     * @brief Set a custom color for this item.
+     *        The shades are calculated once here instead of on every draw.
      */
-    void setColor(uint16_t c) {color = c; };
+    void setColor(uint16_t c) { colorRole = THEME_CUSTOM; customColor = themeColor(c); };
+
+    /*!
+     * @brief Indicate if this item uses a custom color of c rather than a theme color
+     */
+    bool hasCustomColor(uint16_t c) { return colorRole == THEME_CUSTOM && customColor.base == c; };
+
+    /*!
+     * @brief Set this item to use a color from the active theme
+     */
+    void setColor(ThemeRole r) { colorRole = r; };
 
     /*!
      * @brief Return the color of this item
      * @return color
      */
-    uint16_t getColor() {return color; };
+    uint16_t getColor() { return getThemeColor().base; };
+
+    /*!
+     * @brief Return the color and shades of this item
+     * @return ThemeColor from the active theme or the custom color
+     */
+    const ThemeColor& getThemeColor() { return (colorRole == THEME_CUSTOM) ? customColor : ::getThemeColor(colorRole); };
+
+    /*!
+     * @brief Return the colors to draw this item with
+     * @return ThemeColor of the item, using the disabled, pressed or dimmed shade for the item state
+     */
+    ThemeColor getDrawColor() {
+      ThemeColor drawColor = getThemeColor();
+      if (disabled) {
+        drawColor.base = drawColor.disabled;
+      }
+      else if (pressed) {
+        drawColor.base = drawColor.pressed;
+      }
+      else if (stale) {
+        drawColor.base = drawColor.dimmed;
+      }
+      return drawColor;
+    };
+
+    /*!
+     * @brief Set that this item is being pressed and its callback is running
+     */
+    void setPressed(bool p) { pressed = p; };
+
+    /*!
+     * @brief Indicate if this item is being pressed
+     */
+    bool isPressed() { return pressed; };
+
+    /*!
+     * @brief Set that this item can not be used, it ignores touches
+     */
+    void setDisabled(bool d) { disabled = d; };
+
+    /*!
+     * @brief Indicate if this item can not be used
+     */
+    bool isDisabled() { return disabled; };
 
     /*!
-     * @brief Set the name of this item
+     * @brief Set that the state of this item was restored from before a reboot
+     *        and has not been confirmed by the device it controls
      */
-    void setName(String n) { name = n;};
+    void setStale(bool s) { stale = s; };
+
+    /*!
+     * @brief Indicate if the state of this item has not been confirmed since a reboot
+     */
+    bool isStale() { return stale; };
+
+    /*!
+     * @brief Set the name of this item from text that may change.
+     *        The text is copied into the label pool, not the heap.
+     */
+    void setName(const char *n) { name.set(n);};
+
+    /*!
+     * @brief Set the name of this item from a PROGMEM string
+     */
+    void setName(const __FlashStringHelper *n) { name.set(n);};
+
+    void resetName();
+
+    void setDef(const MenuItemDef *itemDef);
 
     /*!
      * @brief Return the name of this item
-     * @return String
+     * @return MenuLabel that can be printed or drawn without copying
      */
-    String getName() {return name; };
+    const MenuLabel& getName() {return name; };
 
     /*!
      * @brief Set the text size of this item
      */
     void setTextSize(int16_t s) { textSize = s;};
 
+    /*!
+     * @brief Return the text size of this item
+     */
+    int16_t getTextSize() { return textSize;};
+
     /*!
      * @brief Set the text color of this item
+     *        Overrides the theme's text color
      */
-    void setTextColor(int16_t c) { textColor = c;};
+    void setTextColor(int16_t c) { textColor = c; textColorSet = true;};
 
     /*!
-     * @brief Set the Short Press Callback Function for this item
+     * @brief Return the text color to use when drawing this item
+     *        Uses the contrasting theme text when filled and the item color when outlined
      */
-    void setShortPressCallback(ButtonPressCallback onPress) { shortPressCallback = onPress;};
+    uint16_t getTextColor() { return textColorSet ? textColor : (isFilled() ? getDrawColor().text : getDrawColor().base); };
 
     /*!
-     * @brief Indicate if there is a Short Press Callback Function for this item
-     * @return bool True if a Short Press Callback funciton has been defined; false if none
+     * @brief Indicate if this item is drawn filled rather than outlined
      */
-    bool hasShortPressCallback() { return (shortPressCallback != nullptr);};
-    bool callbackShortPress();
+    bool isFilled() { return active || pressed; };
 
     /*!
-     * @brief Set the Long Press Callback Function for this item
+     * @brief Indicate if there is a Short Press Callback Function for this item
+     * @return bool True if a Short Press Callback funciton has been defined; false if none
      */
-    void setLongPressCallback(ButtonPressCallback onPress) { longPressCallback = onPress;};
+    bool hasShortPressCallback() { return (bool) getShortPressCallback();};
+    bool callbackShortPress();
 
     /*!
      * @brief Indicate if there is a Long Press Callback Function for this item
      * @return bool True if a Long Press Callback funciton has been defined; false if none
      */
-    bool hasLongPressCallback() { return (longPressCallback != nullptr);};
+    bool hasLongPressCallback() { return (bool) getLongPressCallback();};
     bool callbackLongPress();
 
   protected:
-    MenuItem() {};            // Hidden Constructor
-    String name;              // Name to put in the Button
+    MenuItem(const MenuItemDef *itemDef, int16_t itemTextSize);  // Hidden Constructor
+
+    ButtonPressCallback getShortPressCallback() { return readCallback(&def->onShortPress);};
+    ButtonPressCallback getLongPressCallback() { return readCallback(&def->onLongPress);};
+    static ButtonPressCallback readCallback(const ButtonPressCallback *flashCallback) {
+      ButtonPressCallback callback;
+      memcpy_P(&callback, flashCallback, sizeof(ButtonPressCallback));
+      return callback;
+    };
+
+    const MenuItemDef *def;   // Settings that do not change, in PROGMEM
+    MenuLabel name;           // Name to put in the Button
     bool active = false;      // Indicates if this Item is active; true = Active; false = inactive
-    uint16_t color;           // Color to use for this menu
+    bool stale = false;       // Indicates the state was restored after a reboot and not confirmed yet
+    bool pressed = false;     // Indicates the item is being pressed
+    bool disabled = false;    // Indicates the item can not be used
+    ThemeRole colorRole = THEME_CUSTOM; // Theme color to use for this menu
+    ThemeColor customColor;   // Color to use for this menu when not using the theme
     int16_t textSize;         // Size of Font for menu
     uint16_t textColor;       // Text Color for menu
-    ButtonPressCallback shortPressCallback = nullptr;  // Function to call if the button was pressed
-    ButtonPressCallback longPressCallback = nullptr;  // Function to call if the button was pressed
+    bool textColorSet = false;  // Indicates the text color overrides the theme
 
 
 };
@@ -136,7 +335,8 @@ class MenuItem {
  * Non Class Functions
  *********************/
 
-void centerText(Adafruit_GFX *tft, String text, int16_t centerX, int16_t centerY, int16_t textSize, uint16_t textColor);
-uint16_t getTextWidth (Adafruit_GFX *tft, String text, int16_t textSize);
+void centerText(Adafruit_GFX *tft, const MenuLabel &text, int16_t centerX, int16_t centerY, int16_t textSize, uint16_t textColor);
+uint16_t getTextWidth (Adafruit_GFX *tft, const MenuLabel &text, int16_t textSize);
+void getTextBounds (Adafruit_GFX *tft, const MenuLabel &text, uint16_t *textWidth, uint16_t *textHeight);
 
 #endif
\ No newline at end of file
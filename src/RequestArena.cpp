@@ -0,0 +1,117 @@
+/*
+ * RequestArena
+ *
+ * One reserved block of memory for the short lived buffers of a network request.
+ */
+
+#include <Arduino.h>
+#include "RequestArena.h"
+
+// Uncomment the following define to debug the arena allocations
+//#define REQUESTARENA_DEBUG
+
+RequestArena requestArena;
+
+
+/*********************
+ * RequestArena Class functions
+ *********************/
+
+//
+// Round a size up to the arena alignment
+//
+static size_t alignSize(size_t size) {
+  return (size + REQUEST_ARENA_ALIGN - 1) & ~(size_t)(REQUEST_ARENA_ALIGN - 1);
+}
+
+
+//
+// Take the next block from the arena
+//
+// @return pointer to the block or nullptr if it does not fit
+//
+void* RequestArena::allocate(size_t size) {
+  size_t alignedSize = alignSize(size);
+  if (alignedSize > REQUEST_ARENA_SIZE - top) {
+    failed++;
+    #ifdef REQUESTARENA_DEBUG
+    Serial.print("Request arena full, unable to allocate ");
+    Serial.println(size);
+    #endif
+    return nullptr;
+  }
+
+  last = top;
+  top += alignedSize;
+  highest = max(highest, top);
+  return buffer + last;
+}
+
+
+//
+// Change the size of a block.
+// The last block grows or shrinks in place, any other block is copied to a new block.
+//
+// @return pointer to the block or nullptr if it does not fit
+//
+void* RequestArena::reallocate(void *block, size_t size) {
+  if (!block) {
+    return allocate(size);
+  }
+
+  uint8_t *oldBlock = (uint8_t*) block;
+  if (oldBlock == buffer + last) {
+    size_t alignedSize = alignSize(size);
+    if (alignedSize > REQUEST_ARENA_SIZE - last) {
+      failed++;
+      return nullptr;
+    }
+    top = last + alignedSize;
+    highest = max(highest, top);
+    return block;
+  }
+
+  // Not the last block so the old size is only known to be no more than the rest of the arena
+  void *newBlock = allocate(size);
+  if (newBlock) {
+    memmove(newBlock, oldBlock, min(size, (size_t)(buffer + REQUEST_ARENA_SIZE - oldBlock)));
+  }
+  return newBlock;
+}
+
+
+//
+// Give back everything allocated after a mark
+//
+void RequestArena::release(size_t position) {
+  if (position < top) {
+    top = position;
+    last = position;
+  }
+}
+
+
+/*********************
+ * RequestArenaWriter Class functions
+ *********************/
+
+//
+// Append bytes to the text, growing the arena block in place
+//
+size_t RequestArenaWriter::write(const uint8_t *data, size_t size) {
+  if (overflow) {
+    return 0;
+  }
+
+  char *grown = (char*) requestArena.reallocate(text, textLength + size + 1);
+  if (!grown) {
+    overflow = true;
+    return 0;
+  }
+
+  text = grown;
+  memcpy(text + textLength, data, size);
+  textLength += size;
+  text[textLength] = '\0';
+  return size;
+}
@@ -0,0 +1,147 @@
+/*
+ * @file RequestArena.h
+ *
+ * A RequestArena is one reserved block of memory used for the
+ * short lived buffers of a network request: the response body and
+ * the JSON document parsed from it.
+ *
+ * Memory is handed out by moving a pointer forward and is all given
+ * back at once when the RequestArenaScope of the request ends.
+ * The request no longer mixes many small heap allocations that are
+ * freed in a different order than they were made, which is what
+ * fragments the heap.
+ *
+ * WiFiClient and HTTPClient still use the heap for their own buffers.
+ */
+#pragma once
+
+#ifndef __REQUESTARENA_H
+#define __REQUESTARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define REQUEST_ARENA_SIZE 4096       // Bytes reserved for the buffers of one request
+#define REQUEST_ARENA_ALIGN 4         // Alignment of every allocation
+
+
+/*********************
+ * RequestArena Class
+ *********************/
+
+//
+// Bump allocator over a fixed block
+//
+class RequestArena {
+  public:
+    void* allocate(size_t size);
+    void* reallocate(void *block, size_t size);
+
+    /*!
+     * @brief Return the position to go back to with release()
+     */
+    size_t mark() { return top; };
+    void release(size_t position);
+
+    /*!
+     * @brief return the number of bytes in use
+     */
+    size_t used() { return top; };
+    /*!
+     * @brief return the most bytes ever in use
+     */
+    size_t highWater() { return highest; };
+    /*!
+     * @brief return the number of allocations that did not fit
+     */
+    uint32_t failures() { return failed; };
+
+  private:
+    alignas(REQUEST_ARENA_ALIGN) uint8_t buffer[REQUEST_ARENA_SIZE];
+    size_t top = 0;         // Offset of the first free byte
+    size_t last = 0;        // Offset of the last allocation, the only one that can grow
+    size_t highest = 0;     // Most bytes ever in use
+    uint32_t failed = 0;    // Number of allocations that did not fit
+};
+
+extern RequestArena requestArena;
+
+
+/*********************
+ * RequestArenaScope Class
+ *********************/
+
+//
+// Gives back everything allocated from the arena during its scope.
+// Declare it before any object that uses the arena so those objects are destroyed first.
+//
+class RequestArenaScope {
+  public:
+    RequestArenaScope() { start = requestArena.mark(); };
+    ~RequestArenaScope() { requestArena.release(start); };
+
+    RequestArenaScope(const RequestArenaScope&) = delete;
+    RequestArenaScope& operator=(const RequestArenaScope&) = delete;
+
+  private:
+    size_t start;   // Arena position when the scope started
+};
+
+
+/*********************
+ * ArduinoJson allocator
+ *********************/
+
+//
+// ArduinoJson allocator taking the document memory from the request arena.
+// Memory is only given back when the RequestArenaScope ends.
+//
+struct RequestArenaAllocator {
+  void* allocate(size_t size) { return requestArena.allocate(size); };
+  void deallocate(void*) {};
+  void* reallocate(void *block, size_t size) { return requestArena.reallocate(block, size); };
+};
+
+typedef BasicJsonDocument<RequestArenaAllocator> RequestJsonDocument;
+
+
+/*********************
+ * RequestArenaWriter Class
+ *********************/
+
+//
+// Stream that collects a response body in the request arena.
+// Given to HTTPClient::writeToStream which also handles chunked responses.
+//
+class RequestArenaWriter: public Stream {
+  public:
+    size_t write(uint8_t c) override { return write(&c, 1); };
+    size_t write(const uint8_t *data, size_t size) override;
+
+    // Nothing to read back, the text is used through c_str()
+    int available() override { return 0; };
+    int read() override { return -1; };
+    int peek() override { return -1; };
+    void flush() override {};
+
+    /*!
+     * @brief Return the text written so far, nul terminated, or an empty string
+     */
+    char* c_str() { return text ? text : empty; };
+    /*!
+     * @brief return the number of bytes written
+     */
+    size_t length() { return textLength; };
+    /*!
+     * @brief Indicate if some of the text did not fit in the arena
+     */
+    bool overflowed() { return overflow; };
+
+  private:
+    char *text = nullptr;     // Text in the arena
+    size_t textLength = 0;    // Bytes of text not counting the nul
+    bool overflow = false;    // Indicates bytes were dropped
+    char empty[1] = "";       // Returned when nothing has been written
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * @file StaticVector.h
+ *
+ * A StaticVector is a list with a fixed capacity stored inside the object.
+ * It never uses the heap so the menu does not fragment memory after boot.
+ *
+ * Code that is not a template works with a StaticVectorBase which
+ * knows the capacity at runtime.  The StaticVector template supplies
+ * the storage and checks the capacity at compile time.
+ */
+#pragma once
+
+#ifndef __STATICVECTOR_H
+#define __STATICVECTOR_H
+
+#include <Arduino.h>
+#include <algorithm>
+
+
+/*********************
+ * StaticVectorBase Class
+ *********************/
+
+//
+// Operations on a fixed capacity list without knowing the capacity at compile time
+//
+template <class T>
+class StaticVectorBase {
+  public:
+    StaticVectorBase(const StaticVectorBase&) = delete;
+    StaticVectorBase& operator=(const StaticVectorBase&) = delete;
+
+    T* begin() { return items; };
+    T* end() { return items + count; };
+    const T* begin() const { return items; };
+    const T* end() const { return items + count; };
+
+    T& operator[](uint8_t index) { return items[index]; };
+    const T& operator[](uint8_t index) const { return items[index]; };
+    T& back() { return items[count - 1]; };
+
+    uint8_t size() const { return count; };
+    uint8_t capacity() const { return itemCapacity; };
+    bool empty() const { return count == 0; };
+    bool full() const { return count >= itemCapacity; };
+
+    /*!
+     * @brief Add an item to the end of the list
+     * @return false if the list is full
+     */
+    bool push_back(const T &item) {
+      if (full()) {
+        return false;
+      }
+      items[count++] = item;
+      return true;
+    };
+
+    /*!
+     * @brief Remove the last item
+     */
+    void pop_back() { if (count) count--; };
+
+    /*!
+     * @brief Remove an item and move the items after it down one place
+     * @return pointer to the item that followed the removed item
+     */
+    T* erase(T *position) {
+      std::copy(position + 1, end(), position);
+      count--;
+      return position;
+    };
+
+    /*!
+     * @brief Remove all items
+     */
+    void clear() { count = 0; };
+
+  protected:
+    StaticVectorBase(T *storage, uint8_t storageCapacity) : items(storage), itemCapacity(storageCapacity) {};
+
+  private:
+    T *items;               // Storage in the StaticVector
+    uint8_t count = 0;      // Number of items in use
+    uint8_t itemCapacity;   // Number of items the storage holds
+};
+
+
+/*********************
+ * StaticVector template
+ *********************/
+
+//
+// Fixed capacity list holding its own storage
+//
+template <class T, uint8_t Capacity>
+class StaticVector: public StaticVectorBase<T> {
+  public:
+    StaticVector() : StaticVectorBase<T>(storage, Capacity) {};
+
+    /*!
+     * @brief Constructor filling the list from an array.
+     *        The array must fit, which is checked at compile time.
+     */
+    template <size_t Count>
+    StaticVector(const T (&initialItems)[Count]) : StaticVectorBase<T>(storage, Capacity) {
+      static_assert(Count <= Capacity, "Too many items for the StaticVector capacity");
+      for (const T &item : initialItems) {
+        this->push_back(item);
+      }
+    };
+
+  private:
+    T storage[Capacity ? Capacity : 1];
+};
+
+#endif
@@ -0,0 +1,358 @@
+/*
+ * TimeRules
+ *
+ * Rules that change the button panel by the time of the week.
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <Ticker.h>
+#include <ArduinoJson.h>
+#include "TimeRules.h"
+#include "MenuImage.h"
+#include "RequestArena.h"
+
+#define TIMERULES_WEEK_SECONDS (7UL * 24 * 60 * 60)
+
+// Used when there is no rules file, the screen stays on during work hours
+static const TimeRule defaultRules[] = {
+  {RULE_SCREEN_ON, 0x3E, 7 * 60, 18 * 60, nullptr, nullptr}   // Monday to Friday 7:00 to 18:00
+};
+
+static StaticVector<TimeRule, TIMERULES_MAX_RULES> timeRules;   // Rules in use
+static Menu *rulesMenu = nullptr;                   // Menu pages are shown in
+static NTPClient *rulesTimeClient = nullptr;        // Source of the local time
+static TimeRulesScreenCallback rulesScreenCallback = nullptr;
+static Ticker rulesTicker;                          // Timer armed for the next transition
+static volatile bool rulesDue = true;               // Set by rulesTicker, the rules are applied in loop()
+static bool rulesTimeKnown = false;                 // Indicates rulesLastTime is a real time
+static uint32_t rulesLastTime = 0;                  // Second of the week the rules were last applied
+static uint32_t rulesNextWait = 0;                  // Seconds the timer was last armed for
+static bool rulesScreenOn = false;                  // Last screen state sent to rulesScreenCallback
+
+
+/*********************
+ * Rule functions
+ *********************/
+
+//
+// Seconds from one second of the week to a later one, wrapping at the end of the week
+//
+static uint32_t weekSecondsUntil(uint32_t from, uint32_t to) {
+  return (to + TIMERULES_WEEK_SECONDS - from) % TIMERULES_WEEK_SECONDS;
+}
+
+
+//
+// Length of a screen window in seconds, a window ending before it starts runs past midnight
+//
+static uint32_t windowLength(const TimeRule &rule) {
+  uint16_t minutes = (rule.end > rule.start) ? rule.end - rule.start : rule.end + 24 * 60 - rule.start;
+  return minutes * 60UL;
+}
+
+
+//
+// Second of the week a rule starts on a day
+//
+static uint32_t ruleStart(const TimeRule &rule, uint8_t day) {
+  return (day * 24UL * 60 + rule.start) * 60;
+}
+
+
+//
+// Indicate a screen window is open at a second of the week
+//
+static bool windowOpen(const TimeRule &rule, uint32_t weekTime) {
+  for (uint8_t day = 0; day < 7; day++) {
+    if ((rule.days & (1 << day)) && weekSecondsUntil(ruleStart(rule, day), weekTime) < windowLength(rule)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+//
+// Seconds until the next time a rule changes something, TIMERULES_WEEK_SECONDS if it never does
+//
+static uint32_t secondsToTransition(const TimeRule &rule, uint32_t weekTime) {
+  uint32_t wait = TIMERULES_WEEK_SECONDS;
+  for (uint8_t day = 0; day < 7; day++) {
+    if (!(rule.days & (1 << day))) {
+      continue;
+    }
+    uint32_t start = ruleStart(rule, day);
+    uint32_t untilStart = weekSecondsUntil(weekTime, start);
+    if (untilStart > 0) {
+      wait = min(wait, untilStart);
+    }
+    if (rule.type == RULE_SCREEN_ON) {
+      uint32_t untilEnd = weekSecondsUntil(weekTime, (start + windowLength(rule)) % TIMERULES_WEEK_SECONDS);
+      if (untilEnd > 0) {
+        wait = min(wait, untilEnd);
+      }
+    }
+  }
+  return wait;
+}
+
+
+//
+// Indicate a rule starts after from and no later than to
+//
+static bool ruleStartsBetween(const TimeRule &rule, uint32_t from, uint32_t to) {
+  uint32_t elapsed = weekSecondsUntil(from, to);
+  for (uint8_t day = 0; day < 7; day++) {
+    if (rule.days & (1 << day)) {
+      uint32_t untilStart = weekSecondsUntil(from, ruleStart(rule, day));
+      if (untilStart > 0 && untilStart <= elapsed) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+
+//
+// Do what a rule does at its start
+//
+static void fireRule(const TimeRule &rule) {
+  if (rule.type == RULE_ACTION && rule.action) {
+    Serial.println("Time rule action");
+    rule.action();
+  }
+  else if (rule.type == RULE_SHOW_PAGE && rule.page && rulesMenu) {
+    Serial.print("Time rule showing page ");
+    Serial.println(rule.page->getName());
+    if (rulesMenu->setActiveTopMenu(rule.page)) {
+      rulesMenu->draw();
+    }
+  }
+}
+
+
+//
+// Timer callback.
+// Runs outside loop() so only marks the rules due.
+//
+static void rulesTimer() {
+  rulesDue = true;
+}
+
+
+//
+// Read a time of day like "07:30" as minutes from midnight
+//
+// @return false if the text is not a time of day
+//
+static bool parseTimeOfDay(const char *text, uint16_t *minutes) {
+  unsigned int hour, minute;
+  if (!text || sscanf(text, "%u:%u", &hour, &minute) != 2 || hour > 24 || minute > 59 || hour * 60 + minute > 24 * 60) {
+    return false;
+  }
+  *minutes = (hour * 60 + minute) % (24 * 60);
+  return true;
+}
+
+
+//
+// Read one rule from the rules file
+//
+// @return false if the rule is not valid
+//
+static bool parseRule(JsonObject ruleJson, TimeRule *rule) {
+  *rule = {RULE_SCREEN_ON, TIMERULES_ALL_DAYS, 0, 0, nullptr, nullptr};
+
+  if (ruleJson.containsKey("days")) {
+    rule->days = 0;
+    for (JsonVariant day : ruleJson["days"].as<JsonArray>()) {
+      unsigned int dayNumber = day.as<unsigned int>();
+      if (dayNumber > 6) {
+        return false;
+      }
+      rule->days |= (1 << dayNumber);
+    }
+  }
+
+  if (ruleJson.containsKey("screen")) {
+    rule->type = RULE_SCREEN_ON;
+    return parseTimeOfDay(ruleJson["from"].as<const char*>(), &rule->start) && parseTimeOfDay(ruleJson["to"].as<const char*>(), &rule->end) && rule->start != rule->end;
+  }
+
+  if (!parseTimeOfDay(ruleJson["at"].as<const char*>(), &rule->start)) {
+    return false;
+  }
+  if (ruleJson.containsKey("action")) {
+    rule->type = RULE_ACTION;
+    const char *actionName = ruleJson["action"].as<const char*>();
+    rule->action = actionName ? menuImageFindAction(actionName, ruleJson["arg"].as<int32_t>()) : nullptr;
+    return (bool) rule->action;
+  }
+  if (ruleJson.containsKey("page")) {
+    rule->type = RULE_SHOW_PAGE;
+    const char *pageName = ruleJson["page"].as<const char*>();
+    rule->page = pageName ? menuImageFindPage(pageName) : nullptr;
+    return rule->page != nullptr;
+  }
+  return false;
+}
+
+
+/*********************
+ * Non Class Functions
+ *********************/
+
+//
+// Start applying the rules.
+// Loads TIMERULES_PATH, or the default rules if there is no rules file.
+// Call after the pages and actions are registered and LittleFS is started.
+//
+// @param menu           Menu pages are shown in
+// @param timeClient     Source of the local time
+// @param screenCallback Function told when the screen must stay on
+//
+void timeRulesSetup(Menu *menu, NTPClient *timeClient, TimeRulesScreenCallback screenCallback) {
+  rulesMenu = menu;
+  rulesTimeClient = timeClient;
+  rulesScreenCallback = screenCallback;
+
+  if (!LittleFS.exists(TIMERULES_PATH) || !timeRulesLoad(TIMERULES_PATH)) {
+    timeRules.clear();
+    for (const TimeRule &rule : defaultRules) {
+      timeRules.push_back(rule);
+    }
+  }
+  rulesDue = true;
+}
+
+
+//
+// Replace the rules with the ones in a JSON file.
+// The file is parsed in the request arena.
+//
+// @return false if the file can not be read or a rule is not valid, the rules are not changed
+//
+bool timeRulesLoad(const char *path) {
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    Serial.print("Unable to open time rules ");
+    Serial.println(path);
+    return false;
+  }
+
+  RequestArenaScope arenaScope;
+  RequestJsonDocument rulesDoc(2048);
+  DeserializationError error = deserializeJson(rulesDoc, file);
+  file.close();
+  if (error) {
+    Serial.print("Time rules not valid JSON: ");
+    Serial.println(error.c_str());
+    return false;
+  }
+
+  JsonArray rulesJson = rulesDoc["rules"].as<JsonArray>();
+  if (rulesJson.size() > TIMERULES_MAX_RULES) {
+    Serial.print("Too many time rules, at most ");
+    Serial.println(TIMERULES_MAX_RULES);
+    return false;
+  }
+
+  StaticVector<TimeRule, TIMERULES_MAX_RULES> loaded;
+  uint8_t ruleIndex = 0;
+  for (JsonObject ruleJson : rulesJson) {
+    TimeRule rule;
+    if (!parseRule(ruleJson, &rule)) {
+      Serial.print("Time rule not valid: ");
+      Serial.println(ruleIndex);
+      return false;
+    }
+    loaded.push_back(rule);
+    ruleIndex++;
+  }
+
+  timeRules.clear();
+  for (const TimeRule &rule : loaded) {
+    timeRules.push_back(rule);
+  }
+  rulesTimeKnown = false;
+  rulesDue = true;
+  Serial.print("Time rules loaded: ");
+  Serial.println(timeRules.size());
+  return true;
+}
+
+
+//
+// Apply the rules when the timer has fired and arm it for the next transition.
+// Screen windows are set to match the time, actions and pages are only
+// done for rules that started since the rules were last applied.
+//
+void timeRulesHandle() {
+  if (!rulesDue || !rulesTimeClient) {
+    return;
+  }
+  rulesDue = false;
+
+  unsigned long epoch = rulesTimeClient->getEpochTime();
+  if (epoch < TIMERULES_MIN_EPOCH) {
+    // The time is not known yet
+    rulesNextWait = TIMERULES_RETRY_WAIT;
+    rulesTicker.once(rulesNextWait, &rulesTimer);
+    return;
+  }
+
+  // 1 Jan 1970 was a Thursday
+  uint32_t weekTime = ((epoch / 86400 + 4) % 7) * 86400 + epoch % 86400;
+
+  // A clock set back by NTP would look like a whole week passing
+  uint32_t elapsed = weekSecondsUntil(rulesLastTime, weekTime);
+  bool fire = rulesTimeKnown && elapsed < TIMERULES_WEEK_SECONDS / 2;
+
+  bool screenOn = false;
+  uint32_t wait = TIMERULES_MAX_WAIT;
+  for (const TimeRule &rule : timeRules) {
+    if (rule.type == RULE_SCREEN_ON) {
+      screenOn = screenOn || windowOpen(rule, weekTime);
+    }
+    else if (fire && ruleStartsBetween(rule, rulesLastTime, weekTime)) {
+      fireRule(rule);
+    }
+    wait = min(wait, secondsToTransition(rule, weekTime));
+  }
+
+  if (rulesScreenCallback && (screenOn != rulesScreenOn || !rulesTimeKnown)) {
+    rulesScreenCallback(screenOn);
+  }
+  rulesScreenOn = screenOn;
+  rulesLastTime = weekTime;
+  rulesTimeKnown = true;
+
+  rulesNextWait = wait;
+  rulesTicker.once(wait, &rulesTimer);
+}
+
+
+//
+// Print the rules and when they are next applied
+//
+void timeRulesPrint(Print &p) {
+  p.print(F("Time rules "));
+  p.print(timeRules.size());
+  p.print(F(" screen "));
+  p.print(rulesScreenOn ? F("on") : F("auto"));
+  p.print(F(" timer armed for "));
+  p.print(rulesNextWait);
+  p.println(F("s"));
+  p.println(F("Type\tdays\tstart\tend"));
+  for (const TimeRule &rule : timeRules) {
+    p.print(rule.type);
+    p.print('\t');
+    p.print(rule.days, HEX);
+    p.print('\t');
+    p.print(rule.start);
+    p.print('\t');
+    p.println(rule.end);
+  }
+}
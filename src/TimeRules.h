@@ -0,0 +1,83 @@
+/*
+ * @file TimeRules.h
+ *
+ * Rules that change the button panel by the time of the week,
+ * like keeping the screen on during work hours, turning the
+ * On Air sign off in the evening or showing a page at lunch.
+ *
+ * The rules are read from a JSON file on LittleFS:
+ *
+ *   {"rules": [
+ *     {"screen": "on", "days": [1, 2, 3, 4, 5], "from": "07:00", "to": "18:00"},
+ *     {"action": "onair.off", "days": [1, 2, 3, 4, 5], "at": "18:00"},
+ *     {"page": "status", "at": "12:00"}
+ *   ]}
+ *
+ * Days are numbered from Sunday = 0 like NTPClient::getDay and a rule
+ * without days applies every day.  Actions and pages are the names
+ * registered for menu images.  A screen window whose end is before its
+ * start runs past midnight.
+ *
+ * Nothing is polled.  The instant of the next rule transition is
+ * calculated and one timer is armed for it.  The timer only marks
+ * the rules due, they are applied from loop().
+ */
+#pragma once
+
+#ifndef __TIMERULES_H
+#define __TIMERULES_H
+
+#include <Arduino.h>
+#include <NTPClient.h>
+#include "Menu.h"
+
+#define TIMERULES_PATH "/rules.json"        // Rules loaded at boot
+#define TIMERULES_MAX_RULES 16              // Most rules kept
+#define TIMERULES_MAX_WAIT 3600             // Longest timer in seconds, so NTP corrections are picked up
+#define TIMERULES_RETRY_WAIT 30             // Seconds to wait for the time to be set
+#define TIMERULES_MIN_EPOCH 1600000000UL    // Earlier times mean NTP has not set the clock yet
+#define TIMERULES_ALL_DAYS 0x7F             // Bit set of every day of the week
+
+
+//
+// What a rule does
+//
+enum TimeRuleType : uint8_t {
+  RULE_SCREEN_ON = 0,     // Keep the screen on from start to end
+  RULE_ACTION,            // Call a registered action at start
+  RULE_SHOW_PAGE          // Show a registered page at start
+};
+
+
+//
+// A rule on the days of the week set in days.
+// Times are minutes from midnight.
+//
+struct TimeRule {
+  TimeRuleType type;
+  uint8_t days;                   // Bit set of the days, bit 0 is Sunday
+  uint16_t start;                 // Minute the window starts or the action is done
+  uint16_t end;                   // Minute the window ends, not included
+  ButtonPressCallback action;     // Action of a RULE_ACTION
+  MenuPage *page;                 // Page of a RULE_SHOW_PAGE
+};
+
+
+/*!
+ * @brief Function told when the screen must stay on
+ *
+ * @param bool true while a screen window is open
+ */
+typedef void (*TimeRulesScreenCallback)(bool);
+
+
+//
+// Functions
+//
+
+void timeRulesSetup(Menu *menu, NTPClient *timeClient, TimeRulesScreenCallback screenCallback);
+bool timeRulesLoad(const char *path);
+void timeRulesHandle();
+void timeRulesPrint(Print &p);
+
+#endif
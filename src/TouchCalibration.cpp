@@ -0,0 +1,368 @@
+/*
+ * TouchCalibration
+ *
+ * Affine touch screen calibration in fixed point.
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_ILI9341.h>
+#include <XPT2046_Touchscreen.h>
+#include "TouchCalibration.h"
+#include "Crc32.h"
+
+//#define TOUCHCAL_DEBUG
+
+
+/*********************
+ * Non Class Functions
+ *********************/
+
+//
+// Convert a fitted coefficient to Q16
+//
+static int32_t toQ16(double value) {
+  return (int32_t) lround(value * 65536.0);
+}
+
+
+//
+// Fit the matrix to raw readings taken at known screen points.
+// Each screen axis is a least squares plane through the raw points,
+// which is exact for 3 points.  The sums are taken about the mean so
+// the normal equations stay well conditioned with 12 bit readings.
+// Only used while calibrating so floating point is fine here.
+//
+// @param screen Screen pixels of the targets
+// @param raw    Raw reading at each target
+// @param count  Number of targets, at least 3
+// @param matrix Set to the fitted matrix
+//
+// @return false if the raw points are too close to a line to fit, matrix is not changed
+//
+bool touchCalibrationSolve(const TouchPoint *screen, const TouchPoint *raw, uint8_t count, TouchMatrix *matrix) {
+  if (count < 3) {
+    return false;
+  }
+
+  double meanRawX = 0, meanRawY = 0, meanScreenX = 0, meanScreenY = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    meanRawX += raw[i].x;
+    meanRawY += raw[i].y;
+    meanScreenX += screen[i].x;
+    meanScreenY += screen[i].y;
+  }
+  meanRawX /= count;
+  meanRawY /= count;
+  meanScreenX /= count;
+  meanScreenY /= count;
+
+  double sumXX = 0, sumXY = 0, sumYY = 0;
+  double sumXScreenX = 0, sumYScreenX = 0, sumXScreenY = 0, sumYScreenY = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    double rawX = raw[i].x - meanRawX;
+    double rawY = raw[i].y - meanRawY;
+    double screenX = screen[i].x - meanScreenX;
+    double screenY = screen[i].y - meanScreenY;
+    sumXX += rawX * rawX;
+    sumXY += rawX * rawY;
+    sumYY += rawY * rawY;
+    sumXScreenX += rawX * screenX;
+    sumYScreenX += rawY * screenX;
+    sumXScreenY += rawX * screenY;
+    sumYScreenY += rawY * screenY;
+  }
+
+  // A determinant near 0 means the raw points are on a line
+  double determinant = sumXX * sumYY - sumXY * sumXY;
+  if (determinant <= 1e-6 * sumXX * sumYY || determinant <= 0) {
+    return false;
+  }
+
+  double xx = (sumXScreenX * sumYY - sumYScreenX * sumXY) / determinant;
+  double xy = (sumYScreenX * sumXX - sumXScreenX * sumXY) / determinant;
+  double yx = (sumXScreenY * sumYY - sumYScreenY * sumXY) / determinant;
+  double yy = (sumYScreenY * sumXX - sumXScreenY * sumXY) / determinant;
+
+  matrix->xx = toQ16(xx);
+  matrix->xy = toQ16(xy);
+  matrix->x0 = toQ16(meanScreenX - xx * meanRawX - xy * meanRawY) + 0x8000;
+  matrix->yx = toQ16(yx);
+  matrix->yy = toQ16(yy);
+  matrix->y0 = toQ16(meanScreenY - yx * meanRawX - yy * meanRawY) + 0x8000;
+  return true;
+}
+
+
+//
+// Largest distance in pixels along x or y between a target
+// and where the matrix maps the raw reading taken at it
+//
+uint16_t touchCalibrationError(const TouchMatrix &matrix, const TouchPoint *screen, const TouchPoint *raw, uint8_t count) {
+  uint16_t error = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    int16_t x = raw[i].x;
+    int16_t y = raw[i].y;
+    touchMatrixMap(matrix, &x, &y);
+    error = max(error, (uint16_t) abs(x - screen[i].x));
+    error = max(error, (uint16_t) abs(y - screen[i].y));
+  }
+  return error;
+}
+
+
+//
+// CRC-32 of the file after the crc field
+//
+static uint32_t calibrationCrc(const TouchCalibrationFile &calibration) {
+  const uint8_t *body = (const uint8_t*) &calibration + offsetof(TouchCalibrationFile, width);
+  return checksumCrc32(body, sizeof(TouchCalibrationFile) - offsetof(TouchCalibrationFile, width));
+}
+
+
+//
+// Read the calibration saved on LittleFS.
+// LittleFS must already be started.
+//
+// @param matrix Set to the saved matrix
+// @param width  Screen width the matrix must map to
+// @param height Screen height the matrix must map to
+//
+// @return false if there is no calibration for this screen size, matrix is not changed
+//
+bool touchCalibrationLoad(TouchMatrix *matrix, int16_t width, int16_t height) {
+  File file = LittleFS.open(TOUCHCAL_PATH, "r");
+  if (!file) {
+    return false;
+  }
+  TouchCalibrationFile calibration;
+  size_t length = file.read((uint8_t*) &calibration, sizeof(calibration));
+  file.close();
+
+  if (length != sizeof(calibration) || calibration.magic != TOUCHCAL_MAGIC
+      || calibration.version != TOUCHCAL_VERSION || calibration.size != sizeof(calibration)
+      || calibration.crc != calibrationCrc(calibration)) {
+    Serial.println("Touch calibration not valid");
+    return false;
+  }
+  if (calibration.width != width || calibration.height != height) {
+    Serial.println("Touch calibration is for another screen size");
+    return false;
+  }
+
+  *matrix = calibration.matrix;
+  Serial.println("Touch calibration loaded");
+  return true;
+}
+
+
+//
+// Save the calibration to LittleFS
+//
+// @return false if the file could not be written
+//
+bool touchCalibrationSave(const TouchMatrix &matrix, int16_t width, int16_t height) {
+  TouchCalibrationFile calibration = {};
+  calibration.magic = TOUCHCAL_MAGIC;
+  calibration.version = TOUCHCAL_VERSION;
+  calibration.size = sizeof(calibration);
+  calibration.width = width;
+  calibration.height = height;
+  calibration.matrix = matrix;
+  calibration.crc = calibrationCrc(calibration);
+
+  File file = LittleFS.open(TOUCHCAL_PATH, "w");
+  if (!file) {
+    Serial.println("Unable to write touch calibration");
+    return false;
+  }
+  size_t length = file.write((const uint8_t*) &calibration, sizeof(calibration));
+  file.close();
+  if (length != sizeof(calibration)) {
+    Serial.println("Touch calibration not completely written");
+    LittleFS.remove(TOUCHCAL_PATH);
+    return false;
+  }
+  return true;
+}
+
+
+/*********************
+ * TouchCalibrator Class functions
+ *********************/
+
+/*
+ * Constructor
+ *
+ * @param tft    Screen the targets are drawn on
+ * @param ts     Touch screen read while calibrating
+ * @param matrix Matrix the touch handler maps with, replaced by a good fit
+ */
+TouchCalibrator::TouchCalibrator(Adafruit_GFX *tft, XPT2046_Touchscreen *ts, TouchMatrix *matrix)
+  : _tft(tft), _ts(ts), _matrix(matrix) {
+}
+
+
+//
+// Start calibrating.
+// Safe to call from a button callback, nothing is drawn until the next handle.
+//
+void TouchCalibrator::start() {
+  state = CALIBRATE_START;
+}
+
+
+//
+// Draw the screen for the current target
+//
+void TouchCalibrator::drawTarget() {
+  const TouchPoint &target = targets[pointIndex];
+  _tft->fillScreen(ILI9341_BLACK);
+  _tft->drawFastHLine(target.x - 10, target.y, 21, ILI9341_WHITE);
+  _tft->drawFastVLine(target.x, target.y - 10, 21, ILI9341_WHITE);
+  _tft->drawCircle(target.x, target.y, 6, ILI9341_RED);
+
+  _tft->setTextColor(ILI9341_WHITE);
+  _tft->setTextSize(2);
+  _tft->setCursor(TOUCHCAL_INSET * 2, _tft->height() / 2 - 30);
+  _tft->print(F("Touch the target "));
+  _tft->print(pointIndex + 1);
+  _tft->print('/');
+  _tft->print(TOUCHCAL_POINTS);
+}
+
+
+//
+// Show the outcome of the calibration
+//
+void TouchCalibrator::showResult(const __FlashStringHelper *message, uint16_t error) {
+  _tft->fillScreen(ILI9341_BLACK);
+  _tft->setTextColor(ILI9341_WHITE);
+  _tft->setTextSize(2);
+  _tft->setCursor(TOUCHCAL_INSET, _tft->height() / 2 - 20);
+  _tft->println(message);
+  _tft->setCursor(TOUCHCAL_INSET, _tft->height() / 2 + 4);
+  _tft->print(F("Error "));
+  _tft->print(error);
+  _tft->print(F(" px"));
+  state = CALIBRATE_RESULT;
+  stateTime = millis();
+}
+
+
+//
+// Fit the matrix to the readings and keep it if it is good.
+// The error of the old matrix at the same targets is printed
+// so the improvement can be checked.
+//
+void TouchCalibrator::finish() {
+  TouchMatrix fitted;
+  if (!touchCalibrationSolve(targets, samples, TOUCHCAL_POINTS, &fitted)) {
+    Serial.println("Touch calibration failed, the points are on a line");
+    showResult(F("Calibration failed"), 0);
+    return;
+  }
+
+  uint16_t error = touchCalibrationError(fitted, targets, samples, TOUCHCAL_POINTS);
+  uint16_t oldError = touchCalibrationError(*_matrix, targets, samples, TOUCHCAL_POINTS);
+  Serial.print("Touch calibration error ");
+  Serial.print(error);
+  Serial.print(" px, was ");
+  Serial.print(oldError);
+  Serial.println(" px");
+
+  if (error > TOUCHCAL_MAX_ERROR) {
+    showResult(F("Calibration failed"), error);
+    return;
+  }
+
+  *_matrix = fitted;
+  touchCalibrationSave(fitted, _tft->width(), _tft->height());
+  showResult(F("Calibration saved"), error);
+}
+
+
+//
+// Run the calibration, call from loop() while isActive()
+//
+// @return true while the screen is touched
+//
+bool TouchCalibrator::handle() {
+  bool touched = _ts->touched();
+
+  switch (state) {
+    case CALIBRATE_IDLE:
+      break;
+
+    case CALIBRATE_START: {
+      int16_t width = _tft->width();
+      int16_t height = _tft->height();
+      targets[0] = {TOUCHCAL_INSET, TOUCHCAL_INSET};
+      targets[1] = {(int16_t) (width - TOUCHCAL_INSET), TOUCHCAL_INSET};
+      targets[2] = {(int16_t) (width - TOUCHCAL_INSET), (int16_t) (height - TOUCHCAL_INSET)};
+      targets[3] = {TOUCHCAL_INSET, (int16_t) (height - TOUCHCAL_INSET)};
+      targets[4] = {(int16_t) (width / 2), (int16_t) (height / 2)};
+      pointIndex = 0;
+      drawTarget();
+      state = CALIBRATE_RELEASE;
+      break;
+    }
+
+    case CALIBRATE_RELEASE:
+      // The press that started the calibration must not be taken for a target
+      if (!touched) {
+        state = CALIBRATE_PRESS;
+      }
+      break;
+
+    case CALIBRATE_PRESS:
+      if (touched) {
+        sampleCount = 0;
+        sumX = 0;
+        sumY = 0;
+        stateTime = millis();
+        state = CALIBRATE_SAMPLE;
+      }
+      break;
+
+    case CALIBRATE_SAMPLE:
+      if (!touched) {
+        // Lifted too early, wait for another press
+        state = CALIBRATE_PRESS;
+        break;
+      }
+      if (millis() - stateTime < TOUCHCAL_SETTLE_DELAY) {
+        break;
+      }
+      {
+        TS_Point point = _ts->getPoint();
+        sumX += point.x;
+        sumY += point.y;
+        sampleCount++;
+      }
+      if (sampleCount < TOUCHCAL_SAMPLES) {
+        break;
+      }
+      samples[pointIndex] = {(int16_t) (sumX / TOUCHCAL_SAMPLES), (int16_t) (sumY / TOUCHCAL_SAMPLES)};
+#ifdef TOUCHCAL_DEBUG
+      Serial.printf("Touch calibration target %d,%d raw %d,%d\n", targets[pointIndex].x, targets[pointIndex].y, samples[pointIndex].x, samples[pointIndex].y);
+#endif
+      pointIndex++;
+      if (pointIndex < TOUCHCAL_POINTS) {
+        drawTarget();
+        state = CALIBRATE_RELEASE;
+      }
+      else {
+        finish();
+      }
+      break;
+
+    case CALIBRATE_RESULT:
+      if (millis() - stateTime > TOUCHCAL_RESULT_DELAY && !touched) {
+        state = CALIBRATE_IDLE;
+      }
+      break;
+  }
+  return touched;
+}
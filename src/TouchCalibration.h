@@ -0,0 +1,153 @@
+/*
+ * @file TouchCalibration.h
+ *
+ * Maps raw touch screen readings to screen pixels with an affine
+ * matrix, which corrects scale, offset, rotation and skew.
+ *
+ * The matrix is in Q16 fixed point with the rounding folded into the
+ * offsets, so mapping a sample is four multiplies, four adds and two
+ * shifts with no division.
+ *
+ * A TouchCalibrator shows targets on the screen, reads the raw touch at
+ * each one and fits the matrix to them by least squares.  The matrix is
+ * kept on LittleFS so the panel only needs calibrating once.
+ */
+#pragma once
+
+#ifndef __TOUCHCALIBRATION_H
+#define __TOUCHCALIBRATION_H
+
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+#include <XPT2046_Touchscreen.h>
+
+#define TOUCHCAL_PATH "/touch.cal"      // Calibration kept on LittleFS
+#define TOUCHCAL_MAGIC 0x4C414354       // "TCAL"
+#define TOUCHCAL_VERSION 1              // Change when TouchCalibrationFile changes
+#define TOUCHCAL_POINTS 5               // Targets shown, the four corners and the center
+#define TOUCHCAL_INSET 24               // Pixels from the edge of the screen to the corner targets
+#define TOUCHCAL_SAMPLES 16             // Raw readings averaged for each target
+#define TOUCHCAL_SETTLE_DELAY 60        // Milliseconds to wait after a press before reading
+#define TOUCHCAL_MAX_ERROR 12           // Largest error in pixels at a target for the fit to be kept
+#define TOUCHCAL_RESULT_DELAY 2000      // Milliseconds the result is shown
+
+
+//
+// A point in raw touch or screen coordinates
+//
+struct TouchPoint {
+  int16_t x;
+  int16_t y;
+};
+
+
+//
+// Affine map from raw touch readings to screen pixels in Q16 fixed point
+//   screen x = (xx * raw x + xy * raw y + x0) >> 16
+//   screen y = (yx * raw x + yy * raw y + y0) >> 16
+// The offsets include half a pixel so the shift rounds to the nearest pixel.
+//
+struct TouchMatrix {
+  int32_t xx, xy, x0;
+  int32_t yx, yy, y0;
+};
+
+
+//
+// Matrix for a panel that only needs scaling, from the raw readings at the
+// edges of the screen.  Used until the panel has been calibrated.
+//
+constexpr TouchMatrix touchMatrixFromRange(int32_t minX, int32_t maxX, int32_t minY, int32_t maxY, int32_t width, int32_t height, bool flipY) {
+  return {
+    (width << 16) / (maxX - minX), 0, -minX * ((width << 16) / (maxX - minX)) + 0x8000,
+    0, (flipY ? -1 : 1) * ((height << 16) / (maxY - minY)),
+    (flipY ? (height << 16) + minY * ((height << 16) / (maxY - minY)) : -minY * ((height << 16) / (maxY - minY))) + 0x8000
+  };
+}
+
+
+//
+// Map a raw touch reading to screen pixels in place
+//
+inline void touchMatrixMap(const TouchMatrix &matrix, int16_t *x, int16_t *y) {
+  int32_t rawX = *x;
+  int32_t rawY = *y;
+  *x = (matrix.xx * rawX + matrix.xy * rawY + matrix.x0) >> 16;
+  *y = (matrix.yx * rawX + matrix.yy * rawY + matrix.y0) >> 16;
+}
+
+
+//
+// Calibration as kept on LittleFS
+//
+struct TouchCalibrationFile {
+  uint32_t magic;         // TOUCHCAL_MAGIC
+  uint16_t version;       // TOUCHCAL_VERSION
+  uint16_t size;          // sizeof(TouchCalibrationFile)
+  uint32_t crc;           // CRC-32 of everything after this field
+  int16_t width;          // Screen width the matrix maps to
+  int16_t height;         // Screen height the matrix maps to
+  TouchMatrix matrix;
+};
+
+
+/*********************
+ * TouchCalibrator Class
+ *********************/
+
+//
+// Full screen calibration.
+// While active it reads the touch screen itself, so the TouchHandler
+// must not be called.  The matrix is only replaced by a good fit.
+//
+class TouchCalibrator {
+  public:
+    TouchCalibrator(Adafruit_GFX *tft, XPT2046_Touchscreen *ts, TouchMatrix *matrix);
+
+    void start();
+    bool handle();
+
+    /*!
+     * @brief Indicate the calibration screen is shown
+     */
+    bool isActive() {return state != CALIBRATE_IDLE;};
+
+  private:
+    enum CalibrateState : uint8_t {
+      CALIBRATE_IDLE = 0,     // Not calibrating
+      CALIBRATE_START,        // Started from a menu callback, the screen is drawn on the next handle
+      CALIBRATE_RELEASE,      // Waiting for the screen to be released
+      CALIBRATE_PRESS,        // Waiting for the target to be pressed
+      CALIBRATE_SAMPLE,       // Reading the raw touch at the target
+      CALIBRATE_RESULT        // Showing the result
+    };
+
+    void drawTarget();
+    void finish();
+    void showResult(const __FlashStringHelper *message, uint16_t error);
+
+    Adafruit_GFX *_tft;
+    XPT2046_Touchscreen *_ts;
+    TouchMatrix *_matrix;             // Matrix used by the panel, replaced by a good fit
+
+    CalibrateState state = CALIBRATE_IDLE;
+    uint8_t pointIndex = 0;           // Target being calibrated
+    uint8_t sampleCount = 0;          // Raw readings summed for the target
+    int32_t sumX = 0;                 // Sum of the raw x readings
+    int32_t sumY = 0;                 // Sum of the raw y readings
+    unsigned long stateTime = 0;      // When the current state started
+    TouchPoint targets[TOUCHCAL_POINTS];  // Screen position of each target
+    TouchPoint samples[TOUCHCAL_POINTS];  // Average raw reading at each target
+};
+
+
+/*********************
+ * Non Class Functions
+ *********************/
+
+bool touchCalibrationSolve(const TouchPoint *screen, const TouchPoint *raw, uint8_t count, TouchMatrix *matrix);
+uint16_t touchCalibrationError(const TouchMatrix &matrix, const TouchPoint *screen, const TouchPoint *raw, uint8_t count);
+bool touchCalibrationLoad(TouchMatrix *matrix, int16_t width, int16_t height);
+bool touchCalibrationSave(const TouchMatrix &matrix, int16_t width, int16_t height);
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * @file TouchFilter.cpp
+ *
+ * Filters the raw touch positions read during a touch.
+ */
+#include <Arduino.h>
+#include <XPT2046_Touchscreen.h>
+#include "TouchFilter.h"
+
+
+//
+// Forget the readings of the last touch, call when a new touch starts
+//
+void TouchFilter::reset() {
+  count = 0;
+  next = 0;
+}
+
+
+//
+// Median of the readings in the window by insertion sort,
+// which is quick for so few values
+//
+int16_t TouchFilter::median(const int16_t *values) {
+  int16_t sorted[TOUCH_FILTER_SAMPLES];
+  for (uint8_t i = 0; i < count; i++) {
+    int16_t value = values[i];
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > value) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = value;
+  }
+  return sorted[count / 2];
+}
+
+
+//
+// Add a raw reading to the filter
+//
+// @return false if the reading was dropped for low pressure
+//
+bool TouchFilter::add(const TS_Point &point) {
+  if (point.z < TOUCH_MIN_PRESSURE) {
+    rejected++;
+    return false;
+  }
+
+  windowX[next] = point.x;
+  windowY[next] = point.y;
+  next = (next + 1) % TOUCH_FILTER_SAMPLES;
+  if (count < TOUCH_FILTER_SAMPLES) {
+    count++;
+  }
+
+  int32_t medianX = (int32_t) median(windowX) * (1 << TOUCH_FILTER_FRACTION);
+  int32_t medianY = (int32_t) median(windowY) * (1 << TOUCH_FILTER_FRACTION);
+  if (count == 1) {
+    // Start the IIR at the first reading rather than pulling it from 0
+    smoothX = medianX;
+    smoothY = medianY;
+  }
+  else {
+    smoothX += (medianX - smoothX) >> TOUCH_FILTER_SHIFT;
+    smoothY += (medianY - smoothY) >> TOUCH_FILTER_SHIFT;
+  }
+  return true;
+}
+
+
+//
+// Get the filtered raw position
+//
+// @return false if no reading of this touch has been kept, x and y are not changed
+//
+bool TouchFilter::get(int16_t *x, int16_t *y) {
+  if (count == 0) {
+    return false;
+  }
+  *x = (smoothX + (1 << (TOUCH_FILTER_FRACTION - 1))) >> TOUCH_FILTER_FRACTION;
+  *y = (smoothY + (1 << (TOUCH_FILTER_FRACTION - 1))) >> TOUCH_FILTER_FRACTION;
+  return true;
+}
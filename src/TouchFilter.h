@@ -0,0 +1,61 @@
+/*
+ * @file TouchFilter.h
+ *
+ * Filters the raw touch positions read during a touch.
+ *
+ * Resistive panels are noisy, most of all while the finger lands
+ * and lifts when the pressure is low.  Readings below a pressure
+ * threshold are dropped, a median of the last few readings removes
+ * spikes and a fixed point IIR smooths what is left.
+ *
+ * XPT2046_Touchscreen averages its own readings and reuses them for
+ * a few millis, so the window is the last TOUCH_FILTER_SAMPLES samples
+ * taken by the TouchHandler rather than extra reads of the controller.
+ */
+#pragma once
+
+#ifndef __TOUCHFILTER_H
+#define __TOUCHFILTER_H
+
+#include <Arduino.h>
+#include <XPT2046_Touchscreen.h>
+
+#define TOUCH_FILTER_SAMPLES 5      // Readings the median is taken over, odd
+#define TOUCH_FILTER_SHIFT 1        // IIR weight of a new reading is 1 / 2^shift
+#define TOUCH_FILTER_FRACTION 8     // Fraction bits kept by the IIR
+#define TOUCH_MIN_PRESSURE 600      // Readings with a lower TS_Point.z are dropped
+
+static_assert(TOUCH_FILTER_SAMPLES % 2 == 1, "The touch filter median needs an odd number of samples");
+
+
+class TouchFilter {
+
+  public:
+    void reset();
+    bool add(const TS_Point &point);
+    bool get(int16_t *x, int16_t *y);
+
+    /*!
+     * @brief Readings dropped for low pressure since the count was cleared
+     */
+    uint32_t getRejected() {return rejected;};
+
+    /*!
+     * @brief Clear the count of dropped readings
+     */
+    void clearRejected() {rejected = 0;};
+
+  private:
+    int16_t median(const int16_t *values);
+
+    int16_t windowX[TOUCH_FILTER_SAMPLES];  // Last readings kept for the median
+    int16_t windowY[TOUCH_FILTER_SAMPLES];
+    uint8_t count = 0;            // Readings in the window
+    uint8_t next = 0;             // Where the next reading goes in the window
+    int32_t smoothX = 0;          // IIR output with TOUCH_FILTER_FRACTION bits of fraction
+    int32_t smoothY = 0;
+    uint32_t rejected = 0;        // Readings dropped for low pressure
+
+};
+
+#endif
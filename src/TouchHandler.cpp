@@ -9,12 +9,22 @@
 
 // Uncomment the following define to debug the screen Event Handling
 //#define TOUCH_HANDLE_DEBUG
+// Uncomment the following define to time the touch filter
+//#define TOUCH_FILTER_BENCHMARK
+
+volatile bool TouchHandler::penDown = false;
+volatile uint32_t TouchHandler::penDownMicros = 0;
 
 //
 // Initialize the Touch Handler
+// Without an irqPin the touch controller is read on every loop.
+// With the XPT2046 PENIRQ line on irqPin it is only read after the pen
+// goes down and until the touch has ended.  Do not also give the pin to
+// XPT2046_Touchscreen, a pin can only have one interrupt handler.
 //
-TouchHandler::TouchHandler(XPT2046_Touchscreen *ts) {
+TouchHandler::TouchHandler(XPT2046_Touchscreen *ts, uint8_t irqPin) {
   _ts = ts;
+  _irqPin = irqPin;
 };
 
 //
@@ -28,56 +38,326 @@ bool TouchHandler::start(EventHandler _eventHandler) {
   debounceTouched = false;
   touchEvent = EVENT_NONE;
   lastPressTime = millis();
+  nextSampleTime = millis();
+  statsStart = millis();
+  lastReadMicros = micros();
+
+  if (isIrqDriven()) {
+    // PENIRQ is pulled low while the screen is touched
+    pinMode(_irqPin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(_irqPin), &TouchHandler::penDownIsr, FALLING);
+  }
 
   return true;
 };
 
 
 /*
- * Send an Event to the registered Event Handler
+ * Pen down interrupt
+ * Only notes the time, the controller is read from loop()
+ */
+void IRAM_ATTR TouchHandler::penDownIsr() {
+  if (!penDown) {
+    penDownMicros = micros();
+    penDown = true;
+  }
+}
+
+
+/*
+ * Read whether the screen is touched.
+ * When interrupt driven the controller is not read while idle
+ * until the pen goes down, which saves an SPI transaction each loop.
+ * Also counts the idle reads and the time taken to detect a touch.
  */
-void TouchHandler::fireEvent() {
+bool TouchHandler::readTouched() {
+  bool touching = wasTouched || debounceTouched || (currentState != EVENT_STATE_NONE);
+
+  // PENIRQ stays low while held, in case the first read missed a light touch
+  if (isIrqDriven() && !touching && !penDown && digitalRead(_irqPin) == HIGH) {
+    return false;
+  }
+
+  uint32_t readMicros = micros();
+  uint32_t downMicros = penDownMicros;
+  bool irqSeen = penDown;
+  bool isTouched = _ts->touched();
+  // PENIRQ pulses low during the conversion, so the interrupt is only cleared after it.
+  // A finger still down is seen by the digitalRead above.
+  penDown = false;
+
+  if (!touching) {
+    idleReads++;
+    if (isTouched) {
+      // Polling can only tell the touch came after the last read
+      uint32_t latency = readMicros - ((isIrqDriven() && irqSeen) ? downMicros : lastReadMicros);
+      touchDowns++;
+      latencyTotal += latency;
+      latencyMax = max(latencyMax, latency);
+    }
+  }
+  lastReadMicros = readMicros;
+
+  return isTouched;
+}
+
+
+/*
+ * Print the controller reads while idle and the touch detection latency
+ * since the last print, then start counting again
+ */
+void TouchHandler::printStats(Print &p) {
+  unsigned long elapsed = millis() - statsStart;
+  p.print(F("Touch "));
+  p.print(isIrqDriven() ? F("interrupt") : F("polling"));
+  p.print(F(" samples/s "));
+  p.print(elapsed ? (sampleCount * 1000.0 / elapsed) : 0.0);
+  p.print(F(" idle reads/s "));
+  p.print(elapsed ? (idleReads * 1000.0 / elapsed) : 0.0);
+  p.print(F(" touches "));
+  p.print(touchDowns);
+  p.print(F(" latency us avg "));
+  p.print(touchDowns ? latencyTotal / touchDowns : 0);
+  p.print(F(" max "));
+  p.print(latencyMax);
+  p.print(F(" light samples "));
+  p.println(filter.getRejected());
+  p.print(F("Touch queue overflows "));
+  p.print(queue.overflows);
+  p.print(F(" most waiting "));
+  p.print(queue.maxDepth);
+  p.print(F(" longest wait ms "));
+  p.println(maxQueueDelay);
+  #ifdef TOUCH_FILTER_BENCHMARK
+  p.print(F("Touch filter cycles per sample: "));
+  p.println(filterCount ? filterCycles / filterCount : 0);
+  filterCycles = 0;
+  filterCount = 0;
+  #endif
+
+  queue.overflows = 0;
+  queue.maxDepth = 0;
+  maxQueueDelay = 0;
+  idleReads = 0;
+  sampleCount = 0;
+  filter.clearRejected();
+  touchDowns = 0;
+  latencyTotal = 0;
+  latencyMax = 0;
+  statsStart = millis();
+}
+
+
+/*
+ * Queue an Event for the registered Event Handler
+ *
+ * @param x Screen X of the event, where the touch started except for drags
+ * @param y Screen Y of the event
+ */
+void TouchHandler::fireEvent(int16_t x, int16_t y) {
     #ifdef TOUCH_HANDLE_DEBUG
     Serial.print("Fire Event ");
     Serial.print(TouchEventNames[touchEvent]);
     Serial.print(" at (");
-    Serial.print(lastPressX);
+    Serial.print(x);
     Serial.print(" , ");
-    Serial.print(lastPressY);
+    Serial.print(y);
     Serial.println(")");
     #endif
 
     Event currentEvent;
     currentEvent.event = touchEvent;
-    currentEvent.pressX = lastPressX;
-    currentEvent.pressY = lastPressY;
-    (*eventHandler)(&currentEvent);
+    currentEvent.pressX = x;
+    currentEvent.pressY = y;
+    currentEvent.velocityX = constrain(velocityX, (int32_t) -32767, (int32_t) 32767);
+    currentEvent.velocityY = constrain(velocityY, (int32_t) -32767, (int32_t) 32767);
+    currentEvent.time = sampleTime;
+    // May run from the background Ticker, so a full queue is only counted, printStats reports it
+    queue.push(currentEvent);
+}
+
+
+/*
+ * Send the queued Events to the registered Event Handler.
+ * Call from loop() after detectEvent.  Handlers that wait on the network
+ * yield, and while they do the touch screen is still sampled from a
+ * Ticker so touches made meanwhile are queued rather than lost.
+ */
+void TouchHandler::dispatchEvents() {
+  if (dispatching || queue.isEmpty()) {
+    return;
+  }
+  dispatching = true;
+  if (sharedBusPin != TOUCH_NO_PIN) {
+    sampleTicker.attach_ms(activeInterval, &TouchHandler::backgroundSample, this);
+  }
+
+  Event event;
+  while (queue.pop(&event)) {
+    maxQueueDelay = max(maxQueueDelay, millis() - event.time);
+    (*eventHandler)(&event);
+  }
+
+  sampleTicker.detach();
+  dispatching = false;
+}
+
+
+/*
+ * Ticker callback while the Events are dispatched.
+ * Runs when the handler yields, which may be in the middle of drawing,
+ * so the screen is only sampled when the display is not using the bus.
+ */
+void TouchHandler::backgroundSample(TouchHandler *handler) {
+  if (!handler->dispatching || digitalRead(handler->sharedBusPin) == LOW) {
+    return;
+  }
+  handler->detectEvent(handler->calibrateTouch);
+}
+
+
+/*
+ * Let the touch screen be sampled while Events are dispatched
+ *
+ * @param csPin Chip select of the display sharing the SPI bus,
+ *              the touch screen is not read while it is low
+ */
+void TouchHandler::setSharedBusPin(uint8_t csPin) {
+  sharedBusPin = csPin;
+}
+
+
+/*
+ * Set how often the touch controller is sampled
+ *
+ * @param idleInterval   Millis between samples while the screen is not touched
+ * @param activeInterval Millis between samples during a touch
+ */
+void TouchHandler::setSampleIntervals(uint16_t idleInterval, uint16_t activeInterval) {
+  this->idleInterval = max(idleInterval, (uint16_t) TOUCH_MIN_INTERVAL);
+  this->activeInterval = max(activeInterval, (uint16_t) TOUCH_MIN_INTERVAL);
+}
+
+
+/*
+ * Set the thresholds used to recognize gestures
+ */
+void TouchHandler::setGestureConfig(const GestureConfig &config) {
+  gestureConfig = config;
+}
+
+
+/*
+ * Give each raw sample of a touch to a recorder, nullptr to stop
+ */
+void TouchHandler::setSampleRecorder(TouchSampleRecorder recorder) {
+  sampleRecorder = recorder;
+}
+
+
+/*
+ * Update the velocity from the latest position of the finger.
+ * Velocity is in pixels per second and smoothed over the last few
+ * samples, so only the last position is kept whatever the touch length.
+ */
+void TouchHandler::trackMovement() {
+  unsigned long elapsed = sampleTime - moveTime;
+  if (elapsed == 0) {
+    return;
+  }
+  int32_t sampleVelocityX = (int32_t) (moveX - lastMoveX) * 1000 / (int32_t) elapsed;
+  int32_t sampleVelocityY = (int32_t) (moveY - lastMoveY) * 1000 / (int32_t) elapsed;
+  velocityX += (sampleVelocityX - velocityX) >> TOUCH_VELOCITY_SHIFT;
+  velocityY += (sampleVelocityY - velocityY) >> TOUCH_VELOCITY_SHIFT;
+  lastMoveX = moveX;
+  lastMoveY = moveY;
+  moveTime = sampleTime;
+}
+
+
+/*
+ * Indicate an event is one of the swipes
+ */
+static bool isSwipe(TouchEvent event) {
+  return (event == EVENT_SWIPE_LEFT) || (event == EVENT_SWIPE_RIGHT) || (event == EVENT_SWIPE_UP) || (event == EVENT_SWIPE_DOWN);
+}
+
+
+/*
+ * Swipe in the direction the finger moved furthest since the press
+ */
+TouchEvent TouchHandler::swipeDirection() {
+  int16_t deltaX = moveX - lastPressX;
+  int16_t deltaY = moveY - lastPressY;
+  if (abs(deltaX) >= abs(deltaY)) {
+    return (deltaX > 0) ? EVENT_SWIPE_RIGHT : EVENT_SWIPE_LEFT;
+  }
+  return (deltaY > 0) ? EVENT_SWIPE_DOWN : EVENT_SWIPE_UP;
 }
 
 
 /*
  * Handle any touch screen actions
+ * Call on every loop, the controller is only sampled when a sample is due:
+ * slowly while idle, quickly during a touch and at once after a pen down
+ * interrupt.  All the delays are measured between sample times so they do
+ * not depend on how fast loop() runs.
  */
 bool TouchHandler::detectEvent(CalibrateTouchCallback _calibrateTouch) {
     TS_Point point;
-    int16_t swipeX;
-    int16_t swipeY;
+
+  calibrateTouch = _calibrateTouch;
+
+  // Is a sample due?
+  unsigned long now = millis();
+  if (!penDown && ((long) (now - nextSampleTime) < 0)) {
+    return wasTouched;
+  }
+  sampleTime = now;
+  sampleCount++;
 
   #ifdef TOUCH_HANDLE_DEBUG
   EventStates lastState = currentState;
   #endif
 
   // Get current state of screen being touched
-  bool isTouched = _ts->touched();
+  bool isTouched = readTouched();
+
+  // Keep to the schedule unless loop() was held up for longer than a sample
+  bool touching = isTouched || debounceTouched || (currentState != EVENT_STATE_NONE);
+  nextSampleTime = ((now - nextSampleTime) < activeInterval ? nextSampleTime : now) + (touching ? activeInterval : idleInterval);
 
   // There is a change in touch state
   if (isTouched != wasTouched) {
     // Change in touch state
-    lastPressTime = millis();
+    lastPressTime = sampleTime;
+    if (isTouched && !debounceTouched) {
+      // A new touch, not the end of a bounce
+      filter.reset();
+    }
+  }
+
+  // Filter the position of every sample during a touch
+  bool sampleKept = false;
+  if (isTouched) {
+    point = _ts->getPoint();
+    #ifdef TOUCH_FILTER_BENCHMARK
+    uint32_t benchmarkStart = ESP.getCycleCount();
+    #endif
+    sampleKept = filter.add(point);
+    #ifdef TOUCH_FILTER_BENCHMARK
+    filterCycles += ESP.getCycleCount() - benchmarkStart;
+    filterCount++;
+    #endif
+  }
+
+  // Record the samples of a touch and the first one after it
+  if (sampleRecorder && (isTouched || wasTouched)) {
+    sampleRecorder(sampleTime, isTouched ? point : TS_Point(), isTouched);
   }
 
   // Make sure the screen touch state has stabilized
-  if ((millis() - lastPressTime) > DEBOUNCE_DELAY) {
+  if ((sampleTime - lastPressTime) > gestureConfig.debounceDelay) {
 
     // Is there a change in touch state?
     if (isTouched != debounceTouched) {
@@ -96,9 +376,12 @@ bool TouchHandler::detectEvent(CalibrateTouchCallback _calibrateTouch) {
         currentState = EVENT_STATE_START;
 
         // Find the calibrated X and Y of the press
-        point = _ts->getPoint();
-        lastPressX = point.x;
-        lastPressY = point.y;
+        if (!filter.get(&lastPressX, &lastPressY)) {
+          // Every reading was too light, use the last one
+          point = _ts->getPoint();
+          lastPressX = point.x;
+          lastPressY = point.y;
+        }
         if (_calibrateTouch) {
           (*_calibrateTouch)(&lastPressX, &lastPressY);
         }
@@ -125,65 +408,112 @@ bool TouchHandler::detectEvent(CalibrateTouchCallback _calibrateTouch) {
   #endif
 
 
+  // Follow the finger during a touch.
+  // A sample dropped for low pressure did not move the filtered position,
+  // so it is skipped rather than counted as the finger standing still.
+  if (sampleKept && (currentState != EVENT_STATE_NONE) && (currentState != EVENT_STATE_START)) {
+    if (filter.get(&moveX, &moveY)) {
+      if (_calibrateTouch) {
+        (*_calibrateTouch)(&moveX, &moveY);
+      }
+      trackMovement();
+    }
+  }
+
   switch(currentState) {
     case EVENT_STATE_START:
         // First touch - set things up for new event
         currentState = EVENT_STATE_INPROGRESS;
         touchEvent = EVENT_SHORT;   // Default to a short press
+        pressStartTime = lastPressTime;
+        moveX = lastPressX;
+        moveY = lastPressY;
+        lastMoveX = lastPressX;
+        lastMoveY = lastPressY;
+        moveTime = sampleTime;
+        velocityX = 0;
+        velocityY = 0;
         break;
 
     case EVENT_STATE_INPROGRESS:
         // event is happening - not fired yet
 
-        // See if the finger moved indicating a swipe
-        point = _ts->getPoint();
-        swipeX = point.x;
-        swipeY = point.y;
-        if (_calibrateTouch) {
-            (*_calibrateTouch)(&swipeX, &swipeY);
-        }
-
-        // Check for a swipe first
-//        if ((abs(swipeX - lastPressX) > SWIPE_MIN_PIXELS) ||
-//            (abs(swipeY - lastPressY) > SWIPE_MIN_PIXELS)) {
-        if (abs(swipeX - lastPressX) > SWIPE_MIN_PIXELS) {
-            // Finger moved so a swipe is happening
-            if (swipeX > lastPressX) {
-                touchEvent = EVENT_SWIPE_RIGHT;
-            }
-            else if (swipeX < lastPressX) {
-                touchEvent = EVENT_SWIPE_LEFT;
-            }
-            /*
-            else if (swipeY > lastPressY) {
-                touchEvent = EVENT_SWIPE_DOWN;
-            }
-            else if (swipeY < lastPressY) {
-                touchEvent = EVENT_SWIPE_UP;
-            }
-            */
-            fireEvent();
-            currentState = EVENT_STATE_LINGER;
+        // See if the finger moved far enough for a swipe,
+        // which is only classified when the finger lifts and its speed is known
+        if ((abs(moveX - lastPressX) > gestureConfig.swipeMinPixels) ||
+            (abs(moveY - lastPressY) > gestureConfig.swipeMinPixels)) {
+            touchEvent = swipeDirection();
+            currentState = EVENT_STATE_SWIPE;
         }
         // Check for a long press
-        else if ((touchEvent == EVENT_SHORT) && ((millis() - lastPressTime) > LONGPRESS_DELAY)) {
+        else if ((touchEvent == EVENT_SHORT) && ((sampleTime - lastPressTime) > gestureConfig.longPressDelay)) {
             // New Long press occurred
             touchEvent = EVENT_LONG;
-            fireEvent();
+            fireEvent(lastPressX, lastPressY);
             currentState = EVENT_STATE_LINGER;
         }
         // Check for a short press
-        else if ((touchEvent == EVENT_NONE) && ((millis() - lastPressTime) > SHORTPRESS_DELAY)) {
+        else if ((touchEvent == EVENT_NONE) && ((sampleTime - lastPressTime) > SHORTPRESS_DELAY)) {
             // New Long press occurred
             touchEvent = EVENT_SHORT;
             // Only ending the touch will fire a short press event
         }
         break;
 
+    case EVENT_STATE_LINGER:
+        // Moving after a long press drags what was pressed
+        if ((touchEvent == EVENT_LONG) &&
+            ((abs(moveX - lastPressX) > gestureConfig.dragMinPixels) ||
+             (abs(moveY - lastPressY) > gestureConfig.dragMinPixels))) {
+            touchEvent = EVENT_DRAG;
+            fireEvent(moveX, moveY);
+            dragX = moveX;
+            dragY = moveY;
+            currentState = EVENT_STATE_DRAG;
+        }
+        break;
+
+    case EVENT_STATE_DRAG:
+        // Only report steps of dragMinPixels so a slow dispatcher is not flooded
+        if ((abs(moveX - dragX) > gestureConfig.dragMinPixels) ||
+            (abs(moveY - dragY) > gestureConfig.dragMinPixels)) {
+            fireEvent(moveX, moveY);
+            dragX = moveX;
+            dragY = moveY;
+        }
+        break;
+
     case EVENT_STATE_END:
-        // touch stopped - fire event if short press
+        // touch stopped - fire the event decided by how the touch moved
         if (touchEvent == EVENT_SHORT) {
-            fireEvent();
+            // A second tap soon after the first and near it is a double tap
+            if (lastTapTime && ((pressStartTime - lastTapTime) <= gestureConfig.doubleTapDelay) &&
+                (abs(lastPressX - lastTapX) <= gestureConfig.doubleTapPixels) &&
+                (abs(lastPressY - lastTapY) <= gestureConfig.doubleTapPixels)) {
+                touchEvent = EVENT_DOUBLE;
+                lastTapTime = 0;
+            }
+            else {
+                lastTapTime = lastPressTime;
+                lastTapX = lastPressX;
+                lastTapY = lastPressY;
+            }
+            fireEvent(lastPressX, lastPressY);
+        }
+        else if (isSwipe(touchEvent)) {
+            touchEvent = swipeDirection();
+            // A fast horizontal swipe is a fling, its speed says how far to scroll
+            if ((touchEvent == EVENT_SWIPE_LEFT) && (-velocityX >= gestureConfig.flingMinVelocity)) {
+                touchEvent = EVENT_FLING_LEFT;
+            }
+            else if ((touchEvent == EVENT_SWIPE_RIGHT) && (velocityX >= gestureConfig.flingMinVelocity)) {
+                touchEvent = EVENT_FLING_RIGHT;
+            }
+            fireEvent(lastPressX, lastPressY);
+        }
+        else if (touchEvent == EVENT_DRAG) {
+            touchEvent = EVENT_DRAG_END;
+            fireEvent(moveX, moveY);
         }
         currentState = EVENT_STATE_NONE;
         lastPressX = 0;
@@ -191,7 +521,7 @@ bool TouchHandler::detectEvent(CalibrateTouchCallback _calibrateTouch) {
         break;
 
     case EVENT_STATE_NONE:
-    case EVENT_STATE_LINGER:
+    case EVENT_STATE_SWIPE:
     default:
         break;
   }
@@ -10,12 +10,28 @@
 
 #include <Arduino.h>
 #include <XPT2046_Touchscreen.h>
+#include <Ticker.h>
+#include "TouchFilter.h"
 
 // Define minimum delays for when screen is touched
 #define DEBOUNCE_DELAY 50       // Minimum amount of millis to detect a touch change
 #define SHORTPRESS_DELAY 60     // Minimum amount of millis to detect a short press
 #define LONGPRESS_DELAY 400     // Minimum amount of millis to detect a long press
 #define SWIPE_MIN_PIXELS 40     // Minimum distance in pixels to detect a swipe action
+#define FLING_MIN_VELOCITY 600  // Minimum pixels per second at release for a swipe to be a fling
+#define DOUBLETAP_DELAY 300     // Most millis from releasing a tap to pressing the second tap
+#define DOUBLETAP_PIXELS 20     // Most pixels between the two taps of a double tap
+#define DRAG_MIN_PIXELS 8       // Pixels moved after a long press for each drag event
+#define TOUCH_VELOCITY_SHIFT 1  // Weight of the latest sample in the velocity is 1 / 2^shift
+
+#define TOUCH_NO_IRQ 255        // No PENIRQ pin, the touch controller is polled while idle
+#define TOUCH_NO_PIN 255        // No pin given
+#define TOUCH_QUEUE_SIZE 8      // Events held until they are dispatched, a power of 2
+
+// Define how often the touch controller is sampled
+#define TOUCH_IDLE_INTERVAL 20      // Millis between samples while the screen is not touched
+#define TOUCH_ACTIVE_INTERVAL 5     // Millis between samples during a touch, to follow a swipe
+#define TOUCH_MIN_INTERVAL 3        // Shortest millis between samples, XPT2046_Touchscreen reuses younger readings
 
 
 // Contains all the Events a touch could generate
@@ -24,11 +40,19 @@ enum TouchEvent {
   EVENT_SHORT = 1,        // Short Press Event has occurred
   EVENT_LONG = 2,         // Long Press Event has occurred
   EVENT_SWIPE_RIGHT = 3,  // Finger traveling to Right
-  EVENT_SWIPE_LEFT =4     // Finger travelling to Left
+  EVENT_SWIPE_LEFT =4,    // Finger travelling to Left
+  EVENT_SWIPE_UP = 5,     // Finger travelling Up
+  EVENT_SWIPE_DOWN = 6,   // Finger travelling Down
+  EVENT_FLING_RIGHT = 7,  // Fast swipe to the Right, velocityX says how fast
+  EVENT_FLING_LEFT = 8,   // Fast swipe to the Left, velocityX says how fast
+  EVENT_DOUBLE = 9,       // Second short press soon after a short press in the same place
+  EVENT_DRAG = 10,        // Finger moved after a long press, at the new position
+  EVENT_DRAG_END = 11     // Finger lifted after a drag, at the last position
 };
 
 // Text representation of the Touch Events defined by the TouchEvent enum
-static const char* TouchEventNames[] = {"None", "Short", "Long", "Swipe Right", "Swipe Left"};
+static const char* TouchEventNames[] = {"None", "Short", "Long", "Swipe Right", "Swipe Left",
+  "Swipe Up", "Swipe Down", "Fling Right", "Fling Left", "Double", "Drag", "Drag End"};
 
 // Contains all the possible States of an Event
 enum EventStates {
@@ -36,19 +60,95 @@ enum EventStates {
   EVENT_STATE_START = 1,      // Starting an Event
   EVENT_STATE_INPROGRESS = 2, // In the middle of an Event State
   EVENT_STATE_LINGER =3,      // Conditions are still occuring even after event has fired
-  EVENT_STATE_END = 4         // The Event has been determined and fired
+  EVENT_STATE_END = 4,        // The Event has been determined and fired
+  EVENT_STATE_SWIPE = 5,      // Moved far enough for a swipe, classified at release
+  EVENT_STATE_DRAG = 6        // Moving after a long press
 };
 
 // Text representation of the Touch Events defined by the TouchEvent enum
-static const char* EventStateNames[] = {"None", "Start", "InProgress", "Linger", "End"};
+static const char* EventStateNames[] = {"None", "Start", "InProgress", "Linger", "End", "Swipe", "Drag"};
 
 // Used to pass the touch event to an event handler
 typedef struct Event {
   TouchEvent event;
   int16_t pressX;
   int16_t pressY;
+  int16_t velocityX;      // Pixels per second the finger was moving
+  int16_t velocityY;
+  unsigned long time;     // Millis of the sample the event was detected on
 } Event;
 
+// Thresholds used to recognize the gestures
+struct GestureConfig {
+  uint16_t debounceDelay = DEBOUNCE_DELAY;          // Millis the touch state must hold to change
+  uint16_t swipeMinPixels = SWIPE_MIN_PIXELS;       // Distance moved for a swipe
+  uint16_t flingMinVelocity = FLING_MIN_VELOCITY;   // Pixels per second at release for a fling
+  uint16_t longPressDelay = LONGPRESS_DELAY;        // Millis held still for a long press
+  uint16_t doubleTapDelay = DOUBLETAP_DELAY;        // Millis between the taps of a double tap
+  uint16_t doubleTapPixels = DOUBLETAP_PIXELS;      // Distance between the taps of a double tap
+  uint16_t dragMinPixels = DRAG_MIN_PIXELS;         // Distance moved for each drag event
+};
+
+static_assert((TOUCH_QUEUE_SIZE & (TOUCH_QUEUE_SIZE - 1)) == 0, "Touch queue size must be a power of 2");
+
+//
+// Events waiting to be dispatched.
+// Single producer, the sampler, and single consumer, the dispatcher.
+// Each index is only written by one side so no lock is needed.
+// This relies on both sides running on the one core without preempting
+// each other: the sampler runs from loop() or from the Ticker, which only
+// runs while loop() yields.  Do not push from an interrupt handler, the
+// indexes and counters are not updated atomically.
+//
+class TouchEventQueue {
+
+  public:
+    /*!
+     * @brief Add an event, the event is dropped and counted when the queue is full
+     * @return false if the queue was full
+     */
+    bool push(const Event &event) {
+      uint8_t nextHead = (head + 1) & (TOUCH_QUEUE_SIZE - 1);
+      if (nextHead == tail) {
+        overflows++;
+        return false;
+      }
+      events[head] = event;
+      head = nextHead;
+      uint8_t depth = (head - tail) & (TOUCH_QUEUE_SIZE - 1);
+      if (depth > maxDepth) {
+        maxDepth = depth;
+      }
+      return true;
+    };
+
+    /*!
+     * @brief Take the oldest event
+     * @return false if the queue is empty, event is not changed
+     */
+    bool pop(Event *event) {
+      if (tail == head) {
+        return false;
+      }
+      *event = events[tail];
+      tail = (tail + 1) & (TOUCH_QUEUE_SIZE - 1);
+      return true;
+    };
+
+    /*!
+     * @brief Indicate there are no events waiting
+     */
+    bool isEmpty() {return tail == head;};
+
+    uint32_t overflows = 0;       // Events dropped because the queue was full
+    uint8_t maxDepth = 0;         // Most events waiting at once
+
+  private:
+    Event events[TOUCH_QUEUE_SIZE];
+    volatile uint8_t head = 0;    // Next slot written, only changed by push
+    volatile uint8_t tail = 0;    // Next slot read, only changed by pop
+};
+
 /*!
  * @brief Function to calibrate the touch position to the display position
  * 
@@ -68,21 +168,65 @@ typedef void (*CalibrateTouchCallback)(int16_t*, int16_t*);
  */
 typedef void (*EventHandler)(Event*);
 
+/*!
+ * @brief Function given each raw sample taken during a touch
+ *
+ * @param unsigned long millis the sample was taken
+ * @param TS_Point raw reading, all 0 when not touched
+ * @param bool the screen was touched
+ *
+ * @return none
+ */
+typedef void (*TouchSampleRecorder)(unsigned long, const TS_Point&, bool);
+
 
 class TouchHandler {
 
   public:
-    TouchHandler(XPT2046_Touchscreen *ts);
+    TouchHandler(XPT2046_Touchscreen *ts, uint8_t irqPin = TOUCH_NO_IRQ);
     bool detectEvent(CalibrateTouchCallback _calibrateTouch = nullptr);
     bool start(EventHandler _eventHandler);
+    void dispatchEvents();
+    void setGestureConfig(const GestureConfig &config);
+    void setSampleRecorder(TouchSampleRecorder recorder);
+    void setSharedBusPin(uint8_t csPin);
+    void setSampleIntervals(uint16_t idleInterval, uint16_t activeInterval);
+    void printStats(Print &p);
+
+    /*!
+     * @brief Indicate the pen down interrupt is used instead of polling
+     */
+    bool isIrqDriven() {return _irqPin != TOUCH_NO_IRQ;};
 
   private:
 
-    void fireEvent();
+    void fireEvent(int16_t x, int16_t y);
+    void trackMovement();
+    TouchEvent swipeDirection();
+    bool readTouched();
+    static void IRAM_ATTR penDownIsr();
+    static void backgroundSample(TouchHandler *handler);
 
     XPT2046_Touchscreen *_ts;
+    TouchFilter filter;           // Smooths the positions read during a touch
+    uint8_t _irqPin;              // PENIRQ pin or TOUCH_NO_IRQ
+    uint16_t idleInterval = TOUCH_IDLE_INTERVAL;      // Millis between samples while idle
+    uint16_t activeInterval = TOUCH_ACTIVE_INTERVAL;  // Millis between samples during a touch
+
+    // Set by penDownIsr, there is only one touch controller
+    static volatile bool penDown;             // The pen went down since the last read
+    static volatile uint32_t penDownMicros;   // When the pen went down
 
     EventHandler eventHandler;    // Function that will handle raised events
+    CalibrateTouchCallback calibrateTouch = nullptr;  // Calibration used by detectEvent
+    TouchSampleRecorder sampleRecorder = nullptr;     // Given the raw samples of each touch
+
+    // Events are queued by the sampler and handled by dispatchEvents
+    TouchEventQueue queue;
+    Ticker sampleTicker;          // Keeps sampling while a slow event handler yields
+    uint8_t sharedBusPin = TOUCH_NO_PIN;  // Chip select of the display on the same SPI bus
+    volatile bool dispatching = false;    // dispatchEvents is running
+    unsigned long maxQueueDelay = 0;      // Longest millis an event waited to be handled
 
     Event currentEvent;         // Information about the current event
 
@@ -95,6 +239,35 @@ class TouchHandler {
     int16_t lastPressY = 0;
     unsigned long lastPressTime = 0;  // the last time the screen touch state changed
 
+    // Movement of the current touch, only the latest position is kept
+    GestureConfig gestureConfig;
+    unsigned long pressStartTime = 0; // When the current touch started
+    int16_t moveX = 0;                // Latest position of the finger
+    int16_t moveY = 0;
+    int16_t lastMoveX = 0;            // Position of the finger at the previous sample
+    int16_t lastMoveY = 0;
+    unsigned long moveTime = 0;       // When the finger was at lastMoveX, lastMoveY
+    int32_t velocityX = 0;            // Smoothed pixels per second
+    int32_t velocityY = 0;
+    int16_t dragX = 0;                // Position of the last drag event
+    int16_t dragY = 0;
+    unsigned long lastTapTime = 0;    // When the last short press was released, 0 after a double tap
+    int16_t lastTapX = 0;             // Position of the last short press
+    int16_t lastTapY = 0;
+    unsigned long sampleTime = 0;     // When the current sample was taken, used for all the delays
+    unsigned long nextSampleTime = 0; // When the next sample is due
+
+    // Cost and latency of detecting a touch
+    uint32_t idleReads = 0;           // Controller reads while the screen was not touched
+    uint32_t sampleCount = 0;         // Samples taken
+    uint32_t touchDowns = 0;          // Touches detected
+    uint32_t latencyTotal = 0;        // Sum of the microseconds from pen down to detection
+    uint32_t latencyMax = 0;          // Longest microseconds from pen down to detection
+    uint32_t lastReadMicros = 0;      // Last time the controller was read
+    unsigned long statsStart = 0;     // When the counts were last cleared
+    uint32_t filterCycles = 0;        // CPU cycles spent filtering, with TOUCH_FILTER_BENCHMARK
+    uint32_t filterCount = 0;         // Samples filtered, with TOUCH_FILTER_BENCHMARK
+
 };
 
 #endif
\ No newline at end of file
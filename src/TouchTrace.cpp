@@ -0,0 +1,202 @@
+/*
+ * TouchTrace
+ *
+ * Records the raw touch samples to LittleFS for replay on a host.
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <ESP8266WebServer.h>
+#include "TouchTrace.h"
+#include "menuUpload.h"
+
+static TouchTraceSample traceBuffer[TOUCHTRACE_BUFFER_SAMPLES];  // Samples not yet written
+static uint8_t traceCount = 0;              // Samples in traceBuffer
+static uint32_t traceDropped = 0;           // Samples lost because traceBuffer was full
+static bool traceRecording = false;         // The trace file exists and has room
+static bool traceStarting = true;           // The next sample starts a new run of times
+static const TouchMatrix *traceMatrix = nullptr;  // Calibration written to a new trace
+static int16_t traceWidth = 0;
+static int16_t traceHeight = 0;
+static const char *tracePassword = nullptr; // Password for MENUUPLOAD_USER
+
+
+/*********************
+ * Trace functions
+ *********************/
+
+//
+// Append the buffered samples to the trace file.
+// Recording stops when the file is full or can not be written.
+//
+static void traceFlush() {
+  if (traceCount == 0) {
+    return;
+  }
+  File file = LittleFS.open(TOUCHTRACE_PATH, "a");
+  size_t length = traceCount * sizeof(TouchTraceSample);
+  if (!file || file.write((const uint8_t*) traceBuffer, length) != length) {
+    Serial.println("Touch trace not written, recording stopped");
+    traceRecording = false;
+  }
+  else if (file.size() >= TOUCHTRACE_MAX_SIZE) {
+    Serial.println("Touch trace full, recording stopped");
+    traceRecording = false;
+  }
+  file.close();
+
+  if (traceDropped) {
+    Serial.print("Touch trace dropped samples: ");
+    Serial.println(traceDropped);
+    traceDropped = 0;
+  }
+  traceCount = 0;
+}
+
+
+//
+// Replace the trace file with an empty trace and start recording
+//
+// @return false if the file could not be written
+//
+static bool traceStart() {
+  TouchTraceHeader header = {};
+  header.magic = TOUCHTRACE_MAGIC;
+  header.version = TOUCHTRACE_VERSION;
+  header.sampleSize = sizeof(TouchTraceSample);
+  header.width = traceWidth;
+  header.height = traceHeight;
+  header.matrix = *traceMatrix;
+
+  File file = LittleFS.open(TOUCHTRACE_PATH, "w");
+  if (!file || file.write((const uint8_t*) &header, sizeof(header)) != sizeof(header)) {
+    Serial.println("Unable to start touch trace");
+    traceRecording = false;
+    return false;
+  }
+  file.close();
+  traceCount = 0;
+  traceDropped = 0;
+  traceStarting = true;
+  traceRecording = true;
+  return true;
+}
+
+
+/*****************************
+ * Touch Trace callbacks
+ *****************************/
+
+//
+// Start a new trace, download the trace or stop and remove it
+//
+static void traceRequest() {
+  ESP8266WebServer *server = menuUploadServer();
+  if (!server->authenticate(MENUUPLOAD_USER, tracePassword)) {
+    server->requestAuthentication();
+    return;
+  }
+
+  switch (server->method()) {
+    case HTTP_POST:
+      if (traceStart()) {
+        server->send(200, "text/plain", "Touch trace started\n");
+      }
+      else {
+        server->send(500, "text/plain", "Touch trace not started\n");
+      }
+      break;
+
+    case HTTP_DELETE:
+      traceRecording = false;
+      traceCount = 0;
+      LittleFS.remove(TOUCHTRACE_PATH);
+      server->send(200, "text/plain", "Touch trace removed\n");
+      break;
+
+    default: {
+      traceFlush();
+      File file = LittleFS.open(TOUCHTRACE_PATH, "r");
+      if (!file) {
+        server->send(404, "text/plain", "No touch trace\n");
+        break;
+      }
+      server->streamFile(file, "application/octet-stream");
+      file.close();
+      break;
+    }
+  }
+}
+
+
+/*********************
+ * Non Class Functions
+ *********************/
+
+//
+// Carry on recording if a trace was being recorded before the reboot
+// and let the trace be controlled on the web server.
+// Call after LittleFS is started and before the web server is started.
+//
+// @param matrix   Calibration written to new traces
+// @param width    Screen width the matrix maps to
+// @param height   Screen height the matrix maps to
+// @param password Password for MENUUPLOAD_USER
+//
+void touchTraceSetup(const TouchMatrix *matrix, int16_t width, int16_t height, const char *password) {
+  traceMatrix = matrix;
+  traceWidth = width;
+  traceHeight = height;
+  tracePassword = password;
+
+  File file = LittleFS.open(TOUCHTRACE_PATH, "r");
+  if (file) {
+    TouchTraceHeader header;
+    bool valid = file.read((uint8_t*) &header, sizeof(header)) == sizeof(header)
+      && header.magic == TOUCHTRACE_MAGIC && header.version == TOUCHTRACE_VERSION
+      && header.sampleSize == sizeof(TouchTraceSample);
+    traceRecording = valid && file.size() < TOUCHTRACE_MAX_SIZE;
+    file.close();
+    traceStarting = true;
+    if (traceRecording) {
+      Serial.println("Touch trace recording");
+    }
+  }
+
+  ESP8266WebServer *server = menuUploadServer();
+  server->on(TOUCHTRACE_URI, HTTP_ANY, &traceRequest);
+}
+
+
+//
+// TouchSampleRecorder for the TouchHandler.
+// Only copies the sample so the touch is not slowed down.
+//
+void touchTraceRecord(unsigned long time, const TS_Point &point, bool touched) {
+  if (!traceRecording) {
+    return;
+  }
+  if (traceCount >= TOUCHTRACE_BUFFER_SAMPLES) {
+    traceDropped++;
+    return;
+  }
+  TouchTraceSample &sample = traceBuffer[traceCount++];
+  sample.time = time;
+  sample.x = point.x;
+  sample.y = point.y;
+  sample.z = point.z;
+  sample.flags = (touched ? TOUCHTRACE_TOUCHED : 0) | (traceStarting ? TOUCHTRACE_START : 0);
+  sample.reserved = 0;
+  traceStarting = false;
+}
+
+
+//
+// Write the buffered samples between touches,
+// or during a touch when the buffer is nearly full
+//
+void touchTraceHandle(bool idle) {
+  if (traceRecording && (idle || traceCount >= TOUCHTRACE_BUFFER_SAMPLES * 3 / 4)) {
+    traceFlush();
+  }
+}
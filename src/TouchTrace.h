@@ -0,0 +1,79 @@
+/*
+ * @file TouchTrace.h
+ *
+ * Records what the touch controller reports during each touch, so the
+ * TouchHandler delays and thresholds can be tuned against real touches
+ * with tools/touchreplay.
+ *
+ * Each raw sample of a touch is copied into a RAM buffer, which is
+ * appended to TOUCHTRACE_PATH on LittleFS between touches.  Recording
+ * runs while the trace file exists, across reboots, until the file
+ * reaches TOUCHTRACE_MAX_SIZE.  It is controlled on the web server:
+ *
+ *   curl -u admin:<password> -X POST http://deskButtonPanel.local/trace        start a new trace
+ *   curl -u admin:<password> -o touch.trc http://deskButtonPanel.local/trace   download the trace
+ *   curl -u admin:<password> -X DELETE http://deskButtonPanel.local/trace      stop and remove it
+ *
+ * The file is a TouchTraceHeader followed by TouchTraceSamples.
+ * The header holds the calibration used when the trace was started,
+ * so start a new trace after calibrating the touch screen.
+ */
+#pragma once
+
+#ifndef __TOUCHTRACE_H
+#define __TOUCHTRACE_H
+
+#include <Arduino.h>
+#include <XPT2046_Touchscreen.h>
+#include "TouchCalibration.h"
+
+#define TOUCHTRACE_PATH "/touch.trc"          // Trace kept on LittleFS
+#define TOUCHTRACE_URI "/trace"               // Web path to start, download and remove the trace
+#define TOUCHTRACE_MAGIC 0x43525454           // "TTRC"
+#define TOUCHTRACE_VERSION 1                  // Change when the header or samples change
+#define TOUCHTRACE_BUFFER_SAMPLES 64          // Samples held in RAM, a touch of about a third of a second
+#define TOUCHTRACE_MAX_SIZE 131072            // Recording stops when the trace reaches this size
+
+#define TOUCHTRACE_TOUCHED 0x01               // Sample flag, the screen was touched
+#define TOUCHTRACE_START 0x02                 // Sample flag, first sample after recording started or the panel booted
+
+
+//
+// Trace file header
+//
+struct TouchTraceHeader {
+  uint32_t magic;         // TOUCHTRACE_MAGIC
+  uint16_t version;       // TOUCHTRACE_VERSION
+  uint16_t sampleSize;    // sizeof(TouchTraceSample)
+  int16_t width;          // Screen width the matrix maps to
+  int16_t height;         // Screen height the matrix maps to
+  TouchMatrix matrix;     // Calibration when the trace was started
+};
+
+
+//
+// One raw sample.
+// Times are millis since the panel started, so they go back to 0
+// after a reboot.  A sample flagged TOUCHTRACE_START begins a new run.
+//
+struct TouchTraceSample {
+  uint32_t time;          // Millis the sample was taken
+  int16_t x;              // Raw reading, 0 when not touched
+  int16_t y;
+  int16_t z;              // Pressure
+  uint8_t flags;          // TOUCHTRACE_TOUCHED and TOUCHTRACE_START
+  uint8_t reserved;
+};
+
+static_assert(sizeof(TouchTraceSample) == 12, "Touch trace samples must match tools/touchreplay");
+
+
+//
+// Functions
+//
+
+void touchTraceSetup(const TouchMatrix *matrix, int16_t width, int16_t height, const char *password);
+void touchTraceRecord(unsigned long time, const TS_Point &point, bool touched);
+void touchTraceHandle(bool idle);
+
+#endif
@@ -0,0 +1,364 @@
+/*
+ * UsageLog
+ *
+ * Log of how the button panel is used, for capacity planning.
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <ESP8266HTTPClient.h>  // For HTTP_CODE_OK
+#include "UsageLog.h"
+#include "RequestArena.h"
+#include "Crc32.h"
+
+static const char usageSegmentName[] PROGMEM = "segment";
+static const char usageBootName[] PROGMEM = "boot";
+static const char usageShortName[] PROGMEM = "short";
+static const char usageLongName[] PROGMEM = "long";
+static const char usageSwipeName[] PROGMEM = "swipe";
+static const char usageCommandName[] PROGMEM = "command";
+
+static const char* const usageKindNames[USAGE_KIND_COUNT] PROGMEM = {
+  usageSegmentName,
+  usageBootName,
+  usageShortName,
+  usageLongName,
+  usageSwipeName,
+  usageCommandName
+};
+
+static UsageRecord usageBuffer[USAGELOG_BUFFER_RECORDS];  // Records not written to flash yet
+static uint8_t usageHead = 0;           // Index of the oldest record in usageBuffer
+static uint8_t usageCount = 0;          // Number of records in usageBuffer
+static uint32_t usageDropped = 0;       // Records lost since the last compaction
+static uint8_t usageSegment = USAGELOG_SEGMENTS - 1;  // Segment being appended to
+static uint32_t usageSequence = 0;      // Sequence number of the segment being appended to
+static uint32_t usageFlushTime = 0;     // Last time records were written to flash
+
+
+/*********************
+ * Rollup functions
+ *********************/
+
+//
+// CRC-32 of the rollup after its crc field
+//
+static uint32_t usageRollupCrc(const UsageRollupHeader &header, const UsageRollupEntry *entries) {
+  const uint8_t *headerRest = (const uint8_t*) &header + offsetof(UsageRollupHeader, entryCount);
+  uint32_t crc = checksumCrc32(headerRest, sizeof(UsageRollupHeader) - offsetof(UsageRollupHeader, entryCount));
+  return checksumCrc32(entries, header.entryCount * sizeof(UsageRollupEntry), crc);
+}
+
+
+//
+// Read the rollup into entries, which has room for USAGELOG_ROLLUP_ENTRIES.
+// A missing or damaged rollup starts again from empty.
+//
+static void usageRollupRead(UsageRollupHeader *header, UsageRollupEntry *entries) {
+  File file = LittleFS.open(USAGELOG_ROLLUP_PATH, "r");
+  bool read = file && file.read((uint8_t*) header, sizeof(UsageRollupHeader)) == sizeof(UsageRollupHeader)
+              && header->magic == USAGELOG_ROLLUP_MAGIC && header->entryCount <= USAGELOG_ROLLUP_ENTRIES
+              && file.read((uint8_t*) entries, header->entryCount * sizeof(UsageRollupEntry)) == header->entryCount * sizeof(UsageRollupEntry)
+              && header->crc == usageRollupCrc(*header, entries);
+  if (file) {
+    file.close();
+  }
+
+  if (!read) {
+    if (LittleFS.exists(USAGELOG_ROLLUP_PATH)) {
+      Serial.println("Usage rollup damaged, starting a new one");
+    }
+    memset(header, 0, sizeof(UsageRollupHeader));
+    header->magic = USAGELOG_ROLLUP_MAGIC;
+  }
+}
+
+
+//
+// Write the rollup to a temporary file and swap it in,
+// so a reset part way through keeps the old rollup
+//
+static void usageRollupWrite(UsageRollupHeader *header, const UsageRollupEntry *entries) {
+  static const char tempPath[] = USAGELOG_ROLLUP_PATH ".tmp";
+  size_t entryBytes = header->entryCount * sizeof(UsageRollupEntry);
+  header->crc = usageRollupCrc(*header, entries);
+
+  File file = LittleFS.open(tempPath, "w");
+  bool written = file && file.write((const uint8_t*) header, sizeof(UsageRollupHeader)) == sizeof(UsageRollupHeader)
+                 && file.write((const uint8_t*) entries, entryBytes) == entryBytes;
+  if (file) {
+    file.close();
+  }
+
+  if (!written) {
+    Serial.println("Usage rollup not written");
+    LittleFS.remove(tempPath);
+    return;
+  }
+  // Rename replaces the old rollup in one step
+  if (!LittleFS.rename(tempPath, USAGELOG_ROLLUP_PATH)) {
+    Serial.println("Usage rollup not replaced");
+    LittleFS.remove(tempPath);
+  }
+}
+
+
+//
+// Add a record to the totals of its button, page or device
+//
+static void usageRollupAdd(UsageRollupHeader *header, UsageRollupEntry *entries, const UsageRecord &record) {
+  if (record.kind == USAGE_SEGMENT || record.kind >= USAGE_KIND_COUNT) {
+    return;
+  }
+
+  UsageRollupEntry *entry = nullptr;
+  for (uint16_t entryIndex = 0; entryIndex < header->entryCount; entryIndex++) {
+    if (entries[entryIndex].kind == record.kind && entries[entryIndex].page == record.page && entries[entryIndex].button == record.button) {
+      entry = &entries[entryIndex];
+      break;
+    }
+  }
+  if (!entry) {
+    if (header->entryCount >= USAGELOG_ROLLUP_ENTRIES) {
+      header->dropped++;
+      return;
+    }
+    entry = &entries[header->entryCount++];
+    memset(entry, 0, sizeof(UsageRollupEntry));
+    entry->kind = record.kind;
+    entry->page = record.page;
+    entry->button = record.button;
+  }
+
+  entry->count++;
+  entry->totalTime += record.value;
+  if (record.kind == USAGE_COMMAND && record.code != HTTP_CODE_OK) {
+    entry->failures++;
+  }
+}
+
+
+//
+// Fold a segment into the rollup before it is reused.
+// The rollup is only held in the request arena while it is updated.
+//
+static void usageLogCompact(const char *segmentPath) {
+  RequestArenaScope arenaScope;
+  UsageRollupEntry *entries = (UsageRollupEntry*) requestArena.allocate(USAGELOG_ROLLUP_ENTRIES * sizeof(UsageRollupEntry));
+  if (!entries) {
+    Serial.println("No room in the request arena to compact the usage log");
+    return;
+  }
+
+  UsageRollupHeader header;
+  usageRollupRead(&header, entries);
+
+  File segment = LittleFS.open(segmentPath, "r");
+  UsageRecord record;
+  while (segment && segment.read((uint8_t*) &record, sizeof(UsageRecord)) == sizeof(UsageRecord)) {
+    usageRollupAdd(&header, entries, record);
+  }
+  if (segment) {
+    segment.close();
+  }
+
+  header.segments++;
+  header.dropped += usageDropped;
+  usageDropped = 0;
+  usageRollupWrite(&header, entries);
+}
+
+
+/*********************
+ * Segment functions
+ *********************/
+
+//
+// Name of a segment file
+//
+static void usageSegmentPath(char *path, size_t pathSize, uint8_t segment) {
+  snprintf(path, pathSize, USAGELOG_SEGMENT_PATH, segment);
+}
+
+
+//
+// Open the segment to append bytes to.
+// Moves to the next segment in the ring when the current one is full,
+// compacting the old records it held.
+//
+static File usageSegmentOpen(size_t bytes) {
+  char path[16];
+  usageSegmentPath(path, sizeof(path), usageSegment);
+  if (LittleFS.exists(path)) {
+    File file = LittleFS.open(path, "a");
+    if (file && file.size() + bytes <= USAGELOG_SEGMENT_SIZE) {
+      return file;
+    }
+  }
+
+  usageSegment = (usageSegment + 1) % USAGELOG_SEGMENTS;
+  usageSegmentPath(path, sizeof(path), usageSegment);
+  if (LittleFS.exists(path)) {
+    usageLogCompact(path);
+  }
+
+  File file = LittleFS.open(path, "w");
+  if (file) {
+    UsageRecord header = {(uint32_t) millis(), ++usageSequence, 0, USAGE_SEGMENT, USAGELOG_NONE, USAGELOG_NONE, {0, 0, 0}};
+    file.write((const uint8_t*) &header, sizeof(UsageRecord));
+  }
+  return file;
+}
+
+
+//
+// Write the oldest batch of records in RAM to the log, at most up to the end of a flash page.
+// The records stay in RAM to try again later if the log can not be written.
+//
+static void usageLogWriteBatch() {
+  uint8_t batch = min((uint8_t) USAGELOG_BATCH_RECORDS, usageCount);
+  usageFlushTime = millis();
+
+  File file = usageSegmentOpen(batch * sizeof(UsageRecord));
+  if (!file) {
+    Serial.println("Usage log not written");
+    return;
+  }
+
+  // Only fill up to the end of the flash page so later batches start on a page
+  uint8_t pageRoom = (USAGELOG_PAGE_SIZE - file.size() % USAGELOG_PAGE_SIZE) / sizeof(UsageRecord);
+  batch = min(batch, pageRoom);
+
+  // The batch may wrap around the end of the buffer
+  uint8_t firstPart = min(batch, (uint8_t) (USAGELOG_BUFFER_RECORDS - usageHead));
+  file.write((const uint8_t*) &usageBuffer[usageHead], firstPart * sizeof(UsageRecord));
+  if (batch > firstPart) {
+    file.write((const uint8_t*) usageBuffer, (batch - firstPart) * sizeof(UsageRecord));
+  }
+  file.close();
+
+  usageHead = (usageHead + batch) % USAGELOG_BUFFER_RECORDS;
+  usageCount -= batch;
+}
+
+
+/*********************
+ * Non Class Functions
+ *********************/
+
+//
+// Find the segment written last before the reboot and record the boot.
+// LittleFS must already be started.
+//
+void usageLogSetup() {
+  char path[16];
+  for (uint8_t segment = 0; segment < USAGELOG_SEGMENTS; segment++) {
+    usageSegmentPath(path, sizeof(path), segment);
+    File file = LittleFS.open(path, "r");
+    UsageRecord header;
+    if (file && file.read((uint8_t*) &header, sizeof(UsageRecord)) == sizeof(UsageRecord)
+        && header.kind == USAGE_SEGMENT && header.value > usageSequence) {
+      usageSequence = header.value;
+      usageSegment = segment;
+    }
+    if (file) {
+      file.close();
+    }
+  }
+
+  usageFlushTime = millis();
+  usageLogRecord(USAGE_BOOT, USAGELOG_NONE, USAGELOG_NONE, 0);
+}
+
+
+//
+// Record an event.
+// Only copies the record into RAM so it can be called on the touch path.
+// The record is dropped and counted if the buffer is full.
+//
+void usageLogRecord(UsageKind kind, uint8_t page, uint8_t button, uint32_t value, int16_t code) {
+  if (usageCount >= USAGELOG_BUFFER_RECORDS) {
+    usageDropped++;
+    return;
+  }
+
+  UsageRecord &record = usageBuffer[(usageHead + usageCount) % USAGELOG_BUFFER_RECORDS];
+  record = {(uint32_t) millis(), value, code, kind, page, button, {0, 0, 0}};
+  usageCount++;
+}
+
+
+//
+// Record a command sent to a device
+//
+// @param target  Device the command was sent to
+// @param code    HTTP code returned, negative for a connection error
+// @param elapsed Milliseconds the command took
+//
+void usageLogCommand(UsageTarget target, int16_t code, uint32_t elapsed) {
+  usageLogRecord(USAGE_COMMAND, target, USAGELOG_NONE, elapsed, code);
+}
+
+
+//
+// Write records to the log.
+// A full flash page is written when the panel is idle, whatever is in RAM is written
+// once USAGELOG_FLUSH_INTERVAL has passed, and a full buffer is written right away.
+//
+// @param idle true when nothing is being touched
+//
+void usageLogHandle(bool idle) {
+  if (usageCount == 0) {
+    return;
+  }
+
+  bool batchReady = idle && usageCount >= USAGELOG_BATCH_RECORDS;
+  bool flushDue = (millis() - usageFlushTime) >= USAGELOG_FLUSH_INTERVAL;
+  if (batchReady || flushDue || usageCount >= USAGELOG_BUFFER_RECORDS) {
+    usageLogWriteBatch();
+  }
+}
+
+
+//
+// Print the rollup and the state of the log
+//
+void usageLogPrint(Print &p) {
+  RequestArenaScope arenaScope;
+  UsageRollupEntry *entries = (UsageRollupEntry*) requestArena.allocate(USAGELOG_ROLLUP_ENTRIES * sizeof(UsageRollupEntry));
+  if (!entries) {
+    p.println(F("No room in the request arena to read the usage rollup"));
+    return;
+  }
+
+  UsageRollupHeader header;
+  usageRollupRead(&header, entries);
+
+  p.print(F("Usage log segment "));
+  p.print(usageSegment);
+  p.print(F(" sequence "));
+  p.print(usageSequence);
+  p.print(F(" in RAM "));
+  p.print(usageCount);
+  p.print(F(" dropped "));
+  p.println(header.dropped + usageDropped);
+
+  p.print(F("Rollup of "));
+  p.print(header.segments);
+  p.println(F(" segments"));
+  p.println(F("Kind\tpage\tbutton\tcount\tfailed\tavg ms"));
+  for (uint16_t entryIndex = 0; entryIndex < header.entryCount; entryIndex++) {
+    const UsageRollupEntry &entry = entries[entryIndex];
+    p.print(reinterpret_cast<const __FlashStringHelper*>(pgm_read_ptr(&usageKindNames[entry.kind])));
+    p.print('\t');
+    p.print(entry.page);
+    p.print('\t');
+    p.print(entry.button);
+    p.print('\t');
+    p.print(entry.count);
+    p.print('\t');
+    p.print(entry.failures);
+    p.print('\t');
+    p.println(entry.count ? entry.totalTime / entry.count : 0);
+  }
+}
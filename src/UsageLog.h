@@ -0,0 +1,117 @@
+/*
+ * @file UsageLog.h
+ *
+ * Log of how the button panel is used, for capacity planning.
+ *
+ * Every touch event the Menu handles and every command sent to a
+ * device is recorded as a small fixed size record.  Recording only
+ * copies the record into a RAM buffer so it costs next to nothing on
+ * the touch path.  The buffer is appended to LittleFS one flash page
+ * at a time, when the panel is idle or when USAGELOG_FLUSH_INTERVAL
+ * has passed, so the flash is not written on every press.
+ *
+ * The log is a ring of USAGELOG_SEGMENTS files of up to
+ * USAGELOG_SEGMENT_SIZE bytes.  When the ring wraps, the oldest segment
+ * is compacted into a rollup of counts, failures and total latency for
+ * each button, page and device before it is reused, so nothing is lost
+ * but the time of each event.
+ */
+#pragma once
+
+#ifndef __USAGELOG_H
+#define __USAGELOG_H
+
+#include <Arduino.h>
+
+#define USAGELOG_PAGE_SIZE 256                // Bytes written to flash at once, the LittleFS page size
+#define USAGELOG_BUFFER_RECORDS 32            // Records held in RAM, two flash pages
+#define USAGELOG_BATCH_RECORDS (USAGELOG_PAGE_SIZE / sizeof(UsageRecord))  // Records written to flash at once
+#define USAGELOG_SEGMENTS 4                   // Segment files in the ring
+#define USAGELOG_SEGMENT_SIZE 8192            // Largest segment file, one ESP8266 LittleFS block
+#define USAGELOG_SEGMENT_PATH "/usage%u.log"  // Name of each segment file
+#define USAGELOG_ROLLUP_PATH "/usage.sum"     // Rollup of the compacted segments
+#define USAGELOG_ROLLUP_ENTRIES 48            // Buttons, pages and devices counted in the rollup
+#define USAGELOG_ROLLUP_MAGIC 0x4D555355      // "USUM"
+#define USAGELOG_FLUSH_INTERVAL 300000        // Longest time in ms records are kept only in RAM
+#define USAGELOG_NONE 0xFF                    // Page or button of a record that has none
+
+
+//
+// What a record is about
+//
+enum UsageKind : uint8_t {
+  USAGE_SEGMENT = 0,    // First record of a segment, value is the segment sequence number
+  USAGE_BOOT,           // The panel started
+  USAGE_SHORT,          // Short press of a page or button, value is the time to handle it
+  USAGE_LONG,           // Long press of a page or button, value is the time to handle it
+  USAGE_SWIPE,          // Swipe across the top of the menu, value is the time to handle it
+  USAGE_COMMAND,        // Command sent to a device, value is the time it took and code the HTTP code
+  USAGE_KIND_COUNT
+};
+
+
+//
+// Devices commands are sent to
+//
+enum UsageTarget : uint8_t {
+  USAGE_TARGET_SIGN = 0,  // On Air sign
+  USAGE_TARGET_HEAD,      // Robot Head
+  USAGE_TARGET_COUNT
+};
+
+
+//
+// One entry in the log.
+// USAGELOG_PAGE_SIZE is a whole number of records.
+//
+struct UsageRecord {
+  uint32_t time;        // Milliseconds since the panel started
+  uint32_t value;       // Milliseconds taken, or the sequence number of a segment
+  int16_t code;         // HTTP code of a command, negative for a connection error
+  uint8_t kind;         // UsageKind
+  uint8_t page;         // Page index, UsageTarget of a command or USAGELOG_NONE
+  uint8_t button;       // Button index in the page or USAGELOG_NONE
+  uint8_t reserved[3];
+};
+
+static_assert(USAGELOG_PAGE_SIZE % sizeof(UsageRecord) == 0, "Flash page is not a whole number of usage records");
+static_assert(USAGELOG_SEGMENT_SIZE % USAGELOG_PAGE_SIZE == 0, "Segment is not a whole number of flash pages");
+
+
+//
+// Totals for one button, page or device in the rollup
+//
+struct UsageRollupEntry {
+  uint8_t kind;           // UsageKind
+  uint8_t page;           // Page index or UsageTarget
+  uint8_t button;         // Button index or USAGELOG_NONE
+  uint8_t reserved;
+  uint32_t count;         // Number of records
+  uint32_t failures;      // Commands that did not return HTTP 200
+  uint32_t totalTime;     // Sum of the milliseconds taken
+};
+
+
+//
+// Rollup file header, followed by the entries
+//
+struct UsageRollupHeader {
+  uint32_t magic;         // USAGELOG_ROLLUP_MAGIC
+  uint32_t crc;           // CRC-32 of the rest of the header and the entries
+  uint16_t entryCount;    // Entries that follow
+  uint16_t segments;      // Segments compacted into the rollup
+  uint32_t dropped;       // Records lost because the RAM buffer was full
+};
+
+
+//
+// Functions
+//
+
+void usageLogSetup();
+void usageLogRecord(UsageKind kind, uint8_t page, uint8_t button, uint32_t value, int16_t code = 0);
+void usageLogCommand(UsageTarget target, int16_t code, uint32_t elapsed);
+void usageLogHandle(bool idle);
+void usageLogPrint(Print &p);
+
+#endif
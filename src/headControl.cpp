@@ -11,40 +11,20 @@
 #include <Adafruit_ILI9341.h>
 //#include "Menu.h"
 #include "headControl.h"
+#include "HeapStats.h"
+#include "RequestArena.h"
+#include "MenuImage.h"
+#include "snapshot.h"
+#include "UsageLog.h"
 
-bool headControlShortButtonPress0 () {
-  headControlShortButtonPress(0);
-  return true;
-}
-bool headControlShortButtonPress1 () {
-  headControlShortButtonPress(1);
-  return true;
-}
-bool headControlShortButtonPress2 () {
-  headControlShortButtonPress(2);
-  return true;
-}
-bool headControlShortButtonPress3 () {
-  headControlShortButtonPress(3);
-  return true;
-}
-bool headControlShortButtonPress4 () {
-  headControlShortButtonPress(4);
-  return true;
-}
-bool headControlShortButtonPress5 () {
-  headControlShortButtonPress(5);
-  return true;
-}
-
-MenuButton face0Button = MenuButton("Face0", 0, 0, DEFAULT_BUTTON_COLOR, &headControlShortButtonPress0);
-MenuButton face1Button = MenuButton("Face1", 1, 0, DEFAULT_BUTTON_COLOR, &headControlShortButtonPress1);
-MenuButton face2Button = MenuButton("Face2", 2, 0, DEFAULT_BUTTON_COLOR, &headControlShortButtonPress2);
-MenuButton face3Button = MenuButton("Face3", 0, 1, DEFAULT_BUTTON_COLOR, &headControlShortButtonPress3);
-MenuButton face4Button = MenuButton("Face4", 1, 1, DEFAULT_BUTTON_COLOR, &headControlShortButtonPress4);
-MenuButton face5Button = MenuButton("Face5", 2, 1, DEFAULT_BUTTON_COLOR, &headControlShortButtonPress5);
-vector<MenuButton*> headButtonList = {&face0Button, &face1Button, &face2Button, &face3Button, &face4Button, &face5Button};
-MenuPage headTopMenu = MenuPage("Head", 3, 2, &headButtonList, BUTTONPANEL_HEADCONTROL_COLOR, &headControlShortPagePress);
+// Labels are kept in flash until the head reports its face names
+static const char face0Label[] PROGMEM = "Face0";
+static const char face1Label[] PROGMEM = "Face1";
+static const char face2Label[] PROGMEM = "Face2";
+static const char face3Label[] PROGMEM = "Face3";
+static const char face4Label[] PROGMEM = "Face4";
+static const char face5Label[] PROGMEM = "Face5";
+static const char headLabel[] PROGMEM = "Head";
 
 
 //
@@ -54,26 +34,82 @@ String headPath = "/face";        // Path to Service
 String headName = "headcontrol";  // Must match devicename above
 int faceSelected = 0;             // Face selected
 
-// The following will be overwritten when the mDNS query is performed
-String   headHost = headName + ".local";  // Default Host
-String   headIP = headHost;               // Default to sign hostname
-uint16_t headPort = 80;                   // Default Port
+//
+// Where the Head is on the network.
+// Bound to the face buttons so their callback sends to this head.
+// Overwritten when the mDNS query is performed.
+//
+struct HeadDevice {
+  String host;        // Host name
+  String ip;          // Address, the host name until mDNS finds the head
+  uint16_t port;      // Port of the head's web service
+};
+
+HeadDevice headDevice = {headName + ".local", headName + ".local", 80};
+
+static constexpr MenuButtonDef face0ButtonDef PROGMEM = {{face0Label, DEFAULT_BUTTON_COLOR, ButtonPressCallback(&headControlShortButtonPress, &headDevice, 0), nullptr}, 0, 0};
+static constexpr MenuButtonDef face1ButtonDef PROGMEM = {{face1Label, DEFAULT_BUTTON_COLOR, ButtonPressCallback(&headControlShortButtonPress, &headDevice, 1), nullptr}, 1, 0};
+static constexpr MenuButtonDef face2ButtonDef PROGMEM = {{face2Label, DEFAULT_BUTTON_COLOR, ButtonPressCallback(&headControlShortButtonPress, &headDevice, 2), nullptr}, 2, 0};
+static constexpr MenuButtonDef face3ButtonDef PROGMEM = {{face3Label, DEFAULT_BUTTON_COLOR, ButtonPressCallback(&headControlShortButtonPress, &headDevice, 3), nullptr}, 0, 1};
+static constexpr MenuButtonDef face4ButtonDef PROGMEM = {{face4Label, DEFAULT_BUTTON_COLOR, ButtonPressCallback(&headControlShortButtonPress, &headDevice, 4), nullptr}, 1, 1};
+static constexpr MenuButtonDef face5ButtonDef PROGMEM = {{face5Label, DEFAULT_BUTTON_COLOR, ButtonPressCallback(&headControlShortButtonPress, &headDevice, 5), nullptr}, 2, 1};
+static constexpr MenuPageDef headPageDef PROGMEM = {{headLabel, BUTTONPANEL_HEADCONTROL_COLOR, &headControlShortPagePress, nullptr}, nullptr, &headControlEnterPage, &headControlLeavePage, HEADCONTROL_PAGE_HEAP_BUDGET};
+
+MenuButton face0Button = MenuButton(&face0ButtonDef);
+MenuButton face1Button = MenuButton(&face1ButtonDef);
+MenuButton face2Button = MenuButton(&face2ButtonDef);
+MenuButton face3Button = MenuButton(&face3ButtonDef);
+MenuButton face4Button = MenuButton(&face4ButtonDef);
+MenuButton face5Button = MenuButton(&face5ButtonDef);
+HeadPage headTopMenu = HeadPage(&headPageDef, {&face0Button, &face1Button, &face2Button, &face3Button, &face4Button, &face5Button});
+
 
 /*
  * Add a face to the page
  */
-void addFace (unsigned int faceNum, String faceName, bool faceSelected) {
-  MenuButton *faceButton = headButtonList.at(faceNum);
+void addFace (unsigned int faceNum, const char *faceName, bool faceSelected) {
+  MenuButton *faceButton = headTopMenu.getButton(faceNum);
+  if (!faceButton) {
+    Serial.print("No button for face ");
+    Serial.println(faceNum);
+    return;
+  }
+  if (!faceName) {
+    faceName = "";
+  }
   faceButton->setName(faceName);
+  faceButton->setDisabled(false);
   if (faceSelected) {
     faceButton->setActive();
     faceButton->setColor(HEADCONTROL_SELECTED_COLOR);
-    faceButton->setTextColor(HEADCONTROL_SELECTED_TEXTCOLOR);
   }
   else {
     faceButton->setInactive();
     faceButton->setColor(DEFAULT_BUTTON_COLOR);
-    faceButton->setTextColor(DEFAULT_BUTTON_TEXT_COLOR);
+  }
+
+  // The head has confirmed the face, remember it for the next reboot
+  faceButton->setStale(false);
+  snapshotSetFace(faceNum, faceName, faceSelected);
+}
+
+
+/*
+ * Show the faces from before the reboot until the head reports them
+ */
+void restoreFaces () {
+  const DeviceSnapshot &snapshot = snapshotGet();
+  for (unsigned int faceNum = 0; faceNum < SNAPSHOT_FACES; faceNum++) {
+    MenuButton *faceButton = headTopMenu.getButton(faceNum);
+    if (!faceButton || !(snapshot.facesKnown & (1 << faceNum))) {
+      continue;
+    }
+    faceButton->setName(snapshot.faceNames[faceNum]);
+    if (snapshot.selectedFace == (int8_t) faceNum) {
+      faceButton->setActive();
+      faceButton->setColor(HEADCONTROL_SELECTED_COLOR);
+    }
+    faceButton->setStale(true);
   }
 }
 
@@ -82,6 +118,7 @@ void addFace (unsigned int faceNum, String faceName, bool faceSelected) {
 // Find the Sign's IP Address
 //
 void findHeadIP(Adafruit_GFX *tft) {
+  HeapProbe heapProbe(HEAP_MDNS);
   tft->println("Sending mDNS query");
   Serial.println("Sending mDNS query");
   int n = MDNS.queryService(headName, "tcp"); // Send out query for esp tcp services
@@ -94,54 +131,71 @@ void findHeadIP(Adafruit_GFX *tft) {
     Serial.print(n);
     Serial.println(" service(s) found");
     for (int i = 0; i < n; ++i) {
-      headHost = MDNS.hostname(i);
-      headIP = MDNS.IP(i).toString();
-      headPort = MDNS.port(i);
+      headDevice.host = MDNS.hostname(i);
+      headDevice.ip = MDNS.IP(i).toString();
+      headDevice.port = MDNS.port(i);
       // Print details for each service found
       Serial.print(i + 1);
       Serial.print(": ");
-      Serial.print(headHost);
+      Serial.print(headDevice.host);
       Serial.print(" (");
-      Serial.print(headIP);
+      Serial.print(headDevice.ip);
       Serial.print(":");
-      Serial.print(headPort);
+      Serial.print(headDevice.port);
       Serial.println(")");
     }
   }
   Serial.print("Using (");
-  Serial.print(headIP);
+  Serial.print(headDevice.ip);
   Serial.print(": ");
-  Serial.print(headPort);
+  Serial.print(headDevice.port);
   Serial.print(") for ");
-  Serial.println(headHost);
+  Serial.println(headDevice.host);
 
   tft->print("Using ");
-  tft->print(headIP);
+  tft->print(headDevice.ip);
   tft->print(":");
-  tft->print(headPort);
+  tft->print(headDevice.port);
   tft->print(" for ");
-  tft->println(headHost);
+  tft->println(headDevice.host);
 }
 
 
 //
-// Send Commands to Head
+// Send Commands to a Head
 //
-void sendHeadCommand (const char* type, const String& requestPath) {
+void sendHeadCommand (HeadDevice *head, const char* type, const String& requestPath) {
+  if (WiFi.status() != WL_CONNECTED) {
+    Serial.println("[sendHeadCommand] WiFi not connected");
+    return;
+  }
+
+  HeapProbe heapProbe(HEAP_HEAD_COMMAND);
+  RequestArenaScope arenaScope;
   WiFiClient wifiClient;
   HTTPClient http;
-  //String serverPath = "http://" + headHost +":80" + requestPath;
+  //String serverPath = "http://" + head->host +":80" + requestPath;
   //Serial.println(serverPath);
   //http.begin(wifiClient, serverPath.c_str());
-  http.begin(wifiClient, headIP, headPort, requestPath);
+  http.begin(wifiClient, head->ip, head->port, requestPath);
+  uint32_t commandStart = millis();
   int httpCode = http.sendRequest(type);
   if (httpCode == HTTP_CODE_OK) {
     // Received a good response
-    String payload = http.getString();
-    Serial.println(payload);
-    DynamicJsonDocument requestDoc(2048);
-    DeserializationError error = deserializeJson(requestDoc, payload);
-    if (error) {
+    // The body and the JSON document are kept in the request arena.
+    // Face names point into the body, addFace copies them into the label pool.
+    RequestArenaWriter payload;
+    int bodyLength = http.writeToStream(&payload);
+    Serial.println(payload.c_str());
+    RequestJsonDocument requestDoc(2048);
+    // A body that was not read completely is not parsed
+    if (bodyLength < 0) {
+      Serial.printf("[sendHeadCommand] reading the response failed, error: %s\n", http.errorToString(bodyLength).c_str());
+    }
+    else if (payload.overflowed()) {
+      Serial.println("Bad Request - Response too large for the request arena");
+    }
+    else if (deserializeJson(requestDoc, payload.c_str())) {
       Serial.println("Bad Request - Parsing JSON Body Failed");
     }
     else {
@@ -149,10 +203,18 @@ void sendHeadCommand (const char* type, const String& requestPath) {
 
       // Get the current color of the onair sign 
       if (requestDoc.containsKey("faces")) {
+        // Buttons for faces the head does not report are drawn disabled
+        for (uint8_t buttonIndex = 0; buttonIndex < headTopMenu.getButtonCount(); buttonIndex++) {
+          headTopMenu.getButton(buttonIndex)->setDisabled(true);
+        }
         JsonArray faces = requestDoc["faces"];
         for(JsonVariant face : faces) {
           unsigned int faceNum = face["faceNum"].as<unsigned int>();
-          String faceName = face["name"].as<String>();
+          const char *faceName = face["name"].as<const char*>();
+          if (!faceName) {
+            // A face with no name is shown with an empty label
+            faceName = "";
+          }
           bool faceSelected = face["selected"].as<bool>();
           Serial.print("Face Num: ");
           Serial.print(faceNum);
@@ -173,7 +235,8 @@ void sendHeadCommand (const char* type, const String& requestPath) {
     String payload = http.getString();
     Serial.println(payload);
   }
-  
+
+  usageLogCommand(USAGE_TARGET_HEAD, httpCode, millis() - commandStart);
 }
 
 
@@ -181,7 +244,7 @@ void sendHeadCommand (const char* type, const String& requestPath) {
 // Get Head Status
 //
 void getHeadStatus () {
-  sendHeadCommand("GET", headPath);
+  sendHeadCommand(&headDevice, "GET", headPath);
 }
 
 
@@ -190,7 +253,7 @@ void getHeadStatus () {
 //
 void selectFace (int face) {
   String faceSelectStr = headPath + "?face=" + String(face);
-  sendHeadCommand("PUT", faceSelectStr);
+  sendHeadCommand(&headDevice, "PUT", faceSelectStr);
 }
 
 
@@ -198,16 +261,24 @@ void selectFace (int face) {
  * Head Control Menu functions and callbacks
  *****************************/
 
+//
+// Let a menu image place the page and select faces by number.
+// Called before the menu is set up.
+//
+void headControlRegisterMenu () {
+  menuImageRegisterPage(PSTR("head"), &headTopMenu);
+  menuImageRegisterAction(PSTR("head.face"), ButtonPressCallback(&headControlShortButtonPress, &headDevice));
+  menuImageRegisterAction(PSTR("head.status"), &headControlShortPagePress);
+}
+
+
 //
 // Perform Head Control Button Panel first time set up
 void headControlSetup (Adafruit_GFX *tft) {
       // Set up On Air
   findHeadIP(tft);
-  
-  // Initialize to the current status of the Sign
-  getHeadStatus();
-  tft->println("Got Head Status");
 
+  // The faces of the Head are read when the page is shown
 }
 
 
@@ -222,7 +293,42 @@ bool headControlShortPagePress () {
 }
 
 
-void headControlShortButtonPress (int faceNum) {
+//
+// Handle the page being shown.
+// Get the Head's faces to name the buttons.
+// Before the network is up the page shows the faces saved before the reboot.
+//
+void headControlEnterPage (MenuPage *page) {
+  if (WiFi.status() != WL_CONNECTED) {
+    restoreFaces();
+    return;
+  }
+  getHeadStatus();
+}
+
+
+//
+// Handle the page being hidden.
+// Give the face names back to the label pool, they are read again when the page is shown
+//
+void headControlLeavePage (MenuPage *page) {
+  for (uint8_t buttonIndex = 0; buttonIndex < page->getButtonCount(); buttonIndex++) {
+    MenuButton *faceButton = page->getButton(buttonIndex);
+    faceButton->resetName();
+    faceButton->setInactive();
+    faceButton->setColor(DEFAULT_BUTTON_COLOR);
+    faceButton->setStale(false);
+    faceButton->setDisabled(false);
+  }
+}
+
+
+//
+// Handle a short press callback.
+// The head and the face number are bound to the callback of each face button.
+//
+bool headControlShortButtonPress (void *head, int32_t faceNum) {
   String faceSelectPath = headPath + "?faceNum=" + String(faceNum);
-  sendHeadCommand("PUT", faceSelectPath);
+  sendHeadCommand((HeadDevice*) head, "PUT", faceSelectPath);
+  return true;
 }
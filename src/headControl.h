@@ -10,31 +10,30 @@
 #include <Adafruit_GFX.h>
 #include <Adafruit_ILI9341.h>
 #include "Menu.h"
-#include <vector>
 
-using namespace std;
-
-#define BUTTONPANEL_HEADCONTROL_COLOR ILI9341_GREEN
-#define HEADCONTROL_SELECTED_COLOR ILI9341_GREEN
-#define HEADCONTROL_SELECTED_TEXTCOLOR ILI9341_BLACK
+#define BUTTONPANEL_HEADCONTROL_COLOR THEME_HEADCONTROL
+#define HEADCONTROL_SELECTED_COLOR THEME_SELECTED
+#define HEADCONTROL_PAGE_HEAP_BUDGET 1024   // Bytes of heap the Head page may hold while shown
 
 
 //
 // Menu Definition
 //
 
-extern MenuButton frownButton;
-extern MenuButton quizicalButton;
-extern MenuButton yesButton;
-extern vector<MenuButton*> headButtonList;
-extern MenuPage headTopMenu;
+// Panel layout is fixed so it is calculated at compile time
+typedef MenuTreePage<PanelGrid<3, 2>, 6> HeadPage;
+
+extern HeadPage headTopMenu;
 
 //
 // Functions
 //
 
+void headControlRegisterMenu();
 void headControlSetup(Adafruit_GFX *tft);
 
 bool headControlShortPagePress();
+void headControlEnterPage (MenuPage *page);
+void headControlLeavePage (MenuPage *page);
 
-void headControlShortButtonPress (int faceNum);
\ No newline at end of file
+bool headControlShortButtonPress (void *head, int32_t faceNum);
\ No newline at end of file
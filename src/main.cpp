@@ -19,10 +19,20 @@
 #include "onair.h"
 #include "headControl.h"
 #include "status.h"
+#include "HeapStats.h"
+#include "MenuImage.h"
+#include "menuUpload.h"
+#include "snapshot.h"
+#include "UsageLog.h"
+#include "TimeRules.h"
+#include "TouchCalibration.h"
+#include "TouchTrace.h"
 //#include <TelnetSerial.h>       // For debugging via Telnet
 
 // Uncomment the following define to debug the screen calibration
 //#define CALIBRATE_DEBUG
+// Uncomment the following define to time the touch mapping
+//#define CALIBRATE_BENCHMARK
 
 
 //
@@ -58,6 +68,9 @@ NTPClient timeClient(ntpUDP);
 #define TFT_RST -1 //for D1 mini or TFT I2C Connector Shield (V1.1.0 or later)
 #define TS_CS D3   //for D1 mini or TFT I2C Connector Shield (V1.1.0 or later)
 #define TFT_LED D2  //for D1 mini to adjust brightness
+// Uncomment when the touch PENIRQ line is wired to a pin with interrupts (not D0)
+// so the touch controller is only read while the screen is touched
+//#define TS_IRQ D1
 
 // #define TFT_CS 14  //for D32 Pro
 // #define TFT_DC 27  //for D32 Pro
@@ -69,12 +82,17 @@ Adafruit_ILI9341 tft = Adafruit_ILI9341(TFT_CS, TFT_DC, TFT_RST);
 // Touch response part of the display
 XPT2046_Touchscreen ts(TS_CS);
 
-// This is calibration data for the raw touch data to the screen coordinates
+// This is calibration data for the raw touch data to the screen coordinates,
+// used until the touch screen is calibrated from the Status page
 #define TS_MINX 700
 #define TS_MINY 500
 #define TS_MAXX 3500
 #define TS_MAXY 3800
 
+// Raw touch data to screen coordinates, replaced by the saved calibration
+TouchMatrix touchMatrix;
+TouchCalibrator touchCalibrator(&tft, &ts, &touchMatrix);
+
 // Time to wait to dim or turn off screen
 #define SCREEN_DIM_DELAY 60000    // 1 minute
 #define SCREEN_OFF_DELAY 600000   // 10 minutes
@@ -90,14 +108,36 @@ bool screenAlwaysOn = true;
 // Menu definition
 //
 
-MenuPage btlTopMenu = MenuPage("BTL", 1, 1, ILI9341_LIGHTGREY);
-//MenuPage lightsTopMenu = MenuPage("Light", 1, 1, ILI9341_YELLOW);
+static const char btlPageLabel[] PROGMEM = "BTL";
+static constexpr MenuPageDef btlPageDef PROGMEM = {{btlPageLabel, THEME_NEUTRAL, nullptr, nullptr}};
+MenuTreePage<PanelGrid<1, 1>, 0> btlTopMenu = MenuTreePage<PanelGrid<1, 1>, 0>(&btlPageDef);
+//static const char lightsPageLabel[] PROGMEM = "Light";
+//static constexpr MenuPageDef lightsPageDef PROGMEM = {{lightsPageLabel, THEME_NEUTRAL, nullptr, nullptr}};
+//MenuTreePage<PanelGrid<1, 1>, 0> lightsTopMenu = MenuTreePage<PanelGrid<1, 1>, 0>(&lightsPageDef);  // setColor(ILI9341_YELLOW) in setup
+
+//static MenuPage* const topMenuList[] PROGMEM = {&onairTopMenu, &headTopMenu, &btlTopMenu, &lightsTopMenu, &statusTopMenu};
+static MenuPage* const topMenuList[] PROGMEM = {&onairTopMenu, &headTopMenu, &btlTopMenu, &statusTopMenu};
+// Sized for a menu image, which can show more pages than the built in list
+MenuTree<MENUIMAGE_MAX_TOP_PAGES> menu = MenuTree<MENUIMAGE_MAX_TOP_PAGES>(&tft, topMenuList);
+
+#ifdef TS_IRQ
+TouchHandler touchHandler = TouchHandler(&ts, TS_IRQ);
+#else
+TouchHandler touchHandler = TouchHandler(&ts);
+#endif
 
-//vector<MenuPage*> topMenuList = {&onairTopMenu, &headTopMenu, &btlTopMenu, &lightsTopMenu, &statusTopMenu};
-vector<MenuPage*> topMenuList = {&onairTopMenu, &headTopMenu, &btlTopMenu, &statusTopMenu};
-Menu menu = Menu(&tft, &topMenuList);
 
-TouchHandler touchHandler = TouchHandler(&ts);
+//
+// Display that draws nothing.
+// Boot messages go here when the menu is already shown from the snapshot.
+//
+class NullDisplay: public Adafruit_GFX {
+  public:
+    NullDisplay() : Adafruit_GFX(ILI9341_TFTHEIGHT, ILI9341_TFTWIDTH) {};
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override {};
+};
+
+NullDisplay nullDisplay;
 
 
 
@@ -134,19 +174,12 @@ void configModeCallback (WiFiManager *myWiFiManager) {
  *************************************************/
  
 /*
- * Determine if screen should always be on.
- * Workday between 7:00am and 5pm
+ * Set if screen should always be on.
+ * Called by the time rules when a screen window opens or closes.
  */
-void alwaysOnTick()
+void setScreenAlwaysOn(bool alwaysOn)
 {
-  int day = timeClient.getDay();
-  int hour = timeClient.getHours();
-  if ((1 <= day && day <= 5) && (7 <= hour && hour <= 17)) {
-    screenAlwaysOn = true;
-  }
-  else {
-    screenAlwaysOn = false;
-  }
+  screenAlwaysOn = alwaysOn;
 }
 
 
@@ -179,24 +212,8 @@ void calibrateTouch(int16_t *pressX, int16_t *pressY) {
   Serial.println(*pressY);
 #endif
 
-  // Scale using the calibration #'s
-  // and rotate coordinate system
-  //TODO: Resolve map() ambiguity with mDNS
-  //tsPoint->y = map(tsPoint->y, TS_MINY, TS_MAXY, 0, screenHeight);
-  *pressY = (*pressY - TS_MINY) * (screenHeight) / (TS_MAXY - TS_MINY);
-  //tsPoint->x = map(tsPoint->x, TS_MINX, TS_MAXX, 0, screenWidth);
-  *pressX = (*pressX - TS_MINX) * (screenWidth) / (TS_MAXX - TS_MINX);
-
-#ifdef CALIBRATE_DEBUG
-  tft.printf("map x:%4d y:%4d\n", *pressX, *pressY);
-  Serial.print("map x = ");
-  Serial.println(*pressX);
-  Serial.print("map y = ");
-  Serial.println(*pressY);
-#endif
-
-  *pressY = screenHeight - *pressY;
-  //*pressX = *pressX;
+  // Scale, rotate and align with the calibration matrix
+  touchMatrixMap(touchMatrix, pressX, pressY);
 
 #ifdef CALIBRATE_DEBUG
   tft.printf("ali x:%4d y:%4d\n", *pressX, *pressY);
@@ -231,11 +248,79 @@ void calibrateTouch(int16_t *pressX, int16_t *pressY) {
 
 }
 
+#ifdef CALIBRATE_BENCHMARK
+/*
+ * Compare the cycles to map a touch with the old divisions
+ * and with the calibration matrix, across the raw range
+ */
+void benchmarkTouchMapping() {
+  TouchMatrix rangeMatrix = touchMatrixFromRange(TS_MINX, TS_MAXX, TS_MINY, TS_MAXY, screenWidth, screenHeight, true);
+  uint32_t divideCycles = 0;
+  uint32_t matrixCycles = 0;
+  uint16_t maxDifference = 0;
+  uint16_t samples = 0;
+
+  for (int16_t rawY = TS_MINY; rawY <= TS_MAXY; rawY += 50) {
+    for (int16_t rawX = TS_MINX; rawX <= TS_MAXX; rawX += 50) {
+      volatile int16_t divideX = rawX;
+      volatile int16_t divideY = rawY;
+      uint32_t start = ESP.getCycleCount();
+      divideY = screenHeight - (divideY - TS_MINY) * (screenHeight) / (TS_MAXY - TS_MINY);
+      divideX = (divideX - TS_MINX) * (screenWidth) / (TS_MAXX - TS_MINX);
+      divideCycles += ESP.getCycleCount() - start;
+
+      int16_t matrixX = rawX;
+      int16_t matrixY = rawY;
+      start = ESP.getCycleCount();
+      touchMatrixMap(rangeMatrix, &matrixX, &matrixY);
+      matrixCycles += ESP.getCycleCount() - start;
+
+      maxDifference = max(maxDifference, (uint16_t) max(abs(matrixX - divideX), abs(matrixY - divideY)));
+      samples++;
+    }
+  }
+
+  Serial.print("Touch mapping cycles per sample divide: ");
+  Serial.print(divideCycles / samples);
+  Serial.print(" matrix: ");
+  Serial.print(matrixCycles / samples);
+  Serial.print(" largest difference px: ");
+  Serial.println(maxDifference);
+}
+#endif
+
 /*
  * Call back function when a Touch Event is triggered
  */
 void touchEventCallback(Event *event) {
+  HeapProbe heapProbe(HEAP_MENU_DRAW);
   menu.eventHandler(event);
+
+  // Remember the page for the next reboot
+  MenuPage *activeMenu = menu.getActiveTopMenu();
+  if (activeMenu) {
+    snapshotSetPage(activeMenu->getMenuIndex());
+  }
+}
+
+
+/*
+ * Record each touch event handled by the menu in the usage log
+ */
+void recordMenuEvent(TouchEvent event, int16_t pageIndex, int16_t buttonIndex, uint32_t elapsed) {
+  UsageKind kind = (event == EVENT_LONG) ? USAGE_LONG : (event == EVENT_SHORT || event == EVENT_DOUBLE) ? USAGE_SHORT : USAGE_SWIPE;
+  usageLogRecord(kind, (pageIndex < 0) ? USAGELOG_NONE : pageIndex, (buttonIndex < 0) ? USAGELOG_NONE : buttonIndex, elapsed);
+}
+
+
+/*
+ * Print the heap held by each menu page, the usage log and the time rules after the heap statistics
+ */
+void printPageMemory(Print &p) {
+  menu.printPageMemory(p);
+  touchHandler.printStats(p);
+  usageLogPrint(p);
+  timeRulesPrint(p);
 }
 
 
@@ -270,8 +355,51 @@ void setup(void)
   screenWidth = tft.width();
   screenHeight = tft.height();
 
-  tft.println(ESP.getFullVersion());
-  tft.println();
+  // Let a menu image place the pages and use their actions
+  onairRegisterMenu();
+  headControlRegisterMenu();
+  statusRegisterMenu(&menu, &touchCalibrator);
+  menuImageRegisterPage(PSTR("btl"), &btlTopMenu);
+
+  // Start the file system holding the menu image, the snapshot and the usage log
+  if (!LittleFS.begin()) {
+    Serial.println("Unable to start LittleFS");
+  }
+  touchMatrix = touchMatrixFromRange(TS_MINX, TS_MAXX, TS_MINY, TS_MAXY, screenWidth, screenHeight, true);
+  touchCalibrationLoad(&touchMatrix, screenWidth, screenHeight);
+#ifdef CALIBRATE_BENCHMARK
+  benchmarkTouchMapping();
+#endif
+  usageLogSetup();
+
+  //
+  // Set up the menu before the network so it can be shown
+  // from the snapshot saved before the reboot
+  //
+  bool menuStarted = menu.setup();
+  menu.setEventRecorder(&recordMenuEvent);
+
+  // Pages shown before the network is up use the snapshot, dimmed until their devices report.
+  // Loaded before any page is entered so the enter hooks restore from it.
+  bool quickStart = snapshotLoad();
+  menu.setActiveTopMenu(&onairTopMenu);
+
+  // Replace the built in pages with the menu image if there is one
+  menuImageSetup(&menu, topMenuList, sizeof(topMenuList) / sizeof(topMenuList[0]));
+
+  if (quickStart) {
+    uint8_t savedPage = snapshotGet().activePage;
+    if (savedPage < menu.getTopMenuCount()) {
+      menu.setActiveTopMenu(menu.getTopMenu(savedPage));
+    }
+    HeapProbe heapProbe(HEAP_MENU_DRAW);
+    menu.draw();
+  }
+
+  // Boot messages are only shown when the menu is not
+  Adafruit_GFX *bootScreen = quickStart ? (Adafruit_GFX*) &nullDisplay : (Adafruit_GFX*) &tft;
+  bootScreen->println(ESP.getFullVersion());
+  bootScreen->println();
 
   // start ticker to slow blink LED strip during Setup
   ticker.attach(0.6, tick);
@@ -292,9 +420,9 @@ void setup(void)
     ESP.restart();
     delay(1000);
   }
-  tft.println("Connected");
-  tft.print("IP: ");
-  tft.println(WiFi.localIP());
+  bootScreen->println("Connected");
+  bootScreen->print("IP: ");
+  bootScreen->println(WiFi.localIP());
 
 
   //
@@ -302,7 +430,7 @@ void setup(void)
   // needed for OTA
   //
   MDNS.begin(devicename);
-  tft.println("mDNS Started");
+  bootScreen->println("mDNS Started");
 
   //
   // Set up OTA
@@ -341,44 +469,62 @@ void setup(void)
     }
   });
   ArduinoOTA.begin();
-  tft.println("OTA Started");
+  bootScreen->println("OTA Started");
 
   // Set up the time
   timeClient.setTimeOffset(-4*3600);
   timeClient.setUpdateInterval(3600000);
   timeClient.begin();
-  timeClient.update();
-  tft.println("Time Started");
+  {
+    HeapProbe heapProbe(HEAP_NTP);
+    timeClient.update();
+  }
+  bootScreen->println("Time Started");
 
   touchHandler.start(&touchEventCallback);
+  touchHandler.setSharedBusPin(TFT_CS);
+  touchHandler.setSampleRecorder(&touchTraceRecord);
 
   // Set up On Air
-  onairSetup(&tft);
+  onairSetup(bootScreen);
   // Set up On Air
-  headControlSetup(&tft);
+  headControlSetup(bootScreen);
   // Set up Status
-  statusSetup(&tft, &timeClient);
+  statusSetup(bootScreen, &timeClient);
 
   //
   // Keep startup info on the screen for a bit
   //
-  delay(1000);
+  if (!quickStart) {
+    delay(1000);
+  }
 
-  if (menu.setup()) {
+  if (menuStarted) {
     Serial.println("MENU started");
-    tft.println("Menu Started");
+    bootScreen->println("Menu Started");
   }
   else {
     Serial.println("MENU not started");
-    tft.println("Menu not Started");
+    bootScreen->println("Menu not Started");
   }
-  menu.setActiveTopMenu(&topMenuList, &onairTopMenu);
+
+  touchTraceSetup(&touchMatrix, screenWidth, screenHeight, devicepassword);
+  menuUploadSetup(&menu, devicepassword);
+  bootScreen->println(menuImageLoaded() ? "Menu image loaded" : "Built in menu");
 
   // Hold one more time incase there is some info from menu setup
-  delay(1000);
+  if (!quickStart) {
+    delay(1000);
+  }
+
+  // The network is up, so the page shown reads the state of its devices
+  menu.refreshActiveTopMenu();
 
   // refesh all and display menu
-  menu.draw();
+  {
+    HeapProbe heapProbe(HEAP_MENU_DRAW);
+    menu.draw();
+  }
 
 
   //
@@ -386,7 +532,7 @@ void setup(void)
   //
   ticker.detach();            // Stop blinking the LED
   digitalWrite(ledPin, HIGH); // set pin to the opposite state
-  ticker.attach(5*60, alwaysOnTick);  // Check if screen should always be on
+  timeRulesSetup(&menu, &timeClient, &setScreenAlwaysOn);  // Keep the screen on, switch pages and more by time of day
 
 }
 
@@ -398,10 +544,32 @@ void setup(void)
 void loop() {
   // Handle any requests
   ArduinoOTA.handle();
-  MDNS.update();
-  timeClient.update();
-
-  bool isTouched = touchHandler.detectEvent(&calibrateTouch);
+  {
+    HeapProbe heapProbe(HEAP_MDNS);
+    MDNS.update();
+  }
+  {
+    HeapProbe heapProbe(HEAP_NTP);
+    timeClient.update();
+  }
+  heapStatsHandleSerial(&printPageMemory);
+  menuUploadHandle();
+  snapshotHandle();
+  timeRulesHandle();
+
+  bool isTouched;
+  if (touchCalibrator.isActive()) {
+    // The calibration has the screen, the menu is redrawn when it is done
+    isTouched = touchCalibrator.handle();
+    if (!touchCalibrator.isActive()) {
+      menu.refreshActiveTopMenu();
+      menu.draw();
+    }
+  }
+  else {
+    isTouched = touchHandler.detectEvent(&calibrateTouch);
+    touchHandler.dispatchEvents();
+  }
 
     // There is a change in touch state
   if ((isTouched != wasTouched) || (screenAlwaysOn && (screen_dimmed || screen_off))) {
@@ -425,4 +593,8 @@ void loop() {
   }
 
   wasTouched = isTouched;
+
+  // Write the usage log between touches
+  usageLogHandle(!isTouched);
+  touchTraceHandle(!isTouched);
 }
@@ -0,0 +1,146 @@
+/*
+ * Web endpoint for replacing the menu image
+ * without a reboot.
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <ESP8266WebServer.h>   // For receiving the menu image
+#include "menuUpload.h"
+#include "MenuImage.h"
+
+ESP8266WebServer menuServer(MENUUPLOAD_PORT);
+Menu *uploadMenu = nullptr;           // Menu redrawn after a new image is loaded
+const char *uploadPassword = nullptr; // Password for MENUUPLOAD_USER
+File uploadFile;                      // Temporary file being written
+bool uploadOk = false;                // Indicates every part of the upload was written
+
+
+/*****************************
+ * Menu Upload callbacks
+ *****************************/
+
+//
+// Write each part of the posted image to the temporary file
+//
+void menuUploadReceive() {
+  HTTPUpload &upload = menuServer.upload();
+
+  switch (upload.status) {
+    case UPLOAD_FILE_START:
+      uploadOk = menuServer.authenticate(MENUUPLOAD_USER, uploadPassword);
+      if (uploadOk) {
+        uploadFile = LittleFS.open(MENUUPLOAD_TEMP_PATH, "w");
+        uploadOk = (bool) uploadFile;
+      }
+      break;
+
+    case UPLOAD_FILE_WRITE:
+      if (uploadOk && (upload.totalSize > MENUIMAGE_MAX_SIZE || uploadFile.write(upload.buf, upload.currentSize) != upload.currentSize)) {
+        Serial.println("Menu upload too large or not written");
+        uploadOk = false;
+      }
+      break;
+
+    case UPLOAD_FILE_END:
+      if (uploadFile) {
+        uploadFile.close();
+      }
+      break;
+
+    case UPLOAD_FILE_ABORTED:
+      if (uploadFile) {
+        uploadFile.close();
+      }
+      uploadOk = false;
+      break;
+  }
+}
+
+
+//
+// Check the uploaded image and swap it in.
+// The image is loaded from the temporary file and only replaces
+// the saved image once it is showing, otherwise the saved image is loaded again.
+//
+void menuUploadDone() {
+  if (!menuServer.authenticate(MENUUPLOAD_USER, uploadPassword)) {
+    menuServer.requestAuthentication();
+    return;
+  }
+
+  if (!uploadOk || !menuImageCheckFile(MENUUPLOAD_TEMP_PATH)) {
+    LittleFS.remove(MENUUPLOAD_TEMP_PATH);
+    menuServer.send(400, "text/plain", "Menu image rejected\n");
+    return;
+  }
+
+  if (menuImageLoad(MENUUPLOAD_TEMP_PATH)) {
+    // The image is held in memory, so the file can be moved.
+    // Rename replaces the saved image in one step.
+    if (LittleFS.rename(MENUUPLOAD_TEMP_PATH, MENUIMAGE_PATH)) {
+      menuServer.send(200, "text/plain", "Menu image loaded\n");
+    }
+    else {
+      Serial.println("Menu image loaded but not saved");
+      LittleFS.remove(MENUUPLOAD_TEMP_PATH);
+      menuServer.send(500, "text/plain", "Menu image loaded but not saved, the previous image is used after a reboot\n");
+    }
+  }
+  else {
+    LittleFS.remove(MENUUPLOAD_TEMP_PATH);
+    if (LittleFS.exists(MENUIMAGE_PATH) && menuImageLoad(MENUIMAGE_PATH)) {
+      menuServer.send(500, "text/plain", "Menu image not loaded, keeping the previous image\n");
+    }
+    else {
+      menuServer.send(500, "text/plain", "Menu image not loaded, using the built in menu\n");
+    }
+  }
+
+  if (uploadMenu) {
+    uploadMenu->draw();
+  }
+}
+
+
+//
+// Report whether the menu comes from an image
+//
+void menuUploadStatus() {
+  menuServer.send(200, "text/plain", menuImageLoaded() ? "Menu image loaded\n" : "Built in menu\n");
+}
+
+
+/*****************************
+ * Menu Upload functions
+ *****************************/
+
+//
+// Start the web server for menu uploads
+//
+// @param menu     Menu to redraw after a new image is loaded
+// @param password Password for MENUUPLOAD_USER, the same as the OTA password
+//
+void menuUploadSetup(Menu *menu, const char *password) {
+  uploadMenu = menu;
+  uploadPassword = password;
+  menuServer.on(MENUUPLOAD_URI, HTTP_GET, &menuUploadStatus);
+  menuServer.on(MENUUPLOAD_URI, HTTP_POST, &menuUploadDone, &menuUploadReceive);
+  menuServer.begin();
+}
+
+
+//
+// Handle any web requests
+//
+void menuUploadHandle() {
+  menuServer.handleClient();
+}
+
+
+//
+// Web server other modules can add their requests to
+//
+ESP8266WebServer* menuUploadServer() {
+  return &menuServer;
+}
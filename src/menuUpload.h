@@ -0,0 +1,30 @@
+/*
+ * Web endpoint for replacing the menu image
+ * without a reboot.
+ *
+ *   curl -u admin:<password> -F "image=@menu.bin" http://deskButtonPanel.local/menu
+ */
+#pragma once
+
+#ifndef _BUTTONPANEL_MENUUPLOAD_H
+#define _BUTTONPANEL_MENUUPLOAD_H
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+#include "Menu.h"
+
+#define MENUUPLOAD_PORT 80                  // Port of the web server
+#define MENUUPLOAD_URI "/menu"              // Path the image is posted to
+#define MENUUPLOAD_USER "admin"             // User name for the upload
+#define MENUUPLOAD_TEMP_PATH "/menu.tmp"    // File the upload is written to before it is checked
+
+
+//
+// Functions
+//
+
+void menuUploadSetup(Menu *menu, const char *password);
+void menuUploadHandle();
+ESP8266WebServer* menuUploadServer();
+
+#endif
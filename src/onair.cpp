@@ -12,13 +12,23 @@
 #include <Adafruit_ILI9341.h>
 #include "Menu.h"
 #include "onair.h"
+#include "HeapStats.h"
+#include "RequestArena.h"
+#include "MenuImage.h"
+#include "snapshot.h"
+#include "UsageLog.h"
 
 //
 // Menu Definition
 //
-MenuButton onairButton = MenuButton("On Air", 0, 1, BUTTONPANEL_ONAIR_COLOR, &onairShortButtonPress, &onairLongButtonPress);
-vector<MenuButton*> onairButtonList = {&onairButton};
-MenuPage onairTopMenu = MenuPage("OnAir", 1, 3, &onairButtonList, BUTTONPANEL_ONAIR_COLOR, &onairShortPagePress);
+static const char onairButtonLabel[] PROGMEM = "On Air";
+static const char onairPageLabel[] PROGMEM = "OnAir";
+
+static constexpr MenuButtonDef onairButtonDef PROGMEM = {{onairButtonLabel, BUTTONPANEL_ONAIR_COLOR, &onairShortButtonPress, &onairLongButtonPress}, 0, 1};
+static constexpr MenuPageDef onairPageDef PROGMEM = {{onairPageLabel, BUTTONPANEL_ONAIR_COLOR, &onairShortPagePress, nullptr}, nullptr, &onairEnterPage, nullptr, ONAIR_PAGE_HEAP_BUDGET};
+
+MenuButton onairButton = MenuButton(&onairButtonDef);
+OnairPage onairTopMenu = OnairPage(&onairPageDef, {&onairButton});
 
 
 //
@@ -35,45 +45,6 @@ String   signIP = signHost;               // Default to sign hostname
 uint16_t signPort = 80;                   // Default Port
 
 
-/*****************************
- * On Air utilities
- *****************************/
-
-//
-// Convert an 8-bit individual R G B color to an equivalent 16-bit RGB565 value
-//
-uint16_t colorRGBtoRGB565(uint8_t r, uint8_t g, uint8_t b)
-{
-  return ((r / 8) << 11) | ((g / 4) << 5) | (b / 8);
-}
-
-//
-// Convert a 24-bit RGB color to an equivalent 16-bit RGB565 value
-//
-uint16_t colorRGB24toRGB565(uint32_t rgb) {
-  uint8_t r = (rgb & 0xFF0000) >> 16;
-  uint8_t g = (rgb & 0x00FF00) >> 8;
-  uint8_t b = (rgb & 0x00FF);
-
-  return colorRGBtoRGB565(r, g, b);
-}
-
-//
-// Convert a 16-bit RGB565 color to a standard 24-bit RGB Color
-//
-uint32_t colorRGB565toRGB24(uint16_t color)
-{
-  uint32_t bits = (uint32_t)color;
-  uint32_t blue = bits & 0x001F;     // 5 bits blue
-  uint32_t green = bits & 0x07E0;    // 6 bits green
-  uint32_t red = bits & 0xF800;      // 5 bits red
-
-  // Return shifted bits with alpha set to 0xFF
-  //return (red << 8) | (green << 5) | (blue << 3) | 0xFF000000;
-  return (red << 8) | (green << 5) | (blue << 3);
-}
-
-
 /*****************************
  * On Air Sign functions
  *****************************/
@@ -100,17 +71,33 @@ void turnButtonOff() {
 // Send Commands to Sign
 //
 void sendSignCommand (const char* type, const String& requestPath) {
+  if (WiFi.status() != WL_CONNECTED) {
+    Serial.println("[sendSignCommand] WiFi not connected");
+    return;
+  }
+
+  HeapProbe heapProbe(HEAP_SIGN_COMMAND);
+  RequestArenaScope arenaScope;
   WiFiClient wifiClient;
   HTTPClient http;
   http.begin(wifiClient, signIP, signPort, requestPath);
+  uint32_t commandStart = millis();
   int httpCode = http.sendRequest(type);
   if (httpCode == HTTP_CODE_OK) {
     // Received a good response
-    String payload = http.getString();
-    Serial.println(payload);
-    DynamicJsonDocument requestDoc(1024);
-    DeserializationError error = deserializeJson(requestDoc, payload);
-    if (error) {
+    // The body and the JSON document are kept in the request arena
+    RequestArenaWriter payload;
+    int bodyLength = http.writeToStream(&payload);
+    Serial.println(payload.c_str());
+    RequestJsonDocument requestDoc(1024);
+    // A body that was not read completely is not parsed
+    if (bodyLength < 0) {
+      Serial.printf("[sendSignCommand] reading the response failed, error: %s\n", http.errorToString(bodyLength).c_str());
+    }
+    else if (payload.overflowed()) {
+      Serial.println("Bad Request - Response too large for the request arena");
+    }
+    else if (deserializeJson(requestDoc, payload.c_str())) {
       Serial.println("Bad Request - Parsing JSON Body Failed");
     }
     else {
@@ -118,12 +105,15 @@ void sendSignCommand (const char* type, const String& requestPath) {
 
       // Get the current color of the onair sign 
       if (requestDoc.containsKey("color")) {
-        String colorStr = requestDoc["color"];
-        if (colorStr.charAt(0) == '#') {
-          colorStr.setCharAt(0, '0');
+        const char *colorStr = requestDoc["color"].as<const char*>();
+        if (!colorStr) {
+          colorStr = "";
+        }
+        if (colorStr[0] == '#') {
+          colorStr++;
         }
         char color_c[10] = "";
-        colorStr.toCharArray(color_c, 8);
+        strlcpy(color_c, colorStr, 7);
         uint32_t color24 = strtol(color_c, NULL, 16);
         uint16_t color565 = colorRGB24toRGB565(color24);
 
@@ -132,7 +122,11 @@ void sendSignCommand (const char* type, const String& requestPath) {
         //Serial.printf(" Color RBG = %x\n", color565);
 
         // Set color of Button to match color of sign
-        onairButton.setColor(color565);
+        // Shades are only recalculated when the sign's color changes, and a theme
+        // color that happens to match is replaced so a theme change keeps the sign's color
+        if (!onairButton.hasCustomColor(color565)) {
+          onairButton.setColor(color565);
+        }
       }
 
       // Get the current on/off state of the onair sign
@@ -145,6 +139,10 @@ void sendSignCommand (const char* type, const String& requestPath) {
           turnButtonOff();
         }
       }
+
+      // The sign has confirmed its state, remember it for the next reboot
+      onairButton.setStale(false);
+      snapshotSetSign(onairButton.getColor(), lightOn);
     }
 
   }
@@ -153,7 +151,30 @@ void sendSignCommand (const char* type, const String& requestPath) {
     String payload = http.getString();
     Serial.println(payload);
   }
-  
+
+  usageLogCommand(USAGE_TARGET_SIGN, httpCode, millis() - commandStart);
+}
+
+
+//
+// Show the sign's state from before the reboot until the sign reports it
+//
+void restoreSignState () {
+  const DeviceSnapshot &snapshot = snapshotGet();
+  if (snapshot.signState == SNAPSHOT_SIGN_UNKNOWN) {
+    return;
+  }
+
+  if (!onairButton.hasCustomColor(snapshot.signColor)) {
+    onairButton.setColor(snapshot.signColor);
+  }
+  if (snapshot.signState == SNAPSHOT_SIGN_ON) {
+    turnButtonOn();
+  }
+  else {
+    turnButtonOff();
+  }
+  onairButton.setStale(true);
 }
 
 
@@ -190,6 +211,7 @@ void turnSignOff () {
 // Find the Sign's IP Address
 //
 void findSignIP(Adafruit_GFX *tft) {
+  HeapProbe heapProbe(HEAP_MDNS);
   tft->println("Sending mDNS query");
   Serial.println("Sending mDNS query");
   int n = MDNS.queryService(signName, "tcp"); // Send out query for esp tcp services
@@ -236,16 +258,25 @@ void findSignIP(Adafruit_GFX *tft) {
  * On Air Menu functions and callbacks
  *****************************/
 
+//
+// Let a menu image place the page and use the sign's actions.
+// Called before the menu is set up.
+//
+void onairRegisterMenu () {
+  menuImageRegisterPage(PSTR("onair"), &onairTopMenu);
+  menuImageRegisterAction(PSTR("onair.on"), &onairShortButtonPress);
+  menuImageRegisterAction(PSTR("onair.off"), &onairLongButtonPress);
+  menuImageRegisterAction(PSTR("onair.status"), &onairShortPagePress);
+}
+
+
 //
 // Perform OnAir Button Panel first time set up
 void onairSetup (Adafruit_GFX *tft) {
       // Set up On Air
   findSignIP(tft);
-  
-  // Initialize to the current status of the Sign
-  getSignStatus();
-  tft->println("Got Sign Status");
 
+  // The status of the Sign is read when the page is shown
 }
 
 
@@ -280,3 +311,16 @@ bool onairShortPagePress () {
   getSignStatus();
   return true;
 }
+
+//
+// Handle the page being shown.
+// Get Sign's latest status to update page.
+// Before the network is up the page shows the state saved before the reboot.
+//
+void onairEnterPage (MenuPage *page) {
+  if (WiFi.status() != WL_CONNECTED) {
+    restoreSignState();
+    return;
+  }
+  getSignStatus();
+}
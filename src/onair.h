@@ -9,25 +9,26 @@
 
 #include <Arduino.h>
 #include "Menu.h"
-#include <vector>
 
-using namespace std;
-
-#define BUTTONPANEL_ONAIR_COLOR ILI9341_RED
+#define BUTTONPANEL_ONAIR_COLOR THEME_ONAIR
+#define ONAIR_PAGE_HEAP_BUDGET 512    // Bytes of heap the On Air page may hold while shown
 
 
 //
 // Menu Definition
 //
 
+// Panel layout is fixed so it is calculated at compile time
+typedef MenuTreePage<PanelGrid<1, 3>, 1> OnairPage;
+
 extern MenuButton onairButton;
-extern vector<MenuButton*> onairButtonList;
-extern MenuPage onairTopMenu;
+extern OnairPage onairTopMenu;
 
 //
 // Functions
 //
 
+void onairRegisterMenu();
 void onairSetup(Adafruit_GFX *tft);
 
 //
@@ -37,5 +38,6 @@ void onairSetup(Adafruit_GFX *tft);
 bool onairShortButtonPress ();
 bool onairLongButtonPress ();
 bool onairShortPagePress ();
+void onairEnterPage (MenuPage *page);
 
 #endif
\ No newline at end of file
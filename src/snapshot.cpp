@@ -0,0 +1,177 @@
+/*
+ * Snapshot of the state shown by the button panel so the menu
+ * can be drawn right after a reboot, before the network is up.
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "snapshot.h"
+#include "Crc32.h"
+
+DeviceSnapshot snapshot = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, sizeof(DeviceSnapshot), 0, 0, SNAPSHOT_SIGN_UNKNOWN, SNAPSHOT_NO_PAGE, 0, SNAPSHOT_NO_FACE, {0, 0}, {}};
+bool snapshotFlashDirty = false;      // Indicates the LittleFS copy is older than the snapshot
+unsigned long snapshotFlashTime = 0;  // Last time the LittleFS copy was written
+
+
+/*****************************
+ * Snapshot functions
+ *****************************/
+
+//
+// CRC-32 of the snapshot after its header
+//
+uint32_t snapshotCrc(const DeviceSnapshot &s) {
+  const uint8_t *body = (const uint8_t*) &s + offsetof(DeviceSnapshot, signColor);
+  return checksumCrc32(body, sizeof(DeviceSnapshot) - offsetof(DeviceSnapshot, signColor));
+}
+
+
+//
+// Check a snapshot read back from RTC memory or LittleFS
+//
+bool snapshotValid(const DeviceSnapshot &s) {
+  return s.magic == SNAPSHOT_MAGIC && s.version == SNAPSHOT_VERSION && s.size == sizeof(DeviceSnapshot) && s.crc == snapshotCrc(s);
+}
+
+
+//
+// Save the snapshot to RTC memory and note the LittleFS copy needs writing.
+// RTC memory is not flash so it can be written on every change.
+//
+void snapshotChanged() {
+  snapshot.crc = snapshotCrc(snapshot);
+  if (!ESP.rtcUserMemoryWrite(SNAPSHOT_RTC_OFFSET, (uint32_t*) &snapshot, sizeof(DeviceSnapshot))) {
+    Serial.println("Snapshot not written to RTC memory");
+  }
+  snapshotFlashDirty = true;
+}
+
+
+//
+// Write the LittleFS copy of the snapshot
+//
+void snapshotWriteFlash() {
+  File file = LittleFS.open(SNAPSHOT_PATH, "w");
+  if (!file || file.write((const uint8_t*) &snapshot, sizeof(DeviceSnapshot)) != sizeof(DeviceSnapshot)) {
+    Serial.println("Snapshot not written to LittleFS");
+  }
+  if (file) {
+    file.close();
+  }
+  snapshotFlashDirty = false;
+  snapshotFlashTime = millis();
+}
+
+
+//
+// Read the snapshot saved before the reboot.
+// RTC memory is used after a reset, the LittleFS copy after a power loss.
+// LittleFS must already be started.
+//
+// @return true if a snapshot was found
+//
+bool snapshotLoad() {
+  DeviceSnapshot saved;
+
+  if (ESP.rtcUserMemoryRead(SNAPSHOT_RTC_OFFSET, (uint32_t*) &saved, sizeof(DeviceSnapshot)) && snapshotValid(saved)) {
+    Serial.println("Snapshot restored from RTC memory");
+    snapshot = saved;
+  }
+  else {
+    File file = LittleFS.open(SNAPSHOT_PATH, "r");
+    bool read = file && file.read((uint8_t*) &saved, sizeof(DeviceSnapshot)) == sizeof(DeviceSnapshot);
+    if (file) {
+      file.close();
+    }
+    if (!read || !snapshotValid(saved)) {
+      Serial.println("No snapshot to restore");
+      return false;
+    }
+    Serial.println("Snapshot restored from LittleFS");
+    snapshot = saved;
+
+    // Put it back in RTC memory for the next reset, the LittleFS copy is already current
+    snapshotChanged();
+    snapshotFlashDirty = false;
+  }
+
+  return true;
+}
+
+
+//
+// Return the snapshot
+//
+const DeviceSnapshot& snapshotGet() {
+  return snapshot;
+}
+
+
+//
+// Save the state reported by the On Air sign
+//
+void snapshotSetSign(uint16_t color, bool lightOn) {
+  uint8_t signState = lightOn ? SNAPSHOT_SIGN_ON : SNAPSHOT_SIGN_OFF;
+  if (snapshot.signColor != color || snapshot.signState != signState) {
+    snapshot.signColor = color;
+    snapshot.signState = signState;
+    snapshotChanged();
+  }
+}
+
+
+//
+// Save a face reported by the Robot Head.
+// Names longer than SNAPSHOT_FACE_NAME_LENGTH are cut.
+//
+void snapshotSetFace(unsigned int faceNum, const char *faceName, bool selected) {
+  if (faceNum >= SNAPSHOT_FACES) {
+    return;
+  }
+  if (!faceName) {
+    faceName = "";
+  }
+
+  bool changed = false;
+  uint8_t faceBit = (1 << faceNum);
+  if (!(snapshot.facesKnown & faceBit) || strncmp(snapshot.faceNames[faceNum], faceName, SNAPSHOT_FACE_NAME_LENGTH - 1) != 0) {
+    strlcpy(snapshot.faceNames[faceNum], faceName, SNAPSHOT_FACE_NAME_LENGTH);
+    snapshot.facesKnown |= faceBit;
+    changed = true;
+  }
+  if (selected && snapshot.selectedFace != (int8_t) faceNum) {
+    snapshot.selectedFace = faceNum;
+    changed = true;
+  }
+  else if (!selected && snapshot.selectedFace == (int8_t) faceNum) {
+    snapshot.selectedFace = SNAPSHOT_NO_FACE;
+    changed = true;
+  }
+
+  if (changed) {
+    snapshotChanged();
+  }
+}
+
+
+//
+// Save the page being shown
+//
+void snapshotSetPage(int16_t pageIndex) {
+  uint8_t activePage = (pageIndex < 0 || pageIndex >= SNAPSHOT_NO_PAGE) ? SNAPSHOT_NO_PAGE : pageIndex;
+  if (snapshot.activePage != activePage) {
+    snapshot.activePage = activePage;
+    snapshotChanged();
+  }
+}
+
+
+//
+// Write the LittleFS copy when the snapshot has changed,
+// no more often than SNAPSHOT_FLASH_INTERVAL to spare the flash
+//
+void snapshotHandle() {
+  if (snapshotFlashDirty && (millis() - snapshotFlashTime) >= SNAPSHOT_FLASH_INTERVAL) {
+    snapshotWriteFlash();
+  }
+}
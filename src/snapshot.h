@@ -0,0 +1,74 @@
+/*
+ * Snapshot of the state shown by the button panel so the menu
+ * can be drawn right after a reboot, before the network is up.
+ *
+ * The snapshot is kept in RTC user memory, which survives a reset
+ * or an OTA update but not a power loss, and is copied to LittleFS
+ * at most once every SNAPSHOT_FLASH_INTERVAL.  Anything restored
+ * from the snapshot is drawn dimmed until the device it came from
+ * reports its status again.
+ */
+#pragma once
+
+#ifndef _BUTTONPANEL_SNAPSHOT_H
+#define _BUTTONPANEL_SNAPSHOT_H
+
+#include <Arduino.h>
+
+#define SNAPSHOT_MAGIC 0x50414E53         // "SNAP"
+#define SNAPSHOT_VERSION 1                // Change when DeviceSnapshot changes
+#define SNAPSHOT_RTC_OFFSET 32            // RTC user memory block (4 bytes each) of the snapshot, the first 128 bytes are used by OTA
+#define SNAPSHOT_PATH "/snapshot.bin"     // LittleFS copy for after a power loss
+#define SNAPSHOT_FLASH_INTERVAL 60000     // Shortest time in ms between writes of the LittleFS copy
+#define SNAPSHOT_FACES 6                  // Robot Head faces remembered
+#define SNAPSHOT_FACE_NAME_LENGTH 16      // Longest face name remembered including the terminator
+#define SNAPSHOT_NO_FACE -1               // selectedFace when no face is selected
+#define SNAPSHOT_NO_PAGE 0xFF             // activePage when no page was saved
+
+
+//
+// On/off state of the On Air sign
+//
+enum SnapshotSignState : uint8_t {
+  SNAPSHOT_SIGN_UNKNOWN = 0,    // The sign has not reported its state
+  SNAPSHOT_SIGN_OFF,
+  SNAPSHOT_SIGN_ON
+};
+
+
+//
+// Last known state of everything the panel shows.
+// Sized to a multiple of 4 bytes for RTC user memory.
+//
+struct DeviceSnapshot {
+  uint32_t magic;             // SNAPSHOT_MAGIC
+  uint16_t version;           // SNAPSHOT_VERSION
+  uint16_t size;              // sizeof(DeviceSnapshot)
+  uint32_t crc;               // CRC-32 of everything after this field
+  uint16_t signColor;         // RGB565 color of the On Air sign
+  uint8_t signState;          // SnapshotSignState
+  uint8_t activePage;         // Index of the page shown or SNAPSHOT_NO_PAGE
+  uint8_t facesKnown;         // Bit set of the faces with a name
+  int8_t selectedFace;        // Face the Robot Head has on or SNAPSHOT_NO_FACE
+  uint8_t reserved[2];
+  char faceNames[SNAPSHOT_FACES][SNAPSHOT_FACE_NAME_LENGTH];  // Names of the Robot Head faces
+};
+
+static_assert(sizeof(DeviceSnapshot) % 4 == 0, "RTC user memory is read in 4 byte blocks");
+static_assert(SNAPSHOT_RTC_OFFSET * 4 + sizeof(DeviceSnapshot) <= 512, "Snapshot does not fit in RTC user memory");
+
+
+//
+// Functions
+//
+
+bool snapshotLoad();
+const DeviceSnapshot& snapshotGet();
+
+void snapshotSetSign(uint16_t color, bool lightOn);
+void snapshotSetFace(unsigned int faceNum, const char *faceName, bool selected);
+void snapshotSetPage(int16_t pageIndex);
+
+void snapshotHandle();
+
+#endif
@@ -13,6 +13,8 @@
 #include <Adafruit_ILI9341.h>
 #include "Menu.h"
 #include "status.h"
+#include "HeapStats.h"
+#include "MenuImage.h"
 
 //
 // NTP
@@ -20,15 +22,31 @@
 //const long utcOffsetInSeconds = -5 * 3600; // EDT is -5 hours from UTC
 //WiFiUDP ntpUDP;
 NTPClient *statusTimeClient;
-String months[12]={"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+TouchCalibrator *statusCalibrator = nullptr;
+Menu *statusMenu = nullptr;
+uint8_t statusThemeIndex = 0;   // Position of the active theme in menuThemes
+const char* const months[12]={"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
 
 //
 // Menu Definition
 //
-MenuButton statusResetButton = MenuButton("Reset", 0, 1, ILI9341_RED, &statusResetShortPress);
-MenuButton statusConfigButton = MenuButton("Config", 1, 1, BUTTONPANEL_STATUS_COLOR, &statusConfigShortPress, &statusConfigLongPress);
-vector<MenuButton*> statusButtonList = {&statusResetButton, &statusConfigButton};
-MenuPage statusTopMenu = MenuPage("Status", 2, 2, &statusButtonList, BUTTONPANEL_STATUS_COLOR);
+static const char statusResetLabel[] PROGMEM = "Reset";
+static const char statusConfigLabel[] PROGMEM = "Config";
+static const char statusTouchLabel[] PROGMEM = "Touch";
+static const char statusThemeLabel[] PROGMEM = "Theme";
+static const char statusPageLabel[] PROGMEM = "Status";
+
+static constexpr MenuButtonDef statusResetButtonDef PROGMEM = {{statusResetLabel, THEME_ALERT, &statusResetShortPress, nullptr}, 0, 1};
+static constexpr MenuButtonDef statusConfigButtonDef PROGMEM = {{statusConfigLabel, BUTTONPANEL_STATUS_COLOR, &statusConfigShortPress, &statusConfigLongPress}, 1, 1};
+static constexpr MenuButtonDef statusTouchButtonDef PROGMEM = {{statusTouchLabel, BUTTONPANEL_STATUS_COLOR, &statusTouchShortPress, nullptr}, 2, 1};
+static constexpr MenuButtonDef statusThemeButtonDef PROGMEM = {{statusThemeLabel, BUTTONPANEL_STATUS_COLOR, &statusThemeShortPress, nullptr}, 3, 1};
+static constexpr MenuPageDef statusPageDef PROGMEM = {{statusPageLabel, BUTTONPANEL_STATUS_COLOR, nullptr, nullptr}, &showStatus};
+
+MenuButton statusResetButton = MenuButton(&statusResetButtonDef);
+MenuButton statusConfigButton = MenuButton(&statusConfigButtonDef);
+MenuButton statusTouchButton = MenuButton(&statusTouchButtonDef);
+MenuButton statusThemeButton = MenuButton(&statusThemeButtonDef);
+StatusPage statusTopMenu = StatusPage(&statusPageDef, {&statusResetButton, &statusConfigButton, &statusTouchButton, &statusThemeButton});
 
 
 
@@ -38,19 +56,23 @@ MenuPage statusTopMenu = MenuPage("Status", 2, 2, &statusButtonList, BUTTONPANEL
 
 // Show the Status on the page
 void showStatus (Adafruit_GFX *tft, int16_t panelX, int16_t panelY, int16_t panelWidth, int16_t panelHeight) {
+    if (!statusTimeClient) {
+      // statusSetup has not run yet
+      return;
+    }
 
     //timeClient.update();
     time_t epochTime = statusTimeClient->getEpochTime();
     struct tm *ptm = gmtime (&epochTime);
     //int currentMonth = ptm->tm_mon;
     int currentDay = ptm->tm_mday;
-    String currentMonth = months[ptm->tm_mon];
+    const char *currentMonth = months[ptm->tm_mon];
     int currentYear = ptm->tm_year+1900;
     //int currentYear = ptm->tm_year;
 
     tft->setCursor(panelX, panelY + BUTTONPANEL_STATUS_PADDING_TOP);
     tft->setTextSize(2);
-    tft->setTextColor(BUTTONPANEL_STATUS_COLOR);
+    tft->setTextColor(getThemeColor(BUTTONPANEL_STATUS_COLOR).base);
 
 
     //tft->printf("Date: %d-%s-%d\n", currentDay, currentMonth, currentYear);
@@ -67,6 +89,38 @@ void showStatus (Adafruit_GFX *tft, int16_t panelX, int16_t panelY, int16_t pane
     tft->print("  IP: ");
     tft->println(WiFi.localIP());
 
+    // Heap summary in small text, the details are printed to Serial
+    uint32_t freeHeap;
+    uint32_t maxBlock;
+    uint8_t fragmentation;
+    heapStatsCurrent(&freeHeap, &maxBlock, &fragmentation);
+    tft->setTextSize(1);
+    tft->print("Heap: ");
+    tft->print(freeHeap);
+    tft->print(" low ");
+    tft->print(heapStatsMinFreeHeap());
+    tft->print(" block ");
+    tft->print(maxBlock);
+    tft->print(" frag ");
+    tft->print(fragmentation);
+    tft->println("%");
+
+}
+
+
+//
+// Let a menu image place the page.
+// Called before the menu is set up.
+//
+// @param menu       Menu repainted by the Theme button
+// @param calibrator Touch screen calibration started by the Touch button
+//
+void statusRegisterMenu (Menu *menu, TouchCalibrator *calibrator) {
+  statusMenu = menu;
+  statusCalibrator = calibrator;
+  menuImageRegisterPage(PSTR("status"), &statusTopMenu);
+  menuImageRegisterAction(PSTR("status.calibrate"), &statusTouchShortPress);
+  menuImageRegisterAction(PSTR("status.theme"), &statusThemeShortPress);
 }
 
 
@@ -77,12 +131,9 @@ void statusSetup (Adafruit_GFX *tft, NTPClient *tc) {
   tft->println("Setup Status");
 
 
-  // Configure Menu
-  statusTopMenu.setDrawPanel(&showStatus);
-  
-
   //Save pointer to NTP Client
   statusTimeClient = tc;
+
   //Start NTP Client
   //timeClient.begin();
   //tft->println("Time Client Started");
@@ -119,4 +170,34 @@ bool statusConfigLongPress () {
     //wm.stopConfigPortal();
 
     return true;
+}
+
+//
+// Calibrate the touch screen.
+// The calibration takes over the screen from the next loop,
+// so the menu is not redrawn here.
+//
+bool statusTouchShortPress () {
+    if (!statusCalibrator) {
+      return false;
+    }
+    statusCalibrator->start();
+
+    return false;
+}
+
+//
+// Switch the menu to the next theme.
+// The menu repaints the whole screen in the new theme.
+//
+bool statusThemeShortPress () {
+    if (!statusMenu) {
+      return false;
+    }
+    statusThemeIndex = (statusThemeIndex + 1) % MENU_THEME_COUNT;
+    Serial.print("Theme: ");
+    Serial.println(menuThemes[statusThemeIndex]->name);
+    statusMenu->setTheme(menuThemes[statusThemeIndex]);
+
+    return false;
 }
\ No newline at end of file
@@ -9,18 +9,19 @@
 
 #include <Arduino.h>
 #include "Menu.h"
-#include <vector>
-
-using namespace std;
+#include "TouchCalibration.h"
 
 #define BUTTONPANEL_STATUS_PADDING_TOP 2
-#define BUTTONPANEL_STATUS_COLOR ILI9341_YELLOW
+#define BUTTONPANEL_STATUS_COLOR THEME_STATUS
 
 //
 // Menu Definition
 //
 
-extern MenuPage statusTopMenu;
+// Panel layout is fixed so it is calculated at compile time
+typedef MenuTreePage<PanelGrid<4, 2>, 4> StatusPage;
+
+extern StatusPage statusTopMenu;
 
 
 //
@@ -29,6 +30,7 @@ extern MenuPage statusTopMenu;
 
 void showStatus (Adafruit_GFX *tft, int16_t panelX, int16_t panelY, int16_t panelWidth, int16_t panelHeight);
 
+void statusRegisterMenu(Menu *menu, TouchCalibrator *calibrator);
 void statusSetup(Adafruit_GFX *tft, NTPClient *tc);
 
 //
@@ -38,5 +40,7 @@ void statusSetup(Adafruit_GFX *tft, NTPClient *tc);
 bool statusResetShortPress ();
 bool statusConfigShortPress ();
 bool statusConfigLongPress ();
+bool statusTouchShortPress ();
+bool statusThemeShortPress ();
 
 #endif
\ No newline at end of file
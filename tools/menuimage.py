@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""
+Compile a menu description in JSON into the binary menu image read by
+src/MenuImage.cpp.
+
+    python3 tools/menuimage.py tools/menu.example.json data/menu.bin
+
+The image can be put on LittleFS with "pio run -t uploadfs", as data/menu.bin,
+or swapped in at runtime without a reboot:
+
+    curl -u admin:<password> -F "image=@data/menu.bin" http://deskButtonPanel.local/menu
+
+The description is a list of pages shown across the top.  A page is either
+a page written in C++ that the firmware registered by name:
+
+    {"builtin": "onair"}
+
+or a page of buttons on a grid of up to 4 x 3 cells:
+
+    {"label": "Quick", "color": "neutral", "across": 2, "down": 2, "buttons": [
+        {"label": "On", "x": 0, "y": 0, "short": "onair.on"},
+        {"label": "Face 2", "x": 1, "y": 0, "spanY": 2, "short": {"action": "head.face", "arg": 2}}
+    ]}
+
+Actions are the names the firmware registered with menuImageRegisterAction.
+"""
+
+import argparse
+import json
+import struct
+import sys
+import zlib
+
+# Must match src/MenuImage.h
+MAGIC = 0x494D5042
+VERSION = 1
+MAX_SIZE = 1536
+MAX_TOP_PAGES = 8
+MAX_PAGES = 4
+MAX_BUTTONS = 16
+MAX_ACROSS = 4
+MAX_DOWN = 3
+NO_STRING = 0xFFFF
+
+# Must match the order of ThemeRole in src/MenuTheme.h
+THEME_ROLES = ["background", "pagetop", "button", "selected", "alert", "neutral", "onair", "headcontrol", "status"]
+
+HEADER = struct.Struct("<IHHIBBHHH")   # MenuImageHeader
+PAGE = struct.Struct("<IHHBBBBB3x")    # MenuImagePageRecord
+BUTTON = struct.Struct("<HBBBBBxHHii")  # MenuImageButtonRecord
+
+
+class MenuError(Exception):
+    pass
+
+
+class StringTable:
+    """Nul terminated strings, each stored once"""
+
+    def __init__(self):
+        self.data = bytearray()
+        self.offsets = {}
+
+    def add(self, text):
+        if text is None:
+            return NO_STRING
+        if text not in self.offsets:
+            self.offsets[text] = len(self.data)
+            self.data += text.encode("utf-8") + b"\0"
+        return self.offsets[text]
+
+
+def color_role(item, default, where):
+    name = item.get("color", default)
+    if name not in THEME_ROLES:
+        raise MenuError("%s: unknown color %r, use one of %s" % (where, name, ", ".join(THEME_ROLES)))
+    return THEME_ROLES.index(name)
+
+
+def action(button, key, strings, where):
+    value = button.get(key)
+    if value is None:
+        return NO_STRING, 0
+    if isinstance(value, str):
+        return strings.add(value), 0
+    if "action" not in value:
+        raise MenuError("%s: %s needs an action name" % (where, key))
+    return strings.add(value["action"]), int(value.get("arg", 0))
+
+
+def compile_page(page, page_index, buttons, strings):
+    """Return the page record, adding its buttons to the list"""
+    where = "page %d" % page_index
+    if "builtin" in page:
+        return PAGE.pack(0, NO_STRING, strings.add(page["builtin"]), 0, 0, 0, 0, 0)
+
+    label = page.get("label")
+    if not label:
+        raise MenuError("%s: needs a label or a builtin name" % where)
+    where = "page %r" % label
+    across = int(page.get("across", 1))
+    down = int(page.get("down", 1))
+    if not (1 <= across <= MAX_ACROSS and 1 <= down <= MAX_DOWN):
+        raise MenuError("%s: grid %dx%d is larger than %dx%d" % (where, across, down, MAX_ACROSS, MAX_DOWN))
+
+    page_buttons = page.get("buttons", [])
+    if len(page_buttons) > across * down:
+        raise MenuError("%s: %d buttons do not fit a %dx%d grid" % (where, len(page_buttons), across, down))
+
+    first_button = len(buttons)
+    layout = bytearray(struct.pack("<BB", across, down))
+    used = set()
+    for button in page_buttons:
+        button_label = button.get("label")
+        if not button_label:
+            raise MenuError("%s: every button needs a label" % where)
+        button_where = "%s button %r" % (where, button_label)
+        x = int(button.get("x", 0))
+        y = int(button.get("y", 0))
+        span_x = int(button.get("spanX", 1))
+        span_y = int(button.get("spanY", 1))
+        if span_x < 1 or span_y < 1 or x < 0 or y < 0 or x + span_x > across or y + span_y > down:
+            raise MenuError("%s: does not fit in the %dx%d grid" % (button_where, across, down))
+        cells = {(column, row) for column in range(x, x + span_x) for row in range(y, y + span_y)}
+        if cells & used:
+            raise MenuError("%s: overlaps another button" % button_where)
+        used |= cells
+
+        short_action, short_arg = action(button, "short", strings, button_where)
+        long_action, long_arg = action(button, "long", strings, button_where)
+        buttons.append(BUTTON.pack(strings.add(button_label), color_role(button, "button", button_where),
+                                   x, y, span_x, span_y, short_action, long_action, short_arg, long_arg))
+        layout += struct.pack("<BBBB", x, y, span_x, span_y)
+
+    return PAGE.pack(zlib.crc32(bytes(layout)), strings.add(label), NO_STRING, color_role(page, "pagetop", where),
+                     across, down, first_button, len(page_buttons))
+
+
+def compile_menu(menu):
+    """Return the image for a menu description"""
+    pages = menu.get("pages", [])
+    if not pages:
+        raise MenuError("the menu has no pages")
+    if len(pages) > MAX_TOP_PAGES:
+        raise MenuError("%d pages, the firmware shows at most %d" % (len(pages), MAX_TOP_PAGES))
+    if sum(1 for page in pages if "builtin" not in page) > MAX_PAGES:
+        raise MenuError("more than %d pages with their own buttons" % MAX_PAGES)
+
+    strings = StringTable()
+    buttons = []
+    page_records = b"".join(compile_page(page, index, buttons, strings) for index, page in enumerate(pages))
+    if len(buttons) > MAX_BUTTONS:
+        raise MenuError("%d buttons, the firmware holds at most %d" % (len(buttons), MAX_BUTTONS))
+    strings.add("")     # The image always ends with a nul
+
+    pages_offset = HEADER.size
+    buttons_offset = pages_offset + len(page_records)
+    strings_offset = buttons_offset + BUTTON.size * len(buttons)
+    body = page_records + b"".join(buttons) + bytes(strings.data)
+    size = HEADER.size + len(body)
+    if size > MAX_SIZE:
+        raise MenuError("image is %d bytes, the firmware holds at most %d" % (size, MAX_SIZE))
+
+    header = HEADER.pack(MAGIC, VERSION, size, zlib.crc32(body), len(pages), len(buttons),
+                         pages_offset, buttons_offset, strings_offset)
+    return header + body
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compile a JSON menu description into a menu image")
+    parser.add_argument("source", help="JSON menu description")
+    parser.add_argument("image", help="binary menu image to write")
+    args = parser.parse_args()
+
+    try:
+        with open(args.source) as source:
+            image = compile_menu(json.load(source))
+    except (MenuError, ValueError) as error:
+        print("%s: %s" % (args.source, error), file=sys.stderr)
+        return 1
+
+    with open(args.image, "wb") as output:
+        output.write(image)
+    print("%s: %d bytes" % (args.image, len(image)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
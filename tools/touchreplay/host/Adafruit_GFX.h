@@ -0,0 +1,6 @@
+/*
+ * Only the name is needed for TouchCalibration.h
+ */
+#pragma once
+
+class Adafruit_GFX;
@@ -0,0 +1,52 @@
+/*
+ * Just enough of the Arduino core to run the TouchHandler on a host.
+ * The clock is set by the replay, nothing else has any effect.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#define IRAM_ATTR
+#define LOW 0
+#define HIGH 1
+#define INPUT_PULLUP 2
+#define FALLING 2
+
+// Clock injected by the replay
+extern unsigned long replayMillis;
+inline unsigned long millis() { return replayMillis; }
+inline unsigned long micros() { return replayMillis * 1000; }
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return HIGH; }
+inline int digitalPinToInterrupt(int pin) { return pin; }
+inline void attachInterrupt(int, void (*)(), int) {}
+
+using std::min;
+using std::max;
+template<typename T> T constrain(T value, T low, T high) { return value < low ? low : (value > high ? high : value); }
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+// Output goes to stderr so it does not mix with the replay report
+class Print {
+  public:
+    size_t print(const char *text) { return fputs(text, stderr) >= 0 ? strlen(text) : 0; }
+    size_t print(const __FlashStringHelper *text) { return print((const char*) text); }
+    size_t print(char c) { return fputc(c, stderr) != EOF; }
+    size_t print(long value, int = 10) { return fprintf(stderr, "%ld", value); }
+    size_t print(unsigned long value, int = 10) { return fprintf(stderr, "%lu", value); }
+    size_t print(int value, int base = 10) { return print((long) value, base); }
+    size_t print(unsigned int value, int base = 10) { return print((unsigned long) value, base); }
+    size_t print(double value, int digits = 2) { return fprintf(stderr, "%.*f", digits, value); }
+    size_t println() { return print("\n"); }
+    template<typename T> size_t println(T value) { return print(value) + println(); }
+};
+
+extern Print Serial;
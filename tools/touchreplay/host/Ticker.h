@@ -0,0 +1,12 @@
+/*
+ * Ticker that never fires, events are dispatched straight away in the replay
+ */
+#pragma once
+
+#include <Arduino.h>
+
+class Ticker {
+  public:
+    template<typename T> void attach_ms(uint32_t, void (*)(T), T) {}
+    void detach() {}
+};
@@ -0,0 +1,25 @@
+/*
+ * Touch controller that reports the trace sample set by the replay
+ */
+#pragma once
+
+#include <Arduino.h>
+
+class TS_Point {
+  public:
+    TS_Point() : x(0), y(0), z(0) {}
+    TS_Point(int16_t x, int16_t y, int16_t z) : x(x), y(y), z(z) {}
+    int16_t x, y, z;
+};
+
+class XPT2046_Touchscreen {
+  public:
+    XPT2046_Touchscreen(uint8_t, uint8_t = 255) {}
+    bool begin() { return true; }
+    bool touched() { return down; }
+    TS_Point getPoint() { return point; }
+    void setRotation(uint8_t) {}
+
+    bool down = false;    // Set by the replay
+    TS_Point point;       // Set by the replay
+};
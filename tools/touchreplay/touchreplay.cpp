@@ -0,0 +1,349 @@
+/*
+ * Replay touch traces recorded by src/TouchTrace.cpp through the
+ * unmodified TouchHandler on a host, with the clock set from the trace.
+ *
+ *   g++ -O2 -std=gnu++17 -Itools/touchreplay/host -Isrc -o touchreplay \
+ *       tools/touchreplay/touchreplay.cpp src/TouchHandler.cpp src/TouchFilter.cpp
+ *
+ *   ./touchreplay touch.trc
+ *   ./touchreplay --expect Short --debounce 30:90:10 --longpress 300:600:50 taps.trc
+ *
+ * For each trace and each combination of thresholds one tab separated line
+ * reports how many touches there were, how each touch was classified (the
+ * first event it raised), how many raised no event and the latency from
+ * the first touched sample to that event.  With --expect the line also
+ * reports how many touches raised the expected event, so a trace of one
+ * kind of gesture can be used to pick the thresholds.
+ *
+ * Thresholds are a value or a range from:to:step.
+ *   --debounce   GestureConfig.debounceDelay in millis
+ *   --longpress  GestureConfig.longPressDelay in millis
+ *   --swipe      GestureConfig.swipeMinPixels
+ *   --fling      GestureConfig.flingMinVelocity in pixels per second
+ *   --events     Also print every event to stderr
+ */
+
+#include <Arduino.h>
+#include <XPT2046_Touchscreen.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "TouchHandler.h"
+#include "TouchTrace.h"
+
+#define REPLAY_LEAD 1000        // Millis replayed before the first sample of a run
+#define REPLAY_TAIL 1000        // Millis replayed after a release before skipping ahead
+#define REPLAY_MERGE_GAP 50     // Releases shorter than this are part of the same touch
+#define REPLAY_EVENT_COUNT (EVENT_DRAG_END + 1)
+
+unsigned long replayMillis = 0;
+Print Serial;
+
+
+//
+// One run of samples with times from the same boot
+//
+struct TraceRun {
+  std::vector<TouchTraceSample> samples;
+};
+
+
+//
+// A trace file
+//
+struct Trace {
+  std::string name;
+  TouchTraceHeader header;
+  std::vector<TraceRun> runs;
+};
+
+
+//
+// Inclusive range of a threshold
+//
+struct Range {
+  long from;
+  long to;
+  long step;
+};
+
+
+//
+// What a replay found
+//
+struct ReplayStats {
+  unsigned long touches = 0;              // Touches in the trace
+  unsigned long missed = 0;               // Touches that raised no event
+  unsigned long counts[REPLAY_EVENT_COUNT] = {};  // First event of each touch
+  unsigned long expected = 0;             // Touches whose first event was the expected one
+  unsigned long latencyTotal = 0;         // Sum of the millis from touch to first event
+  unsigned long latencyMax = 0;
+};
+
+
+// State of the replay in progress, used by the TouchHandler callbacks
+static XPT2046_Touchscreen replayScreen(0);
+static const TouchTraceHeader *replayHeader = nullptr;
+static ReplayStats *replayStats = nullptr;
+static unsigned long touchStart = 0;    // Clock at the first touched sample of the touch
+static bool touchOpen = false;          // A touch has started
+static bool touchHasEvent = false;      // The touch has raised an event
+static int expectedEvent = -1;          // TouchEvent the touches should raise, -1 for none
+static bool printEvents = false;
+
+
+/*
+ * Map the raw reading with the calibration the trace was recorded with,
+ * the same way as calibrateTouch in main.cpp
+ */
+static void replayCalibrate(int16_t *x, int16_t *y) {
+  touchMatrixMap(replayHeader->matrix, x, y);
+  *x = constrain(*x, (int16_t) 0, replayHeader->width);
+  *y = constrain(*y, (int16_t) 0, replayHeader->height);
+}
+
+
+/*
+ * Count the first event of each touch
+ */
+static void replayEvent(Event *event) {
+  if (printEvents) {
+    fprintf(stderr, "%lu\t%s\t%d\t%d\t%d\t%d\n", event->time - REPLAY_LEAD, TouchEventNames[event->event],
+            event->pressX, event->pressY, event->velocityX, event->velocityY);
+  }
+  if (!touchOpen || touchHasEvent || event->event >= REPLAY_EVENT_COUNT) {
+    return;
+  }
+  touchHasEvent = true;
+  replayStats->counts[event->event]++;
+  if (event->event == expectedEvent) {
+    replayStats->expected++;
+  }
+  unsigned long latency = event->time - touchStart;
+  replayStats->latencyTotal += latency;
+  replayStats->latencyMax = max(replayStats->latencyMax, latency);
+}
+
+
+/*
+ * Finish counting the current touch
+ */
+static void closeTouch() {
+  if (touchOpen && !touchHasEvent) {
+    replayStats->missed++;
+  }
+  touchOpen = false;
+}
+
+
+/*
+ * Replay one run through a new TouchHandler.
+ * The clock steps a milli at a time, like a fast loop(), except where
+ * nothing is touched for a long time which is skipped.
+ */
+static void replayRun(const TraceRun &run, const GestureConfig &config) {
+  const std::vector<TouchTraceSample> &samples = run.samples;
+  if (samples.empty()) {
+    return;
+  }
+
+  // Times are shifted by REPLAY_LEAD so the replay can start before the first sample
+  replayMillis = samples[0].time;
+  replayScreen.down = false;
+  replayScreen.point = TS_Point();
+  TouchHandler handler(&replayScreen);
+  handler.setGestureConfig(config);
+  handler.start(&replayEvent);
+
+  size_t next = 0;
+  unsigned long releaseTime = 0;        // Clock when the screen was last released
+  unsigned long lastSampleTime = replayMillis;
+  touchOpen = false;
+
+  while (true) {
+    // Apply the samples up to now, each holds until the next one
+    while (next < samples.size() && samples[next].time + REPLAY_LEAD <= replayMillis) {
+      const TouchTraceSample &sample = samples[next++];
+      bool touched = sample.flags & TOUCHTRACE_TOUCHED;
+      if (touched && !replayScreen.down && (!touchOpen || replayMillis - releaseTime >= REPLAY_MERGE_GAP)) {
+        closeTouch();
+        replayStats->touches++;
+        touchOpen = true;
+        touchHasEvent = false;
+        touchStart = replayMillis;
+      }
+      else if (!touched && replayScreen.down) {
+        releaseTime = replayMillis;
+      }
+      replayScreen.down = touched;
+      replayScreen.point = TS_Point(sample.x, sample.y, sample.z);
+      lastSampleTime = replayMillis;
+    }
+
+    handler.detectEvent(&replayCalibrate);
+    handler.dispatchEvents();
+
+    bool quiet = !replayScreen.down && (replayMillis - lastSampleTime > REPLAY_TAIL);
+    if (next >= samples.size() && quiet) {
+      break;
+    }
+    if (quiet && samples[next].time + REPLAY_LEAD > replayMillis + 1) {
+      replayMillis = samples[next].time + REPLAY_LEAD;
+    }
+    else {
+      replayMillis++;
+    }
+  }
+  closeTouch();
+}
+
+
+/*
+ * Read a trace file, splitting it into runs at each TOUCHTRACE_START
+ * and wherever the time goes backwards
+ */
+static bool loadTrace(const char *path, Trace *trace) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "%s: unable to open\n", path);
+    return false;
+  }
+  trace->name = path;
+  if (fread(&trace->header, sizeof(trace->header), 1, file) != 1 || trace->header.magic != TOUCHTRACE_MAGIC
+      || trace->header.version != TOUCHTRACE_VERSION || trace->header.sampleSize != sizeof(TouchTraceSample)) {
+    fprintf(stderr, "%s: not a touch trace\n", path);
+    fclose(file);
+    return false;
+  }
+
+  TouchTraceSample sample;
+  while (fread(&sample, sizeof(sample), 1, file) == 1) {
+    if (trace->runs.empty() || (sample.flags & TOUCHTRACE_START) || sample.time < trace->runs.back().samples.back().time) {
+      trace->runs.emplace_back();
+    }
+    trace->runs.back().samples.push_back(sample);
+  }
+  fclose(file);
+  return true;
+}
+
+
+/*
+ * Read a threshold as a value or from:to:step
+ */
+static bool parseRange(const char *text, Range *range) {
+  int fields = sscanf(text, "%ld:%ld:%ld", &range->from, &range->to, &range->step);
+  if (fields == 1) {
+    range->to = range->from;
+    range->step = 1;
+    return true;
+  }
+  return fields == 3 && range->step > 0 && range->to >= range->from;
+}
+
+
+static int usage() {
+  fprintf(stderr, "usage: touchreplay [--expect EVENT] [--debounce R] [--longpress R] [--swipe R] [--fling R] [--events] trace...\n"
+                  "  R is a value or from:to:step, EVENT is one of:");
+  for (int i = 0; i < REPLAY_EVENT_COUNT; i++) {
+    fprintf(stderr, " \"%s\"", TouchEventNames[i]);
+  }
+  fprintf(stderr, "\n");
+  return 2;
+}
+
+
+int main(int argc, char **argv) {
+  GestureConfig defaults;
+  Range debounce = {defaults.debounceDelay, defaults.debounceDelay, 1};
+  Range longPress = {defaults.longPressDelay, defaults.longPressDelay, 1};
+  Range swipe = {defaults.swipeMinPixels, defaults.swipeMinPixels, 1};
+  Range fling = {defaults.flingMinVelocity, defaults.flingMinVelocity, 1};
+  std::vector<Trace> traces;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--events") {
+      printEvents = true;
+    }
+    else if (arg == "--expect" && hasValue) {
+      std::string name = argv[++i];
+      for (int event = 0; event < REPLAY_EVENT_COUNT; event++) {
+        if (name == TouchEventNames[event]) {
+          expectedEvent = event;
+        }
+      }
+      if (expectedEvent < 0) {
+        return usage();
+      }
+    }
+    else if ((arg == "--debounce" && hasValue && parseRange(argv[++i], &debounce))
+             || (arg == "--longpress" && hasValue && parseRange(argv[++i], &longPress))
+             || (arg == "--swipe" && hasValue && parseRange(argv[++i], &swipe))
+             || (arg == "--fling" && hasValue && parseRange(argv[++i], &fling))) {
+      continue;
+    }
+    else if (arg.rfind("--", 0) == 0) {
+      return usage();
+    }
+    else {
+      traces.emplace_back();
+      if (!loadTrace(argv[i], &traces.back())) {
+        return 1;
+      }
+    }
+  }
+  if (traces.empty()) {
+    return usage();
+  }
+
+  printf("trace\tdebounce\tlongpress\tswipe\tfling\ttouches\tmissed");
+  for (int event = 1; event < REPLAY_EVENT_COUNT; event++) {
+    printf("\t%s", TouchEventNames[event]);
+  }
+  printf("\texpected\tlatency_avg\tlatency_max\n");
+
+  auto started = std::chrono::steady_clock::now();
+  unsigned long replayedTouches = 0;
+  for (const Trace &trace : traces) {
+    replayHeader = &trace.header;
+    for (long d = debounce.from; d <= debounce.to; d += debounce.step) {
+      for (long l = longPress.from; l <= longPress.to; l += longPress.step) {
+        for (long s = swipe.from; s <= swipe.to; s += swipe.step) {
+          for (long f = fling.from; f <= fling.to; f += fling.step) {
+            GestureConfig config;
+            config.debounceDelay = d;
+            config.longPressDelay = l;
+            config.swipeMinPixels = s;
+            config.flingMinVelocity = f;
+
+            ReplayStats stats;
+            replayStats = &stats;
+            for (const TraceRun &run : trace.runs) {
+              replayRun(run, config);
+            }
+            replayedTouches += stats.touches;
+
+            unsigned long detected = stats.touches - stats.missed;
+            printf("%s\t%ld\t%ld\t%ld\t%ld\t%lu\t%lu", trace.name.c_str(), d, l, s, f, stats.touches, stats.missed);
+            for (int event = 1; event < REPLAY_EVENT_COUNT; event++) {
+              printf("\t%lu", stats.counts[event]);
+            }
+            if (expectedEvent >= 0) {
+              printf("\t%lu", stats.expected);
+            }
+            else {
+              printf("\t-");
+            }
+            printf("\t%.1f\t%lu\n", detected ? (double) stats.latencyTotal / detected : 0.0, stats.latencyMax);
+          }
+        }
+      }
+    }
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  fprintf(stderr, "Replayed %lu touches in %.2f s\n", replayedTouches, seconds);
+  return 0;
+}